@@ -6,6 +6,7 @@
 #include "ConfigurationClient.h"
 #include "ConsulClient.h"
 #include "NodeError.h"
+#include "HttpClient.h"
 
 #include <arras4_log/Logger.h>
 #include <arras4_log/LogEventStream.h>
@@ -178,6 +179,16 @@ void ArrasNode::initialize()
     // get list of all inet interfaces, and pick a default
     fetchInetInterfaces();
 
+    // set up the connection pools used for requests to Consul,
+    // Coordinator and the configuration service
+    HttpClientOptions httpOptions;
+    httpOptions.maxConnectionsPerHost = mOptions.httpMaxConnectionsPerHost;
+    httpOptions.connectTimeoutSecs = mOptions.httpConnectTimeoutSecs;
+    httpOptions.requestTimeoutSecs = mOptions.httpTimeoutSecs;
+    httpOptions.maxIdleSecs = mOptions.httpMaxIdleSecs;
+    httpOptions.dnsCacheSecs = mOptions.httpDnsCacheSecs;
+    HttpClient::instance().configure(httpOptions);
+
     // locate Consul and Coordinator services
     findServices();
    
@@ -195,6 +206,8 @@ void ArrasNode::initialize()
     // start up HTTP REST service
     mNodeService = std::unique_ptr<NodeService>(new NodeService(mOptions.numHttpServerThreads,
                                                                 !mOptions.disableBanlist,
+                                                                mOptions.numEventThreads,
+                                                                mOptions.eventBatchSize,
                                                                 mCoordinatorUrl,
                                                                 *this,
                                                                 *mSessions));
@@ -341,6 +354,9 @@ void ArrasNode::registerNode()
                                    30);
     }
 
+    // measurements of the links to other nodes, as far as the router has them
+    mNodeInfo["network"] = mSessions->getController()->nodeNetwork();
+
     // Write node information to Coordinator and Consul
     bool ok = mNodeService->registerNode(mNodeInfo);
     if (ok && !mOptions.noConsul) ok = consulClient.updateNodeInfo(mNodeInfo);
@@ -642,7 +658,8 @@ void ArrasNode::run()
     
     // cleanup
     ARRAS_DEBUG("Shutting down node");
-    mSessions->shutdownAll("node exiting");
+    mSessions->shutdownAll("node exiting",
+                           std::chrono::seconds(mOptions.shutdownTimeoutSecs));
     mNodeService->drainEvents(DRAIN_EVENTS_TIMEOUT);
     deregisterNode();
 
@@ -751,6 +768,7 @@ ArrasNode::updateTagsProc(api::Object tags)
     std::string msg;
     if (validateTags(current, msg)) {
         mNodeInfo["tags"] = current;
+        mNodeInfo["network"] = mSessions->getController()->nodeNetwork();
 
         if (!mOptions.noConsul) {
             // updating consul with new node info
@@ -782,6 +800,7 @@ ArrasNode::deleteTagsProc(api::Object tags)
     std::string msg;
     if (validateTags(current, msg)) {
         mNodeInfo["tags"] = current;
+        mNodeInfo["network"] = mSessions->getController()->nodeNetwork();
 
         if (!mOptions.noConsul) {
             // updating consul with new node info
@@ -6,12 +6,10 @@
 
 #include <arras4_log/Logger.h>
 #include <arras4_log/LogEventStream.h>
-#include <http/HttpResponse.h>
 
 #include <sys/stat.h> // stat for isValidScript method
 #include <utility> //std::move
 
-using namespace arras4::network;
 using namespace arras4::api;
 
 namespace arras4 {
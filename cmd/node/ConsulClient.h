@@ -6,7 +6,6 @@
 
 #include "ServiceClient.h"
 #include <message_api/Object.h>
-#include <http/HttpRequest.h>
 
 #include <memory>
 #include <string>
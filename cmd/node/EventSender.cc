@@ -0,0 +1,205 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "EventSender.h"
+
+#include <arras4_log/Logger.h>
+#include <arras4_log/LogEventStream.h>
+
+#include <algorithm>
+#include <exception>
+
+namespace arras4 {
+    namespace node {
+
+EventSender::EventSender(unsigned threadCount,
+                         unsigned maxBatch,
+                         SendFunc send,
+                         BatchFunc sendBatch) :
+    mMaxBatch(std::max(1u, maxBatch)),
+    mSend(send),
+    mSendBatch(sendBatch),
+    mBatching(maxBatch > 1 && sendBatch)
+{
+    threadCount = std::max(1u, threadCount);
+    for (unsigned i = 0; i < threadCount; i++) {
+        mThreads.emplace_back(&EventSender::proc, this);
+    }
+}
+
+EventSender::~EventSender()
+{
+    stop();
+}
+
+void EventSender::push(const EventObj& event,
+                       Clock::time_point notBefore)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mStopping)
+            return;
+        Strand& strand = mStrands[event.sessionId];
+        strand.items.push_back(Item{event, Clock::now(), notBefore});
+        mQueued++;
+        // a running strand is put back on the ready queue when its
+        // current events have been sent
+        if (strand.running || strand.items.size() > 1)
+            return;
+        mReady.push_back(event.sessionId);
+    }
+    mCondition.notify_one();
+}
+
+bool EventSender::waitUntilEmpty(const std::chrono::microseconds& timeout)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    return mIdle.wait_for(lock, timeout,
+                          [this]() { return mStopping || (mQueued == 0 && mSending == 0); });
+}
+
+void EventSender::stop()
+{
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+        threads.swap(mThreads);
+        if (mQueued) {
+            ARRAS_WARN(log::Id("eventsDiscarded") <<
+                       "Discarding " << mQueued << " events that were not sent to Coordinator");
+        }
+        mStrands.clear();
+        mReady.clear();
+        mQueued = 0;
+    }
+    mCondition.notify_all();
+    mIdle.notify_all();
+    for (std::thread& thread : threads) {
+        if (thread.joinable())
+            thread.join();
+    }
+}
+
+void EventSender::proc()
+{
+    log::Logger::instance().setThreadName("nodeservice-eventhandler");
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mCondition.wait(lock, [this]() { return mStopping || !mReady.empty(); });
+        if (mStopping)
+            break;
+
+        api::UUID sessionId = mReady.front();
+        mReady.pop_front();
+        mStrands[sessionId].running = true;
+
+        // an event that is held back holds back the rest of its session,
+        // but this thread is the only one working on the session, so the
+        // lock can be released while waiting
+        Clock::time_point notBefore = mStrands[sessionId].items.front().notBefore;
+        if (notBefore > Clock::now()) {
+            lock.unlock();
+            std::this_thread::sleep_until(notBefore);
+            lock.lock();
+            if (mStopping)
+                break;
+        }
+
+        // take the first event, and any that can go with it in a batch
+        Strand& strand = mStrands[sessionId];
+        std::vector<Item> items;
+        size_t limit = mBatching ? mMaxBatch : 1;
+        Clock::time_point now = Clock::now();
+        while (!strand.items.empty() && items.size() < limit &&
+               (items.empty() || strand.items.front().notBefore <= now)) {
+            items.push_back(std::move(strand.items.front()));
+            strand.items.pop_front();
+        }
+        mQueued -= items.size();
+        mSending += items.size();
+
+        lock.unlock();
+        deliver(items);
+        Clock::time_point end = Clock::now();
+        lock.lock();
+
+        mSending -= items.size();
+        if (items.size() > 1)
+            mBatches++;
+        for (const Item& item : items) {
+            double latencyMs = std::chrono::duration<double,std::milli>(end - item.queued).count();
+            mSent++;
+            mTotalLatencyMs += latencyMs;
+            mMaxLatencyMs = std::max(mMaxLatencyMs, latencyMs);
+        }
+        if (mStopping)
+            break;
+        auto it = mStrands.find(sessionId);
+        if (it != mStrands.end()) {
+            it->second.running = false;
+            if (it->second.items.empty()) {
+                mStrands.erase(it);
+            } else {
+                mReady.push_back(sessionId);
+                mCondition.notify_one();
+            }
+        }
+        if (mQueued == 0 && mSending == 0)
+            mIdle.notify_all();
+    }
+}
+
+// send events to Coordinator : failures are logged, and the events are
+// not retried
+void EventSender::deliver(std::vector<Item>& items)
+{
+    if (items.size() > 1) {
+        std::vector<EventObj> batch;
+        for (const Item& item : items)
+            batch.push_back(item.event);
+        try {
+            if (mSendBatch(batch))
+                return;
+            ARRAS_WARN(log::Id("eventBatchUnsupported") <<
+                       "Coordinator doesn't accept event batches : sending events singly");
+            mBatching = false;
+        } catch (std::exception& e) {
+            ARRAS_ERROR(log::Id("HandleEventFail") <<
+                        "Error sending event batch in NodeService: " << e.what());
+            return;
+        } catch (...) {
+            ARRAS_ERROR(log::Id("HandleEventFail") <<
+                        "Unknown error sending event batch in NodeService");
+            return;
+        }
+    }
+    for (const Item& item : items) {
+        try {
+            mSend(item.event);
+        } catch (std::exception& e) {
+            ARRAS_ERROR(log::Id("HandleEventFail") <<
+                        "Error handling event in NodeService: " << e.what());
+        } catch (...) {
+            ARRAS_ERROR(log::Id("HandleEventFail") <<
+                        "Unknown error handling event in NodeService");
+        }
+    }
+}
+
+void EventSender::getStats(api::ObjectRef out) const
+{
+    api::ObjectRef events = out["events"];
+    std::lock_guard<std::mutex> lock(mMutex);
+    events["threads"] = static_cast<Json::UInt64>(mThreads.size());
+    events["batching"] = mBatching.load();
+    events["queued"] = static_cast<Json::UInt64>(mQueued);
+    events["sending"] = static_cast<Json::UInt64>(mSending);
+    events["sent"] = static_cast<Json::UInt64>(mSent);
+    events["batches"] = static_cast<Json::UInt64>(mBatches);
+    events["meanLatencyMs"] = mSent ? mTotalLatencyMs / mSent : 0.0;
+    events["maxLatencyMs"] = mMaxLatencyMs;
+}
+
+}
+}
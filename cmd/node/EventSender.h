@@ -0,0 +1,120 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __ARRAS4_EVENT_SENDER_H__
+#define __ARRAS4_EVENT_SENDER_H__
+
+#include <message_api/Object.h>
+#include <message_api/UUID.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace arras4 {
+    namespace node {
+
+// used to hold events on a queue so that
+// they can be sent to Coordinator asynchronously
+class EventObj
+{
+public:
+    EventObj() {}
+    EventObj(const api::UUID& aSessionId,
+	     const api::UUID& aCompId,
+	     api::ObjectConstRef aData) :
+    sessionId(aSessionId), compId(aCompId), data(aData)
+    {}
+    api::UUID sessionId;
+    api::UUID compId;
+    api::Object data;
+};
+
+// EventSender delivers events to Coordinator on a pool of threads, so
+// that a burst of events (e.g. when a large session terminates) isn't
+// sent one request at a time. Events for the same session are sent one
+// at a time, in the order they were pushed : each session has its own
+// queue, and a session is handled by at most one thread at once. Events
+// for different sessions are sent in parallel, up to the pool size.
+//
+// An event can be held back until a given time : this delays the events
+// of a session behind it, but not those of other sessions.
+//
+// If maxBatch is greater than 1, events that are ready to go for the
+// same session are passed to the batch function together, up to maxBatch
+// at a time. If the batch function returns false (Coordinator doesn't
+// support batches) batching is turned off, and the events are sent singly
+class EventSender
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using SendFunc = std::function<void(const EventObj&)>;
+    using BatchFunc = std::function<bool(const std::vector<EventObj>&)>;
+
+    EventSender(unsigned threadCount,
+                unsigned maxBatch,
+                SendFunc send,
+                BatchFunc sendBatch);
+    ~EventSender();
+
+    // queue an event, to be sent no earlier than notBefore
+    void push(const EventObj& event,
+              Clock::time_point notBefore = Clock::time_point());
+
+    // wait until every queued event has been sent, or timeout expires.
+    // Returns false on timeout
+    bool waitUntilEmpty(const std::chrono::microseconds& timeout);
+
+    // stop the threads once the events being sent are done. Events
+    // still queued are discarded
+    void stop();
+
+    // pool size, queue depth, counts and delivery times, as "events" in out
+    void getStats(api::ObjectRef out) const;
+
+private:
+    struct Item {
+        EventObj event;
+        Clock::time_point queued;
+        Clock::time_point notBefore;
+    };
+    struct Strand {
+        std::deque<Item> items;
+        bool running = false;
+    };
+
+    void proc();
+    void deliver(std::vector<Item>& items);
+
+    const unsigned mMaxBatch;
+    SendFunc mSend;
+    BatchFunc mSendBatch;
+    std::atomic<bool> mBatching;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mCondition;   // wakes the threads
+    std::condition_variable mIdle;        // signalled when nothing is left to send
+    bool mStopping = false;
+    std::map<api::UUID,Strand> mStrands;  // sessions with events queued or being sent
+    std::deque<api::UUID> mReady;         // sessions with an event ready to send
+    size_t mQueued = 0;
+    size_t mSending = 0;
+
+    // statistics, protected by mMutex
+    unsigned long long mSent = 0;
+    unsigned long long mBatches = 0;
+    double mTotalLatencyMs = 0;
+    double mMaxLatencyMs = 0;
+
+    std::vector<std::thread> mThreads;
+};
+
+}
+}
+#endif
@@ -0,0 +1,238 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "HttpClient.h"
+
+#include <arras4_log/Logger.h>
+#include <arras4_log/LogEventStream.h>
+
+#include <algorithm>
+
+namespace {
+
+const char* USER_AGENT = "Node Service";
+
+// scheme://host:port part of a url, which identifies the pool to use
+std::string hostKey(const std::string& url)
+{
+    size_t start = url.find("://");
+    start = (start == std::string::npos) ? 0 : start + 3;
+    size_t end = url.find('/', start);
+    return url.substr(0, end);
+}
+
+size_t writeBody(char* data, size_t size, size_t count, void* body)
+{
+    static_cast<std::string*>(body)->append(data, size * count);
+    return size * count;
+}
+
+}
+
+namespace arras4 {
+    namespace node {
+
+HttpClient& HttpClient::instance()
+{
+    static HttpClient client;
+    return client;
+}
+
+HttpClient::HttpClient()
+{
+    curl_global_init(CURL_GLOBAL_ALL);
+    mShare = curl_share_init();
+    curl_share_setopt(mShare, CURLSHOPT_LOCKFUNC, &HttpClient::lockShare);
+    curl_share_setopt(mShare, CURLSHOPT_UNLOCKFUNC, &HttpClient::unlockShare);
+    curl_share_setopt(mShare, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(mShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+}
+
+HttpClient::~HttpClient()
+{
+    for (auto& entry : mPools) {
+        for (CURL* handle : entry.second.idle)
+            curl_easy_cleanup(handle);
+    }
+    curl_share_cleanup(mShare);
+}
+
+void HttpClient::configure(const HttpClientOptions& options)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mOptions = options;
+    if (mOptions.maxConnectionsPerHost == 0)
+        mOptions.maxConnectionsPerHost = 1;
+}
+
+// the share only holds the DNS cache, so one mutex is enough
+void HttpClient::lockShare(CURL*, curl_lock_data, curl_lock_access, void* client)
+{
+    static_cast<HttpClient*>(client)->mShareMutex.lock();
+}
+
+void HttpClient::unlockShare(CURL*, curl_lock_data, void* client)
+{
+    static_cast<HttpClient*>(client)->mShareMutex.unlock();
+}
+
+// get a connection to host, waiting until deadline if all of the host's
+// connections are in use. Returns nullptr on timeout
+CURL* HttpClient::acquire(const std::string& host,
+                          std::chrono::steady_clock::time_point deadline)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    HostPool& pool = mPools[host];
+    if (pool.inUse >= mOptions.maxConnectionsPerHost) {
+        pool.waits++;
+        if (!mReleased.wait_until(lock, deadline, [&]() {
+                    return pool.inUse < mOptions.maxConnectionsPerHost; }))
+            return nullptr;
+    }
+    pool.inUse++;
+    if (!pool.idle.empty()) {
+        CURL* handle = pool.idle.back();
+        pool.idle.pop_back();
+        return handle;
+    }
+    lock.unlock();
+    CURL* handle = curl_easy_init();
+    if (!handle) {
+        lock.lock();
+        pool.inUse--;
+        mReleased.notify_all();
+    }
+    return handle;
+}
+
+void HttpClient::release(const std::string& host, CURL* handle,
+                         bool failed, bool newConnection, double ms)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        HostPool& pool = mPools[host];
+        pool.inUse--;
+        pool.requests++;
+        pool.totalMs += ms;
+        if (failed)
+            pool.failures++;
+        if (newConnection)
+            pool.newConnections++;
+        // the handle keeps its connection open for the next request
+        pool.idle.push_back(handle);
+    }
+    // waiters for every host share the condition, so wake them all :
+    // waking one could pick a waiter for another host
+    mReleased.notify_all();
+}
+
+HttpResult HttpClient::request(const std::string& method,
+                               const std::string& url,
+                               const Headers& headers,
+                               const std::string& body,
+                               unsigned timeoutSecs)
+{
+    HttpResult result;
+    HttpClientOptions options;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        options = mOptions;
+    }
+    if (timeoutSecs == 0)
+        timeoutSecs = options.requestTimeoutSecs;
+
+    // waiting for a connection counts against the request's timeout
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point deadline = start + std::chrono::seconds(timeoutSecs);
+    std::string host = hostKey(url);
+    CURL* handle = acquire(host, deadline);
+    if (!handle) {
+        result.error = "Timed out waiting for a connection to " + host;
+        return result;
+    }
+    long remainingMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now()).count();
+
+    // reset clears the options from the last request, but keeps
+    // the open connection
+    curl_easy_reset(handle);
+    curl_easy_setopt(handle, CURLOPT_SHARE, mShare);
+    curl_easy_setopt(handle, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(handle, CURLOPT_USERAGENT, USER_AGENT);
+    curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+#if LIBCURL_VERSION_NUM >= 0x074100
+    curl_easy_setopt(handle, CURLOPT_MAXAGE_CONN, static_cast<long>(options.maxIdleSecs));
+#endif
+    curl_easy_setopt(handle, CURLOPT_DNS_CACHE_TIMEOUT, static_cast<long>(options.dnsCacheSecs));
+    curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT, static_cast<long>(options.connectTimeoutSecs));
+    curl_easy_setopt(handle, CURLOPT_TIMEOUT_MS, std::max(1L, remainingMs));
+    curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, &writeBody);
+    curl_easy_setopt(handle, CURLOPT_WRITEDATA, &result.body);
+
+    if (method == "GET") {
+        curl_easy_setopt(handle, CURLOPT_HTTPGET, 1L);
+    } else {
+        curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, method.c_str());
+    }
+    // the body is always sent with a Content-Length, never chunked :
+    // Consul doesn't handle chunked PUT requests
+    if (!body.empty() || method == "PUT" || method == "POST") {
+        curl_easy_setopt(handle, CURLOPT_POSTFIELDS, body.data());
+        curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE, static_cast<long>(body.size()));
+    }
+
+    struct curl_slist* headerList = nullptr;
+    bool hasContentType = false;
+    for (const auto& header : headers) {
+        if (header.first == "Content-Type")
+            hasContentType = true;
+        headerList = curl_slist_append(headerList, (header.first + ": " + header.second).c_str());
+    }
+    if (!hasContentType)
+        headerList = curl_slist_append(headerList, "Content-Type: application/json");
+    // don't wait for a "100 Continue" before sending the body
+    headerList = curl_slist_append(headerList, "Expect:");
+    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, headerList);
+
+    CURLcode code = curl_easy_perform(handle);
+    long connects = 0;
+    curl_easy_getinfo(handle, CURLINFO_NUM_CONNECTS, &connects);
+    if (code == CURLE_OK) {
+        long responseCode = 0;
+        curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &responseCode);
+        result.responseCode = static_cast<int>(responseCode);
+    } else {
+        result.error = curl_easy_strerror(code);
+        ARRAS_DEBUG("(HttpClient) " << method << " " << url << " failed : " << result.error);
+    }
+    // the header list is referenced by the handle until its next reset
+    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, nullptr);
+    curl_slist_free_all(headerList);
+
+    double ms = std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now() - start).count();
+    release(host, handle, code != CURLE_OK, connects > 0, ms);
+    return result;
+}
+
+void HttpClient::getStats(api::ObjectRef out) const
+{
+    api::ObjectRef stats = out["httpClient"];
+    std::lock_guard<std::mutex> lock(mMutex);
+    stats["maxConnectionsPerHost"] = mOptions.maxConnectionsPerHost;
+    stats["hosts"] = Json::objectValue;
+    for (const auto& entry : mPools) {
+        const HostPool& pool = entry.second;
+        api::ObjectRef host = stats["hosts"][entry.first];
+        host["requests"] = static_cast<Json::UInt64>(pool.requests);
+        host["newConnections"] = static_cast<Json::UInt64>(pool.newConnections);
+        host["failures"] = static_cast<Json::UInt64>(pool.failures);
+        host["waits"] = static_cast<Json::UInt64>(pool.waits);
+        host["inUse"] = pool.inUse;
+        host["idle"] = static_cast<Json::UInt64>(pool.idle.size());
+        host["meanMs"] = pool.requests ? pool.totalMs / pool.requests : 0.0;
+    }
+}
+
+}
+}
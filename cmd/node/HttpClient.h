@@ -0,0 +1,105 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __ARRAS4_HTTP_CLIENT_H__
+#define __ARRAS4_HTTP_CLIENT_H__
+
+#include <message_api/Object.h>
+
+#include <curl/curl.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// HttpClient makes the node's outbound HTTP requests (to Coordinator, Consul
+// and the configuration service) over pooled keep-alive connections, rather
+// than opening a new connection for every request. Each host has a pool of
+// connections, limited in size : when they are all in use, a request waits
+// for one to be returned. Idle connections are reused most recently used
+// first, and are dropped by libcurl when they have been idle for too long
+// or the server has closed them. Host name lookups are cached and shared by
+// all connections.
+//
+// There is one client per process, shared by all threads : call
+// configure() at startup, before any requests are made.
+
+namespace arras4 {
+    namespace node {
+
+struct HttpClientOptions
+{
+    unsigned maxConnectionsPerHost = 8;
+    unsigned connectTimeoutSecs = 5;
+    unsigned requestTimeoutSecs = 60;    // used when a request doesn't specify one
+    unsigned maxIdleSecs = 60;           // idle connections older than this are not reused
+    unsigned dnsCacheSecs = 60;
+};
+
+struct HttpResult
+{
+    int responseCode = 0;    // 0 if no response was received
+    std::string body;
+    std::string error;       // set if no response was received
+};
+
+class HttpClient
+{
+public:
+    using Headers = std::map<std::string,std::string>;
+
+    static HttpClient& instance();
+    void configure(const HttpClientOptions& options);
+
+    // send a request and wait for the response. method is "GET", "PUT",
+    // "POST" or "DELETE". timeoutSecs of 0 uses the default request timeout.
+    // Doesn't throw : failures to get a response are returned in
+    // HttpResult::error
+    HttpResult request(const std::string& method,
+                       const std::string& url,
+                       const Headers& headers = Headers(),
+                       const std::string& body = std::string(),
+                       unsigned timeoutSecs = 0);
+
+    // connection counts per host, as "httpClient" in out
+    void getStats(api::ObjectRef out) const;
+
+private:
+    HttpClient();
+    ~HttpClient();
+    HttpClient(const HttpClient&) = delete;
+    HttpClient& operator=(const HttpClient&) = delete;
+
+    struct HostPool {
+        std::vector<CURL*> idle;
+        unsigned inUse = 0;
+        unsigned long long requests = 0;
+        unsigned long long newConnections = 0;
+        unsigned long long failures = 0;
+        unsigned long long waits = 0;    // requests that had to wait for a connection
+        double totalMs = 0;
+    };
+
+    CURL* acquire(const std::string& host,
+                  std::chrono::steady_clock::time_point deadline);
+    void release(const std::string& host, CURL* handle,
+                 bool failed, bool newConnection, double ms);
+
+    static void lockShare(CURL*, curl_lock_data data, curl_lock_access access, void* client);
+    static void unlockShare(CURL*, curl_lock_data data, void* client);
+
+    CURLSH* mShare = nullptr;
+    std::mutex mShareMutex;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mReleased;
+    HttpClientOptions mOptions;
+    std::map<std::string,HostPool> mPools;  // by scheme://host:port
+};
+
+}
+}
+#endif
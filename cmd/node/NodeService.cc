@@ -3,6 +3,7 @@
 
 #include "NodeService.h"
 #include "ArrasNode.h"
+#include "HttpClient.h"
 
 #include <message_api/Object.h>
 #include <arras4_log/Logger.h>
@@ -12,7 +13,6 @@
 #include <session/ArrasSessions.h>
 
 #include <http/http_types.h>
-#include <http/HttpRequest.h>
 #include <httpserver/HttpServerRequest.h>
 #include <httpserver/HttpServerResponse.h>
 
@@ -40,10 +40,22 @@ namespace {
 
 const std::string UNKNOWN_EXCEPTION_THROWN("Unknown exception thrown in server");
     
-const std::string USER_AGENT("Node Service");
-
 const std::string NODE_API_VERSION("4.5");
 
+// the window after session creation in which deletes are held back
+const std::chrono::milliseconds DELETE_AFTER_CREATE_DELAY(50);
+
+// events that map to a DELETE request on Coordinator
+bool isDeleteEvent(const std::string& eventType)
+{
+    return eventType == "computationTerminated" ||
+        eventType == "sessionClientDisconnected" ||
+        eventType == "sessionOperationFailed" ||
+        eventType == "sessionExpired" ||
+        eventType == "sessionRouterFailure" ||
+        eventType == "sessionShutdown";
+}
+
 arras4::api::Object getPayload(const HttpServerRequest &req)
 {
     api::Object payload;
@@ -58,6 +70,12 @@ arras4::api::Object getPayload(const HttpServerRequest &req)
     return payload;
 }
 
+// text to log for a response : the body, or why there wasn't one
+std::string responseText(const HttpResult& result)
+{
+    return result.error.empty() ? result.body : result.error;
+}
+
 // We can't send a header value containing newlines..
 std::string replaceNewlines(const std::string& s)
 {
@@ -70,6 +88,8 @@ std::string replaceNewlines(const std::string& s)
 
 NodeService::NodeService(unsigned numServerThreads,
 			 bool useBanlist,
+			 unsigned numEventThreads,
+			 unsigned eventBatchSize,
 			 const std::string& coordBaseUrl,
                          ArrasNode& node,
                          ArrasSessions& sessions)
@@ -81,7 +101,9 @@ NodeService::NodeService(unsigned numServerThreads,
       mPutRouter(std::bind(&NodeService::PUT_unhandled,this,_1,_2)),
       mPostRouter(std::bind(&NodeService::POST_unhandled,this,_1,_2)),
       mDeleteRouter(std::bind(&NodeService::DELETE_unhandled,this,_1,_2)),
-      mEventQueue("send-events")
+      mEventSender(numEventThreads, eventBatchSize,
+                   [this](const EventObj& event) { sendEvent(event); },
+                   [this](const std::vector<EventObj>& events) { return sendEventBatch(events); })
 {
     mHttpPort = mHttpServer.getListenPort();
     ARRAS_INFO("NodeService listening on HTTP port " << mHttpPort);
@@ -98,6 +120,7 @@ NodeService::NodeService(unsigned numServerThreads,
     // Can't use std::bind with the overloads of add(), because it will match against all of them...
     mGetRouter.add("node/1/health",[this](const HSReq &req, HSResp &resp) { GET_health(req,resp); });
     mGetRouter.add("node/1/status",[this](const HSReq &req, HSResp &resp) { GET_status(req,resp); });
+    mGetRouter.add("node/1/network",[this](const HSReq &req, HSResp &resp) { GET_network(req,resp); });
     mGetRouter.add("node/1/sessions",[this](const HSReq &req, HSResp &resp) { GET_sessions(req,resp); });
     mGetRouter.add("node/1/sessions/*/status",[this](const HSReq &req, HSResp &resp,const std::string& s) 
                    { GET_sessionStatus(req,resp,s); });
@@ -127,16 +150,11 @@ NodeService::NodeService(unsigned numServerThreads,
                      { DELETE_tag(req,resp,s); }); 
     mDeleteRouter.add("node/tags",[this](const HSReq &req, HSResp &resp)
                      { DELETE_tags(req,resp); });
-
-    mSendEventsThread = std::thread(&NodeService::sendEventsProc,this);
 }
 
 NodeService::~NodeService()
 {
-    mRunThreads = false;
-    mEventQueue.shutdown();
-    if (mSendEventsThread.joinable())
-	mSendEventsThread.join();
+    mEventSender.stop();
 }
 
 void NodeService::GET_unhandled(const HSReq &req, HSResp &resp)
@@ -180,6 +198,10 @@ void NodeService::GET_status(const HSReq &, HSResp &resp)
         mNode.checkHealth();
         body["status"] = "UP";
 	mSessions.getIdleStatus(body);
+	mSessions.getRezCacheStatus(body);
+	mSessions.getOperationStatus(body);
+	mEventSender.getStats(body);
+	HttpClient::instance().getStats(body);
 	mBanList.getSummary(body);
 	body["apiVersion"] = NODE_API_VERSION;
         resp.setContentType("application/json");
@@ -199,6 +221,21 @@ void NodeService::GET_status(const HSReq &, HSResp &resp)
     }
 }
 
+// return the router's latest measurements of the links to other nodes,
+// keyed by node id
+void NodeService::GET_network(const HSReq &, HSResp &resp)
+{
+    try {
+        api::Object body = mSessions.getController()->nodeNetwork();
+        resp.setContentType("application/json");
+        resp.setResponseCode(HTTP_OK);
+        resp.write(body.toStyledString());
+    } catch (...) {
+        resp.setResponseCode(HTTP_INTERNAL_SERVER_ERROR);
+        resp.setResponseText(UNKNOWN_EXCEPTION_THROWN);
+    }
+}
+
 // return a list of active session ids
 void NodeService::GET_sessions(const HSReq &, HSResp &resp)
 {
@@ -362,6 +399,10 @@ void NodeService::POST_sessions(const HSReq &req, HSResp &resp)
 {
     try { 
         api::Object payload = getPayload(req);
+        // noted before the session starts, in case it fails straight away
+        api::ObjectConstRef sessionId = payload[mSessions.nodeId().toString()]["config"]["sessionId"];
+        if (sessionId.isString())
+            noteSessionCreated(api::UUID(sessionId.asString()));
         api::Object reply = mSessions.createSession(payload);
         std::string replyStr = api::objectToString(reply);
         resp.setResponseCode(HTTP_OK);
@@ -394,10 +435,17 @@ void NodeService::DELETE_session(const HSReq &req, HSResp &resp,
         req.header("X-Session-Delete-Reason",reasonStr);
 	ARRAS_DEBUG("NodeService received DELETE session " << 
 		    sessionIdStr << " reason: " << reasonStr);
-        mSessions.deleteSession(id,reasonStr); 
+        Session::OperationId opId = mSessions.deleteSession(id,reasonStr); 
         resp.setContentType("application/json"); 
         resp.setResponseCode(HTTP_OK);
-        resp.write("{ \"success\": \"true\"}");
+        if (opId) {
+            api::Object reply;
+            reply["success"] = "true";
+            reply["operationId"] = static_cast<Json::UInt64>(opId);
+            resp.write(api::objectToString(reply));
+        } else {
+            resp.write("{ \"success\": \"true\"}");
+        }
     } catch (OperationError& err) {
         resp.setResponseCode(err.httpCode());
         resp.setResponseText(err.what());
@@ -449,21 +497,17 @@ bool NodeService::registerNode(api::ObjectConstRef nodeInfo)
 {
     std::string url = mCoordinatorBaseUrl + "/nodes";
 
-    HttpRequest req(url, POST);
-    req.setContentType(APPLICATION_JSON);
-    req.setUserAgent(USER_AGENT);
     std::string body = api::objectToString(nodeInfo);
 
     std::string id = "[UNKNOWN]";
     if (nodeInfo["id"].isString()) id = nodeInfo["id"].asString();
     ARRAS_INFO("Registering Node ID " + id + " with Coordinator");
-     const HttpResponse &resp = req.submit(body);
-    auto responseCode = resp.responseCode();
+    HttpResult resp = HttpClient::instance().request("POST", url, HttpClient::Headers(), body);
+    auto responseCode = resp.responseCode;
 
     if (responseCode < HTTP_OK ||
 	responseCode >= HTTP_MULTIPLE_CHOICES) {
-	std::string responseString("[NO DATA]");
-	resp.getResponseString(responseString); 
+	std::string responseString = responseText(resp);
 	ARRAS_ERROR(log::Id("NodeRegisterFail") <<
 		    "(NodeService) Node Registration ('POST " + url +
 		    "') returned unacceptable status code " +
@@ -478,18 +522,13 @@ bool NodeService::deregisterNode(const api::UUID& nodeId)
 {
     std::string url = mCoordinatorBaseUrl + "/nodes/" + nodeId.toString();
 
-    HttpRequest req(url, DELETE);
-    req.setContentType(APPLICATION_JSON);
-    req.setUserAgent(USER_AGENT);
-
     ARRAS_INFO("Deregistering Node ID " + nodeId.toString() + " from Coordinator");
-    const HttpResponse &resp = req.submit();
-    auto responseCode = resp.responseCode();
+    HttpResult resp = HttpClient::instance().request("DELETE", url);
+    auto responseCode = resp.responseCode;
 
     if (responseCode < HTTP_OK ||
 	responseCode >= HTTP_MULTIPLE_CHOICES) {
-	std::string responseString("[NO DATA]");
-	resp.getResponseString(responseString); 
+	std::string responseString = responseText(resp);
 	ARRAS_ERROR(log::Id("NodeDeregisterFail") <<
 		    "(NodeService) Node Deregistration ('DELETE " + url +
 		    "') returned unacceptable status code " +
@@ -500,39 +539,82 @@ bool NodeService::deregisterNode(const api::UUID& nodeId)
     return true;
 }
 
+void NodeService::noteSessionCreated(const api::UUID& sessionId)
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mRecentSessionsMutex);
+    // entries are only needed for the length of the delay
+    for (auto it = mRecentSessions.begin(); it != mRecentSessions.end(); ) {
+        if (now - it->second >= DELETE_AFTER_CREATE_DELAY)
+            it = mRecentSessions.erase(it);
+        else
+            ++it;
+    }
+    mRecentSessions[sessionId] = now;
+}
+
+// earliest time a delete for the session can be sent : this is only
+// later than now for sessions created in the last few milliseconds
+std::chrono::steady_clock::time_point NodeService::deleteNotBefore(const api::UUID& sessionId)
+{
+    std::lock_guard<std::mutex> lock(mRecentSessionsMutex);
+    auto it = mRecentSessions.find(sessionId);
+    if (it == mRecentSessions.end())
+        return std::chrono::steady_clock::time_point();
+    return it->second + DELETE_AFTER_CREATE_DELAY;
+}
+
 // Outgoing notifications are queued so that caller doesn't
 // have to wait for http reply
 void NodeService::handleEvent(const api::UUID& sessionId,
 			      const api::UUID& compId,
 			      api::ObjectConstRef eventData)
 {
-    mEventQueue.push(EventObj(sessionId,compId,eventData));
+    std::chrono::steady_clock::time_point notBefore;
+    if (eventData["eventType"].isString() &&
+        isDeleteEvent(eventData["eventType"].asString()))
+        notBefore = deleteNotBefore(sessionId);
+    mEventSender.push(EventObj(sessionId,compId,eventData),notBefore);
 }
 
 void NodeService::drainEvents(const std::chrono::microseconds& timeout)
 {
-    mEventQueue.waitUntilEmpty(timeout);
-}
-
-void NodeService::sendEventsProc()
-{
-    log::Logger::instance().setThreadName("nodeservice-eventhandler");
-    while (mRunThreads) {
-	EventObj event;
-        try {     
-            bool popped = mEventQueue.pop(event);
-            if (popped)
-		sendEvent(event);
-        } catch (impl::ShutdownException&) {
-            // queue has been unblocked to give us a chance to exit
-        } catch (std::exception& e) {
-            ARRAS_ERROR(log::Id("HandleEventFail") <<
-			"Error handling event in NodeService: " << e.what());
-        } catch (...) {
-            ARRAS_ERROR(log::Id("HandleEventFail") <<
-			"Unknown error handling event in NodeService");
-        }
+    mEventSender.waitUntilEmpty(timeout);
+}
+
+// sends several events for a session in one request, with body
+// { "events": [ { "sessionId": <sessId>, "compId": <compId>, "eventType": ... }, ... ] }
+// maps to POST /events
+// returns false if Coordinator doesn't support the endpoint
+bool NodeService::sendEventBatch(const std::vector<EventObj>& events)
+{
+    api::Object bodyObj;
+    bodyObj["events"] = Json::arrayValue;
+    for (const EventObj& event : events) {
+	api::Object item = event.data;
+	item["sessionId"] = event.sessionId.toString();
+	if (!event.compId.isNull())
+	    item["compId"] = event.compId.toString();
+	bodyObj["events"].append(item);
+    }
+
+    std::string url = mCoordinatorBaseUrl + "/events";
+    ARRAS_DEBUG("Sending batch of " << events.size() << " events");
+    HttpResult resp = HttpClient::instance().request("POST", url, HttpClient::Headers(), api::objectToString(bodyObj));
+    std::string respStr = responseText(resp);
+    auto responseCode = resp.responseCode;
+
+    if (responseCode == HTTP_NOT_FOUND ||
+	responseCode == HTTP_METHOD_NOT_ALLOWED ||
+	responseCode == HTTP_NOT_IMPLEMENTED)
+	return false;
+    if (responseCode < HTTP_OK ||
+        responseCode >= HTTP_MULTIPLE_CHOICES) {
+	ARRAS_WARN(log::Id("BadEventResponse") <<
+		   "Coordinator returned unexpected response to POST .../events: " <<
+		   "code: " << responseCode << " text: " << respStr);
     }
+    return true;
 }
 
 void NodeService::sendEvent(const EventObj& event)
@@ -568,8 +650,14 @@ void NodeService::sendEvent(const EventObj& event)
 	notifyTerminateSession(event.sessionId, eventData);
     } else if (eventType == "sessionOperationFailed") {
 	notifyTerminateSession(event.sessionId, eventData);
+    } else if (eventType == "sessionOperationComplete") {
+	notifyOperationComplete(event.sessionId, eventData);
     } else if (eventType == "sessionExpired") {
 	notifyTerminateSession(event.sessionId, eventData);
+    } else if (eventType == "sessionRouterFailure") {
+	notifyTerminateSession(event.sessionId, eventData);
+    } else if (eventType == "sessionShutdown") {
+	notifyTerminateSession(event.sessionId, eventData);
     } else if (eventType == "shutdownWithError") {
         notifyShutdownWithError(eventData);
     } else {
@@ -586,28 +674,19 @@ void NodeService::notifyTerminated(const api::UUID& sessionId,
 				   const api::UUID& compId,
 				   api::ObjectConstRef eventData)
 {
-    // workaround for ARRAS-3567 : it isn't safe to send a delete
-    // too soon after session is created
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));
-    // end
-
     std::string url = mCoordinatorBaseUrl;
     url += "/sessions/" + sessionId.toString() + 
 	"/computations/" + compId.toString();
 
     // Initialize the request object.
-    HttpRequest req(url, DELETE);
-    req.setContentType(APPLICATION_JSON);
-    req.setUserAgent(USER_AGENT);
+    HttpClient::Headers headers;
 
     if (eventData["reason"].isString()) {
-	req.addHeader("X-Host-Delete-Reason",
-		      replaceNewlines(eventData["reason"].asString()));
+	headers["X-Host-Delete-Reason"] = replaceNewlines(eventData["reason"].asString());
     }
-    const HttpResponse &resp = req.submit();
-    std::string respStr("None"); 
-    auto responseCode = resp.responseCode();
-    resp.getResponseString(respStr); 
+    HttpResult resp = HttpClient::instance().request("DELETE", url, headers);
+    std::string respStr = responseText(resp);
+    auto responseCode = resp.responseCode;
 
     if (responseCode < HTTP_OK ||
         responseCode >= HTTP_MULTIPLE_CHOICES) {
@@ -630,15 +709,12 @@ void NodeService::notifyReady(const api::UUID& sessionId,
 	"/hosts/" + compId.toString();
 
     // Initialize the request object.
-    HttpRequest req(url, PUT);
-    req.setContentType(APPLICATION_JSON);
-    req.setUserAgent(USER_AGENT);
+    HttpClient::Headers headers;
 
     std::string body = "{ \"status\": \"ready\" }";
-    const HttpResponse &resp = req.submit(body);
-    std::string respStr("None"); 
-    auto responseCode = resp.responseCode();
-    resp.getResponseString(respStr); 
+    HttpResult resp = HttpClient::instance().request("PUT", url, headers, body);
+    std::string respStr = responseText(resp);
+    auto responseCode = resp.responseCode;
 
     if (responseCode < HTTP_OK ||
         responseCode >= HTTP_MULTIPLE_CHOICES) {
@@ -649,42 +725,82 @@ void NodeService::notifyReady(const api::UUID& sessionId,
     }
 }
 
+// eventType: "sessionOperationComplete"
+// maps to PUT /sessions/<sessId>/operations
+// with body { "nodeId": <nodeId>,
+//             "operation": "modify"|"delete", "operationIds": [...],
+//             "status": "complete"|"failed"|"superseded" }
+void NodeService::notifyOperationComplete(const api::UUID& sessionId,
+					  api::ObjectConstRef eventData)
+{
+    std::string url = mCoordinatorBaseUrl;
+    url += "/sessions/" + sessionId.toString() + "/operations";
+
+    // Initialize the request object.
+    HttpClient::Headers headers;
+
+    api::Object bodyObj;
+    bodyObj["nodeId"] = eventData["nodeId"];
+    bodyObj["operation"] = eventData["operation"];
+    bodyObj["operationIds"] = eventData["operationIds"];
+    bodyObj["status"] = eventData["status"];
+    HttpResult resp = HttpClient::instance().request("PUT", url, headers, api::objectToString(bodyObj));
+    std::string respStr = responseText(resp);
+    auto responseCode = resp.responseCode;
+
+    if (responseCode < HTTP_OK ||
+        responseCode >= HTTP_MULTIPLE_CHOICES) {
+	ARRAS_WARN(log::Id("BadEventResponse") <<
+		   log::Session(sessionId.toString()) <<
+		   "Coordinator returned unexpected response to PUT .../operations: " <<
+		   "code: " << responseCode << " text: " << respStr);
+    }
+}
+
 // used by a number of events that cause termination of the session
 // eventType: "sessionClientDisconnected"
 // eventType: "sessionOperationFailed"
 // eventType: "sessionExpired"
+// eventType: "sessionRouterFailure"
+// eventType: "sessionShutdown"
 void NodeService::notifyTerminateSession(const api::UUID& sessionId,
 					 api::ObjectConstRef data)
 {
-    // workaround for ARRAS-3567 : it isn't safe to send a delete
-    // too soon after session is created
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));
-    // end
-
     std::string url = mCoordinatorBaseUrl;
     url += "/sessions/" + sessionId.toString();
 
     // Initialize the request object.
-    HttpRequest req(url, DELETE);
-    req.setContentType(APPLICATION_JSON);
-    req.setUserAgent(USER_AGENT);
+    HttpClient::Headers headers;
  
     // not currently used by Coordinator
-    req.addHeader("X-Arras-Event-Type",
-		  replaceNewlines(data["eventType"].asString()));
+    headers["X-Arras-Event-Type"] = replaceNewlines(data["eventType"].asString());
 
     if (data["reason"].isString()) {
-	req.addHeader("X-Session-Delete-Reason",
-		      replaceNewlines(data["reason"].asString()));
+	headers["X-Session-Delete-Reason"] = replaceNewlines(data["reason"].asString());
     } else {
-	req.addHeader("X-Session-Delete-Reason",
-		      replaceNewlines(data["eventType"].asString()));
+	headers["X-Session-Delete-Reason"] = replaceNewlines(data["eventType"].asString());
+    }
+
+    // the router's traffic summary for the session, if there is one,
+    // is logged and sent as the body of the request, along with
+    // the exit status of the computations if the node is shutting down
+    std::string body;
+    api::Object bodyObj;
+    if (data["traffic"].isObject()) {
+	bodyObj["traffic"] = data["traffic"];
+	ARRAS_INFO(log::Session(sessionId.toString()) <<
+		   "Session traffic at " << data["eventType"].asString() << " : " <<
+		   api::objectToString(data["traffic"]));
+    }
+    if (data["computations"].isArray() && !data["computations"].empty()) {
+	bodyObj["computations"] = data["computations"];
     }
+    if (!bodyObj.isNull())
+	body = api::objectToString(bodyObj);
 
-    const HttpResponse &resp = req.submit();
-    std::string respStr("None"); 
-    auto responseCode = resp.responseCode();
-    resp.getResponseString(respStr); 
+    HttpResult resp = HttpClient::instance().request("DELETE", url, headers, body);
+    std::string respStr = responseText(resp);
+    auto responseCode = resp.responseCode;
     ARRAS_DEBUG("Sent DELETE session request to Coordinator");
     if (responseCode < HTTP_OK ||
         responseCode >= HTTP_MULTIPLE_CHOICES) {
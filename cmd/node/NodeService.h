@@ -6,13 +6,15 @@
 
 #include "UrlRouter.h"
 #include "BanList.h"
-
-#include <shared_impl/ThreadsafeQueue.h>
+#include "EventSender.h"
 
 #include <httpserver/HttpServer.h>
 #include <session/EventHandler.h>
 
 #include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
 
 using HSReq = arras4::network:: HttpServerRequest;
 using HSResp = arras4::network:: HttpServerResponse;
@@ -25,28 +27,14 @@ namespace arras4 {
 class ArrasNode;
 class ArrasSessions;
 
-// used to hold events on a queue so that
-// they can be sent to Coordinator asynchronously
-class EventObj
-{
-public:
-    EventObj() {}
-    EventObj(const api::UUID& aSessionId,
-	     const api::UUID& aCompId,
-	     api::ObjectConstRef aData) :
-    sessionId(aSessionId), compId(aCompId), data(aData) 
-    {}
-    api::UUID sessionId;
-    api::UUID compId;
-    api::Object data;
-};
-
 class NodeService : public EventHandler
 {
 public:
     // mHttpPort will be initialized with the actual port.
     NodeService(unsigned numServerThreads,
 		bool useBanList,
+		unsigned numEventThreads,
+		unsigned eventBatchSize,
 		const std::string& coordinatorBaseUrl,
                 ArrasNode& node,
                 ArrasSessions& sessions);
@@ -83,6 +71,7 @@ private:
     void GET_unhandled(const HSReq &req, HSResp &resp);
     void GET_health(const HSReq &req, HSResp &resp); 
     void GET_status(const HSReq &req, HSResp &resp);
+    void GET_network(const HSReq &req, HSResp &resp);
     void GET_sessions(const HSReq &req, HSResp &resp);
     void GET_sessionStatus(const HSReq &req, HSResp &resp,
                            const std::string& sessionIdStr);
@@ -110,18 +99,26 @@ private:
 
   
     
+    // workaround for ARRAS-3567 : it isn't safe to send a delete too
+    // soon after session is created. Sessions are remembered here for
+    // long enough to hold back their delete events
+    std::mutex mRecentSessionsMutex;
+    std::map<api::UUID,std::chrono::steady_clock::time_point> mRecentSessions;
+    void noteSessionCreated(const api::UUID& sessionId);
+    std::chrono::steady_clock::time_point deleteNotBefore(const api::UUID& sessionId);
+
     // Outgoing notifications are queued and
-    // then sent to Coordinator on a background thread
-    impl::ThreadsafeQueue<EventObj> mEventQueue;
-    std::atomic<bool> mRunThreads{true};
-    std::thread mSendEventsThread;
-    void sendEventsProc();
+    // then sent to Coordinator on background threads
+    EventSender mEventSender;
     void sendEvent(const EventObj& event);
+    bool sendEventBatch(const std::vector<EventObj>& events);
     void notifyTerminated(const api::UUID& sessionId,
 			  const api::UUID& compId,
 			  api::ObjectConstRef eventData);
     void notifyReady(const api::UUID& sessionId,
 		     const api::UUID& compId);
+    void notifyOperationComplete(const api::UUID& sessionId,
+				 api::ObjectConstRef eventData);
     void notifyTerminateSession(const api::UUID& sessionId,
 				  api::ObjectConstRef eventData);
     // arras node to de-register with coordinator and orderly shutdown
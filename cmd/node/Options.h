@@ -27,6 +27,20 @@ public:
     std::string userName;
     std::string nodeId;
     bool disableBanlist = false;
+    // time allowed for all sessions to shut down when the node exits
+    // (including on a preemption notice)
+    unsigned shutdownTimeoutSecs = 30;
+    // threads sending events to Coordinator, and the most events
+    // for a session to send in one request (1 disables batching)
+    unsigned numEventThreads = 4;
+    unsigned eventBatchSize = 1;
+    // pooled connections for requests to Coordinator, Consul and
+    // the configuration service
+    unsigned httpMaxConnectionsPerHost = 8;
+    unsigned httpConnectTimeoutSecs = 5;
+    unsigned httpTimeoutSecs = 60;
+    unsigned httpMaxIdleSecs = 60;
+    unsigned httpDnsCacheSecs = 60;
 
     // These are options that control the service connections
     std::string coordinatorHost; 
@@ -3,10 +3,11 @@
 
 #include "ServiceClient.h"
 #include "ServiceError.h"
+#include "HttpClient.h"
 
 #include <arras4_log/Logger.h>
 #include <arras4_log/LogEventStream.h>
-#include <http/HttpResponse.h>
+#include <http/http_types.h>
 
 #include <cassert>
 #include <sstream>
@@ -15,10 +16,6 @@
 #include <sys/socket.h>
 #include <netdb.h>
 
-namespace {
-    const std::string USER_AGENT = "Node Service";
-}
-
 using namespace arras4::network;
 
 namespace arras4 {
@@ -38,19 +35,16 @@ ServiceClient::doGet(const std::string& path,
                      int timeout)
 {
     std::string url = mBaseUrl + path;
-    HttpRequest req(url);
-    for (const auto& sp : headers) {
-	req.addHeader(sp.first,sp.second);
-    }
-    req.setContentType(APPLICATION_JSON);
-    req.setUserAgent(USER_AGENT);
 
-    std::string responseString("[NO DATA]");
     ARRAS_DEBUG("(ServiceClient) GET " << url);
-    const HttpResponse &resp = req.submit(timeout);
-    auto responseCode = resp.responseCode();
-    resp.getResponseString(responseString); 
-    
+    HttpResult resp = HttpClient::instance().request("GET", url, headers, "", timeout);
+    if (resp.responseCode == 0) {
+	throw ServiceError("(ServiceClient) Request 'GET " + url +
+			   "' failed: " + resp.error);
+    }
+    auto responseCode = resp.responseCode;
+    const std::string& responseString = resp.body;
+
     if (responseCode < HTTP_OK ||
 	responseCode >= HTTP_MULTIPLE_CHOICES) {
 	throw ServiceError("(ServiceClient) Request 'GET " + url + 
@@ -73,37 +67,24 @@ void ServiceClient::doPut(const std::string& path,
 			  api::ObjectConstRef data, int timeout)
 {
     std::string url = mBaseUrl + path;
-    HttpRequest req(url,PUT);
-    req.setContentType(APPLICATION_JSON);
-    req.setUserAgent(USER_AGENT);
-
     std::string body = api::objectToString(data);
 
-    // The following is a workaround.
-    //
-    // Delete Transfer-Encoding and specify Content-Length for PUT requests so
-    // the request can be processed correctly. The libcurl library always sends
-    // PUT requests chunked but Consul does not provide the expected 100
-    // response for certain PUT requests (specifically, session create) tho
-    // other PUT requests appear to work correctly.
-    //
-    req.addHeader("Transfer-Encoding", ""); // No Transfer-Encoding in header
-    req.addHeader("Content-Length", std::to_string(body.length()));
-
+    // HttpClient sends the body with a Content-Length rather than chunked,
+    // which Consul requires for some PUT requests (specifically, session create)
     ARRAS_DEBUG("(ServiceClient) PUT " << url);
-    const HttpResponse &resp = req.submit(body, timeout);
-    auto responseCode = resp.responseCode();
+    HttpResult resp = HttpClient::instance().request("PUT", url, HttpClient::Headers(), body, timeout);
+    if (resp.responseCode == 0) {
+	throw ServiceError("(ServiceClient) Request 'PUT " + url +
+			   "' failed: " + resp.error);
+    }
+    auto responseCode = resp.responseCode;
 
     if (responseCode < HTTP_OK ||
 	responseCode >= HTTP_MULTIPLE_CHOICES) {
-
-	std::string responseString("[NO DATA]");
-	resp.getResponseString(responseString); 
-
 	throw ServiceError("(ServiceClient) Request 'PUT " + url +
 			   "' returned unacceptable status code " +
 			   std::to_string(responseCode) + "(response body: '" +
-			   responseString + "')");
+			   resp.body + "')");
     }
 }
 
@@ -5,7 +5,6 @@
 #define __ARRAS_SERVICE_CLIENT_H__
 
 #include <message_api/Object.h>
-#include <http/HttpRequest.h>
 
 #include <string>
 #include <map>
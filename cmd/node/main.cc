@@ -94,9 +94,31 @@ void parseCmdLine(int argc, char* argv[],
 	 "Suspend computations at startup, via SIGSTOP")
 	("rez-package-path-override", bpo::value<std::string>(&compDefs.packagePathOverride),
 	 "Override to REZ_PACKAGES_PATH, replacing both the default path and any specified in the session definition")
+	("rez-cache-dir", bpo::value<std::string>(&compDefs.rezCacheDir),
+	 "Directory to cache resolved rez environments in, shared across sessions (default: no cache)")
+	("rez-cache-ttl", bpo::value<unsigned>(&compDefs.rezCacheTtlSecs),
+	 "Time (in seconds) a cached rez environment can be used for, 0 for no limit")
+	("rez-cache-max-mb", bpo::value<size_t>(),
+	 "Maximum size of the rez environment cache in MB, 0 for no limit")
+	("rez-prewarm-count", bpo::value<unsigned>(&compDefs.rezPrewarmCount),
+	 "Number of the most launched rez environments to keep resolved in the cache in advance (requires rez-cache-dir)")
+	("rez-prewarm-interval", bpo::value<unsigned>(&compDefs.rezPrewarmIntervalSecs),
+	 "Time (in seconds) between checks of the rez environments kept resolved in advance")
         ("no-local-rez","Legacy option (ignored)")
 	("client-connection-timeout",bpo::value<unsigned>(&compDefs.clientConnectionTimeoutSecs),
 	 "Time (in seconds) allowed for client to connect before session expires")
+	("defunct-session-grace",bpo::value<unsigned>(&compDefs.defunctSessionGraceSecs),
+	 "Time (in seconds) a deleted session is kept before being discarded")
+	("session-tombstone-time",bpo::value<unsigned>(&compDefs.sessionTombstoneSecs),
+	 "Time (in seconds) a record of a discarded session is kept, to handle late requests for it")
+	("session-op-threads",bpo::value<unsigned>(&compDefs.sessionOpThreads),
+	 "Number of threads shared by all sessions to run create and modify operations")
+	("session-blocking-op-threads",bpo::value<unsigned>(&compDefs.sessionBlockingOpThreads),
+	 "Number of threads shared by all sessions to run delete operations, which wait for computations to exit")
+	("max-parallel-launches",bpo::value<unsigned>(&compDefs.maxParallelLaunches),
+	 "Maximum number of computations in a session launched at the same time (default 4, 1 to launch one after another)")
+	("launch-threads",bpo::value<unsigned>(&compDefs.launchThreads),
+	 "Number of threads shared by all sessions to launch computations (default 8)")
 ;
     // These are options that control the service connections
     bpo::options_description connSettings("Connection Settings");
@@ -113,6 +135,26 @@ void parseCmdLine(int argc, char* argv[],
         ("ipc-dir", bpo::value<std::string>(&opts.ipcDir),
 	 "Location to create domain socket file for IPC with computations.")
 	("dwa-config-service", bpo::value<std::string>(&opts.configServiceUrl))
+        ("router-receive-mode", bpo::value<std::string>(&compDefs.routerReceiveMode),
+	 "How router endpoints wait for messages: 'poll' (default) or 'blocking' (one less system call per message)")
+        ("router-capture-dir", bpo::value<std::string>(&compDefs.routerCaptureDir),
+	 "Capture router traffic to a trace file per session in this directory (see arras4_router_replay)")
+        ("router-shards", bpo::value<unsigned>(&compDefs.routerShards),
+	 "Split the router's session tables into this many shards, reducing lock contention on nodes with many sessions")
+        ("router-map-payloads-over", bpo::value<size_t>(&compDefs.routerMapPayloadsOver),
+	 "The router holds received payloads larger than this many bytes in file mappings in the IPC directory, rather than on the heap")
+        ("router-trace-spans", bpo::value<std::string>(&compDefs.routerTraceSpans),
+	 "Write per-hop timing spans for a sample of routed messages to this file")
+        ("router-trace-sample-rate", bpo::value<double>(&compDefs.routerTraceSampleRate),
+	 "Fraction of messages traced when --router-trace-spans is set (default 0.001)")
+        ("router-busy-poll-cpus", bpo::value<std::string>(&compDefs.routerBusyPollCpus),
+	 "Reserve these cpus (e.g. '6,7') for the router to busy poll latency-sensitive sessions")
+        ("router-busy-poll-idle-ms", bpo::value<unsigned>(&compDefs.routerBusyPollIdleMs),
+	 "Busy polling router endpoints go back to waiting after this many milliseconds without messages (default 100)")
+        ("router-busy-poll-all-sessions", bpo::bool_switch(&compDefs.routerBusyPollAllSessions),
+	 "Busy poll all sessions, rather than only those whose routing data requests it")
+        ("router-probe-interval", bpo::value<unsigned>(&compDefs.routerProbeInterval),
+	 "Seconds between measurements of the round trip time and bandwidth to connected nodes, 0 to disable (default 0)")
         ("no-consul", bpo::bool_switch(&opts.noConsul),"Disable use of Consul")
 ;
     // These are descriptions of the resources available on this node, that are sent to
@@ -150,6 +192,22 @@ void parseCmdLine(int argc, char* argv[],
         ("userName", bpo::value<std::string>(&opts.userName))
 	("nodeId", bpo::value<std::string>(&opts.nodeId))
 	("no-banlist", bpo::bool_switch(&opts.disableBanlist), "Disable 'banning' of IP addresses that send too many bad requests")
+	("shutdown-timeout", bpo::value<unsigned>(&opts.shutdownTimeoutSecs),
+	 "Time (in seconds) allowed for all sessions to stop when the node exits, after which computations are killed")
+	("event-threads", bpo::value<unsigned>(&opts.numEventThreads),
+	 "Number of threads sending events to Coordinator (events for a session are always sent in order)")
+	("event-batch-size", bpo::value<unsigned>(&opts.eventBatchSize),
+	 "Maximum number of events for a session sent to Coordinator in one request. 1 disables batching")
+	("http-max-connections-per-host", bpo::value<unsigned>(&opts.httpMaxConnectionsPerHost),
+	 "Maximum number of open connections to each service (Coordinator, Consul, etc). Further requests wait for a connection")
+	("http-connect-timeout", bpo::value<unsigned>(&opts.httpConnectTimeoutSecs),
+	 "Time (in seconds) allowed to connect to a service")
+	("http-timeout", bpo::value<unsigned>(&opts.httpTimeoutSecs),
+	 "Default time (in seconds) allowed for a request to a service, including waiting for a connection")
+	("http-max-idle", bpo::value<unsigned>(&opts.httpMaxIdleSecs),
+	 "Time (in seconds) after which an idle connection to a service is not reused")
+	("http-dns-cache-time", bpo::value<unsigned>(&opts.httpDnsCacheSecs),
+	 "Time (in seconds) for which service host name lookups are cached")
    ;
 
     bpo::options_description allOpts("Node Service options");
@@ -176,6 +234,9 @@ void parseCmdLine(int argc, char* argv[],
 	    opts.preemptionMonitorType = PreemptionMonitorType::Azure;
 	}
     }
+    if (cmdOpts.count("rez-cache-max-mb")) {
+	compDefs.rezCacheMaxBytes = cmdOpts["rez-cache-max-mb"].as<size_t>() * 1024 * 1024;
+    }
 #if not defined (DONT_USE_CRASH_REPORTER)
     compDefs.breakpadPath = arras4::crash::CrashReporter::getProgramParentPath();
 #endif
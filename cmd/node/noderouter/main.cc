@@ -57,6 +57,28 @@ parseCmdLine(int argc, char* argv[],
 	("athena-host", bpo::value<std::string>()->default_value("localhost"), 
 	 "Hostname of the Athena logging server (or localhost and let the local syslog daemon forward).")
 	("athena-port", bpo::value<int>()->default_value(514), "Athena logging UDP port.")
+        ("receiveMode", bpo::value<std::string>()->default_value("poll"),
+         "How endpoints wait for messages: 'poll' (poll before each read) or 'blocking' (block in read)")
+        ("captureDir", bpo::value<std::string>()->default_value(""),
+         "Record received traffic to a trace file per session in this directory, for use with arras4_router_replay")
+        ("capturePayloads", bpo::bool_switch()->default_value(false),
+         "Include message content in captured traffic (requires --captureDir)")
+        ("shards", bpo::value<unsigned>()->default_value(1),
+         "Number of shards the router's session tables are split into, to reduce lock contention with many sessions")
+        ("mapPayloadsOver", bpo::value<size_t>()->default_value(0),
+         "Hold received payloads larger than this many bytes in file mappings in the IPC socket directory (0 = never)")
+        ("traceSpans", bpo::value<std::string>()->default_value(""),
+         "Write per-hop timing spans for a sample of routed messages to this file")
+        ("traceSampleRate", bpo::value<double>()->default_value(0.001),
+         "Fraction of messages traced (requires --traceSpans)")
+        ("busyPollCpus", bpo::value<std::string>()->default_value(""),
+         "Reserve these cpus (e.g. '6,7' or '4-7') for busy polling the client and computation endpoints of latency-sensitive sessions")
+        ("busyPollIdleMs", bpo::value<unsigned>()->default_value(100),
+         "Busy polling endpoints return to normal waiting after this many milliseconds without messages")
+        ("busyPollAllSessions", bpo::bool_switch()->default_value(false),
+         "Busy poll all sessions, rather than only those that request it in their routing data (requires --busyPollCpus)")
+        ("probeInterval", bpo::value<unsigned>()->default_value(0),
+         "Seconds between round trip time and bandwidth probes of connected nodes (0 = never)")
         ;
 
     bpo::store(bpo::command_line_parser(argc, argv).
@@ -124,6 +146,15 @@ int main(int argc, char* argv[])
     unsigned short inetPort = cmdOpts["inetPort"].as<unsigned short>();
     const std::string ipcName = cmdOpts["ipcName"].as<std::string>();
 
+    arras4::node::ReceiveMode receiveMode = arras4::node::ReceiveMode::Poll;
+    const std::string receiveModeName = cmdOpts["receiveMode"].as<std::string>();
+    if (receiveModeName == "blocking") {
+        receiveMode = arras4::node::ReceiveMode::Blocking;
+    } else if (receiveModeName != "poll") {
+        std::cerr << "error: unknown receiveMode '" << receiveModeName << "'" << std::endl;
+        return 1;
+    }
+
     unlink(ipcName.c_str());
     arras4::network::IPCSocketPeer* ipcPeer = new arras4::network::IPCSocketPeer();
     ipcPeer->listen(ipcName);
@@ -140,8 +171,35 @@ int main(int argc, char* argv[])
 #pragma warning(disable: 1711)
 
     // this static assignment is safe because it is done during initialization
-    router = arras4::node::createNodeRouter(nodeId, inetSocket, ipcSocket);
+    router = arras4::node::createNodeRouter(nodeId, inetSocket, ipcSocket, receiveMode,
+                                            cmdOpts["captureDir"].as<std::string>(),
+                                            cmdOpts["capturePayloads"].as<bool>(),
+                                            cmdOpts["shards"].as<unsigned>());
     router->setInetPort(aListenPort);
+    size_t mapThreshold = cmdOpts["mapPayloadsOver"].as<size_t>();
+    if (mapThreshold) {
+        // mapped payloads go next to the IPC socket, which is on local storage
+        size_t slash = ipcName.rfind('/');
+        std::string mapDir = (slash == std::string::npos) ? "." : ipcName.substr(0, slash);
+        if (mapDir.empty()) mapDir = "/";
+        arras4::node::setRouterPayloadMapping(router, mapDir, mapThreshold);
+    }
+    if (!cmdOpts["traceSpans"].as<std::string>().empty()) {
+        arras4::node::setRouterHopTracing(router,
+                                          cmdOpts["traceSpans"].as<std::string>(),
+                                          cmdOpts["traceSampleRate"].as<double>());
+    }
+    const std::string busyPollCpus = cmdOpts["busyPollCpus"].as<std::string>();
+    if (!busyPollCpus.empty() &&
+        !arras4::node::setRouterBusyPolling(router, busyPollCpus,
+                                            cmdOpts["busyPollIdleMs"].as<unsigned>(),
+                                            cmdOpts["busyPollAllSessions"].as<bool>())) {
+        ARRAS_ERROR(arras4::log::Id("badBusyPollCpus") <<
+                    "Invalid busyPollCpus '" << busyPollCpus << "' : busy polling disabled");
+    }
+    if (cmdOpts["probeInterval"].as<unsigned>()) {
+        arras4::node::startRouterNodeProbing(router, cmdOpts["probeInterval"].as<unsigned>());
+    }
 
 // turn warnings for static assignments back on
 #pragma warning(pop)
@@ -0,0 +1,124 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "BusyPoll.h"
+
+#include <arras4_log/Logger.h>
+#include <arras4_log/LogEventStream.h>
+
+#include <sstream>
+#include <stdexcept>
+
+#include <pthread.h>
+#include <sys/socket.h>
+
+namespace {
+
+// time spent polling the device queue in each socket read
+constexpr int SOCKET_BUSY_POLL_USECS = 50;
+
+}
+
+namespace arras4 {
+namespace node {
+
+void
+BusyPoller::configure(const std::vector<int>& aCpus,
+                      std::chrono::milliseconds aIdlePeriod,
+                      bool aAllSessions)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCpus = aCpus;
+        mInUse.assign(aCpus.size(), false);
+    }
+    mIdlePeriod = aIdlePeriod;
+    mAllSessions = aAllSessions;
+    mEnabled.store(!aCpus.empty(), std::memory_order_release);
+    if (!aCpus.empty()) {
+        ARRAS_INFO("Busy polling on " << aCpus.size() << " reserved cpu(s), idle period " <<
+                   aIdlePeriod.count() << "ms" << (aAllSessions ? ", all sessions" : ""));
+    }
+}
+
+bool
+BusyPoller::Slot::acquire()
+{
+    if (mIndex >= 0) return true;
+    int cpu = -1;
+    {
+        std::lock_guard<std::mutex> lock(mPoller.mMutex);
+        for (size_t i = 0; i < mPoller.mInUse.size(); i++) {
+            if (!mPoller.mInUse[i]) {
+                mPoller.mInUse[i] = true;
+                mIndex = static_cast<int>(i);
+                cpu = mPoller.mCpus[i];
+                break;
+            }
+        }
+    }
+    if (mIndex < 0) return false;
+
+    mAffinitySaved = (pthread_getaffinity_np(pthread_self(), sizeof(mSavedAffinity), &mSavedAffinity) == 0);
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        // still spin, but without the dedicated cpu
+        ARRAS_DEBUG("Cannot move busy polling thread to cpu " << cpu);
+    }
+    return true;
+}
+
+void
+BusyPoller::Slot::release()
+{
+    if (mIndex < 0) return;
+    if (mAffinitySaved) {
+        pthread_setaffinity_np(pthread_self(), sizeof(mSavedAffinity), &mSavedAffinity);
+        mAffinitySaved = false;
+    }
+    std::lock_guard<std::mutex> lock(mPoller.mMutex);
+    mPoller.mInUse[mIndex] = false;
+    mIndex = -1;
+}
+
+void
+BusyPoller::setSocketBusyPoll(int aFd)
+{
+#ifdef SO_BUSY_POLL
+    int usecs = SOCKET_BUSY_POLL_USECS;
+    if (setsockopt(aFd, SOL_SOCKET, SO_BUSY_POLL, &usecs, sizeof(usecs)) != 0) {
+        // not supported for the socket type, or not permitted
+        ARRAS_DEBUG("SO_BUSY_POLL not set on socket " << aFd);
+    }
+#else
+    (void)aFd;
+#endif
+}
+
+std::vector<int>
+BusyPoller::parseCpuList(const std::string& aList)
+{
+    std::vector<int> cpus;
+    std::stringstream ss(aList);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty()) continue;
+        size_t dash = item.find('-');
+        try {
+            int first = std::stoi(item.substr(0, dash));
+            int last = (dash == std::string::npos) ? first : std::stoi(item.substr(dash + 1));
+            if (first < 0 || last < first || last >= CPU_SETSIZE)
+                throw std::invalid_argument(item);
+            for (int cpu = first; cpu <= last; cpu++)
+                cpus.push_back(cpu);
+        } catch (const std::logic_error&) {
+            throw std::invalid_argument("invalid cpu list '" + aList + "'");
+        }
+    }
+    return cpus;
+}
+
+}
+}
@@ -0,0 +1,83 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __ARRAS_BUSYPOLL_H__
+#define __ARRAS_BUSYPOLL_H__
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <sched.h>
+
+// Busy polling cuts the wakeup latency of the receive threads for the most
+// latency-sensitive sessions. When it is enabled (arras4_router --busyPollCpus)
+// a set of cpus is reserved for it. The receive thread of a client or
+// computation endpoint in an eligible session claims one of these cpus when
+// a message arrives, moves itself onto it and then polls its socket without
+// sleeping. After the idle period passes with no messages it gives the cpu
+// back and returns to normal waiting.
+//
+// Only one thread spins on each reserved cpu, so the cpu time used is bounded
+// by the number of reserved cpus : when they are all taken, other endpoints
+// wait normally. Sessions are eligible if their routing data sets
+// [sessionId]["busyPoll"] = true, or for all sessions with --busyPollAllSessions.
+// Where the kernel supports it, SO_BUSY_POLL is also set on the socket, so
+// that reads poll the network device queue directly.
+
+namespace arras4 {
+namespace node {
+
+class BusyPoller
+{
+public:
+    // aCpus is the list of reserved cpus : empty disables busy polling.
+    // Can be called once after the router has started
+    void configure(const std::vector<int>& aCpus,
+                   std::chrono::milliseconds aIdlePeriod,
+                   bool aAllSessions);
+    bool enabled() const { return mEnabled.load(std::memory_order_acquire); }
+    bool allSessions() const { return mAllSessions; }
+    std::chrono::milliseconds idlePeriod() const { return mIdlePeriod; }
+
+    // a reserved cpu claimed by a receive thread. Moves the thread to the
+    // cpu on acquire, and restores its affinity on release or destruction
+    class Slot
+    {
+    public:
+        Slot(BusyPoller& aPoller) : mPoller(aPoller) {}
+        ~Slot() { release(); }
+
+        // returns false if all the reserved cpus are in use
+        bool acquire();
+        void release();
+        bool held() const { return mIndex >= 0; }
+
+    private:
+        BusyPoller& mPoller;
+        int mIndex = -1;
+        cpu_set_t mSavedAffinity;
+        bool mAffinitySaved = false;
+    };
+
+    // enable SO_BUSY_POLL on a socket, if the platform supports it
+    static void setSocketBusyPoll(int aFd);
+
+    // parse a cpu list such as "4,5" or "4-7". Throws std::invalid_argument
+    static std::vector<int> parseCpuList(const std::string& aList);
+
+private:
+    std::mutex mMutex;
+    std::vector<int> mCpus;         // protected by mMutex
+    std::vector<bool> mInUse;       // protected by mMutex
+    std::chrono::milliseconds mIdlePeriod{0};
+    bool mAllSessions = false;
+    std::atomic<bool> mEnabled{false};
+};
+
+}
+}
+
+#endif // __ARRAS_BUSYPOLL_H__
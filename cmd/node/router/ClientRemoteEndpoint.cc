@@ -2,9 +2,11 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "ClientRemoteEndpoint.h"
+#include "RouteMessage.h"
 #include "RoutingTable.h"
 #include "ThreadedNodeRouter.h"
 
+#include <node/messages/ClientCongestionMessage.h>
 #include <routing/Addresser.h>
 #include <exceptions/InternalError.h>
 
@@ -12,6 +14,13 @@
 #include <cstring>
 #include <sys/time.h>
 
+namespace {
+
+// drain rate is measured over at least this interval
+const std::chrono::seconds DRAIN_RATE_WINDOW(1);
+
+}
+
 namespace arras4 {
 namespace node {
 
@@ -19,7 +28,8 @@ ClientRemoteEndpoint::ClientRemoteEndpoint(network::Peer* aPeer,
                                            const api::UUID& aSessionId,
                                            ThreadedNodeRouter& aThreadedNodeRouter,
                                            const std::string& traceInfo)
-    : RemoteEndpoint(aPeer, PeerManager::PEER_CLIENT, aSessionId, aSessionId, aThreadedNodeRouter,traceInfo)
+    : RemoteEndpoint(aPeer, PeerManager::PEER_CLIENT, aSessionId, aSessionId, aThreadedNodeRouter,traceInfo),
+      mRateWindowStart(std::chrono::steady_clock::now())
 {
 }
 
@@ -45,6 +55,73 @@ ClientRemoteEndpoint::addressReceivedEnvelope()
     }
 }
 
+void
+ClientRemoteEndpoint::queueChanged(size_t aMessages, size_t aBytes, bool aSent)
+{
+    if (!mRoutingData) return;
+    std::shared_ptr<const SessionRoutingData::ClientCongestionLimits> limits = mRoutingData->clientCongestion();
+    if (!limits) return;
+
+    bool notify = false;
+    bool congested;
+    float drainRate;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mCongestionMutex);
+        if (aSent) mRateWindowCount++;
+        std::chrono::duration<float> window = now - mRateWindowStart;
+        if (window >= DRAIN_RATE_WINDOW) {
+            mDrainRate = mRateWindowCount / window.count();
+            mRateWindowCount = 0;
+            mRateWindowStart = now;
+        }
+        drainRate = mDrainRate;
+
+        bool aboveHigh = (limits->mHighWatermark && aMessages >= limits->mHighWatermark) ||
+                         (limits->mHighWatermarkBytes && aBytes >= limits->mHighWatermarkBytes);
+        bool belowLow = (aMessages <= limits->mLowWatermark) &&
+                        (!limits->mHighWatermarkBytes || aBytes <= limits->mLowWatermarkBytes);
+        if (!mCongested && aboveHigh) {
+            // rate limited. If suppressed, the next queue change will try again
+            if (now - mLastCongestedNotice >= limits->mMinInterval) {
+                mCongested = true;
+                mLastCongestedNotice = now;
+                notify = true;
+            }
+        } else if (mCongested && belowLow) {
+            // always sent, so computations don't stay throttled
+            mCongested = false;
+            notify = true;
+        }
+        congested = mCongested;
+    }
+    if (notify) {
+        notifyCongestion(congested, aMessages, aBytes, drainRate);
+    }
+}
+
+void
+ClientRemoteEndpoint::notifyCongestion(bool aCongested, size_t aMessages, size_t aBytes, float aDrainRate)
+{
+    impl::Addresser* clientAddresser = mRoutingData->clientAddresser();
+    if (clientAddresser == nullptr) return;
+
+    ARRAS_DEBUG(log::Session(mSessionId.toString()) <<
+                "Client " << (aCongested ? "congested" : "no longer congested") << " : " <<
+                aMessages << " messages (" << aBytes << " bytes) queued, sending " <<
+                aDrainRate << " messages/sec");
+
+    ClientCongestion* message = new ClientCongestion();
+    message->mSessionId = mSessionId;
+    message->mCongested = aCongested;
+    message->mQueuedMessages = static_cast<unsigned>(aMessages);
+    message->mQueuedBytes = aBytes;
+    message->mDrainRate = aDrainRate;
+    impl::Envelope envelope(message);
+    clientAddresser->addressToAll(envelope);
+    routeMessage(envelope, mRoutingData, mThreadedNodeRouter);
+}
+
 } // namespace service
 } // namespace arras
 
@@ -6,6 +6,9 @@
 
 #include "RemoteEndpoint.h"
 
+#include <chrono>
+#include <mutex>
+
 namespace arras4 {
     namespace node {
 
@@ -23,6 +26,22 @@ public:
 protected:
     // take the opportunity to synthesize a "to" address list for messages originating from client
     void addressReceivedEnvelope();
+
+    // send ClientCongestion messages to the computations when the queue
+    // crosses the session's watermarks
+    void queueChanged(size_t aMessages, size_t aBytes, bool aSent);
+
+private:
+    void notifyCongestion(bool aCongested, size_t aMessages, size_t aBytes, float aDrainRate);
+
+    std::mutex mCongestionMutex;
+    bool mCongested = false;
+    std::chrono::steady_clock::time_point mLastCongestedNotice;
+
+    // recent rate of sending to the client
+    std::chrono::steady_clock::time_point mRateWindowStart;
+    unsigned mRateWindowCount = 0;
+    float mDrainRate = 0.0f;
 };
 
 } 
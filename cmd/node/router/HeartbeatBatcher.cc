@@ -0,0 +1,210 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "pthread_create_interposer.h"
+#include "HeartbeatBatcher.h"
+#include "ThreadedNodeRouter.h"
+
+#include <node/messages/HeartbeatBatchMessage.h>
+
+#include <arras4_log/Logger.h>
+#include <arras4_log/LogEventStream.h>
+#include <arras4_athena/AthenaLogger.h>
+
+#include <cmath>
+#include <cstdio>
+#include <time.h>
+
+namespace {
+
+// large enough for all the stats fields plus a reasonably long
+// status string. Longer status strings are truncated
+constexpr size_t STATS_BUFFER_SIZE = 2048;
+constexpr size_t MAX_STATUS_LENGTH = 1024;
+
+// append str to out, escaping characters that are not valid in a JSON string
+void appendJsonEscaped(std::string& out, const std::string& str)
+{
+    for (char c : str) {
+        if (out.size() >= MAX_STATUS_LENGTH) break;
+        switch (c) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) >= 0x20) out += c;
+        }
+    }
+}
+
+// size of a buffer holding one number formatted by jsonNumber
+constexpr size_t NUMBER_BUFFER_SIZE = 32;
+
+// format value as a JSON number, with enough precision to round trip
+// (as jsoncpp writes it). JSON has no NaN or infinity, so these are null
+const char* jsonNumber(char* buf, double value)
+{
+    if (!std::isfinite(value))
+        return "null";
+    snprintf(buf, NUMBER_BUFFER_SIZE, "%.17g", value);
+    return buf;
+}
+
+}
+
+using namespace arras4::api;
+
+namespace arras4 {
+namespace node {
+
+HeartbeatBatcher::HeartbeatBatcher(ThreadedNodeRouter& aThreadedNodeRouter,
+                                   std::chrono::milliseconds aInterval) :
+    mThreadedNodeRouter(aThreadedNodeRouter),
+    mInterval(aInterval),
+    mStatsBuffer(STATS_BUFFER_SIZE)
+{
+    mStatusBuffer.reserve(MAX_STATUS_LENGTH);
+}
+
+HeartbeatBatcher::~HeartbeatBatcher()
+{
+    stop();
+}
+
+void
+HeartbeatBatcher::start()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mRun) return;
+    mRun = true;
+    set_thread_stacksize(KB_256);
+    mThread = std::thread(&HeartbeatBatcher::threadProc, this);
+    set_thread_stacksize(0);
+}
+
+void
+HeartbeatBatcher::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRun = false;
+        mCondition.notify_all();
+    }
+    if (mThread.joinable()) mThread.join();
+}
+
+void
+HeartbeatBatcher::addHeartbeat(const impl::ExecutorHeartbeat::ConstPtr& aHeartbeat,
+                               const UUID& aSessionId,
+                               const UUID& aCompId,
+                               bool statsDue)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    Pending& pending = mPending[aCompId];
+    pending.mSessionId = aSessionId;
+    pending.mHeartbeat = aHeartbeat;
+    // stats remain due until the next flush, even if
+    // a later heartbeat replaces this one
+    pending.mStatsDue = pending.mStatsDue || statsDue;
+}
+
+void
+HeartbeatBatcher::threadProc()
+{
+    log::Logger::instance().setThreadName("heartbeat_batch");
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (mRun) {
+        mCondition.wait_for(lock, mInterval);
+        if (mPending.empty()) continue;
+
+        // take the pending heartbeats and release the lock while they are sent,
+        // so that receive threads are only blocked for the swap
+        mFlushing.swap(mPending);
+        lock.unlock();
+        flush();
+        mFlushing.clear();
+        lock.lock();
+    }
+}
+
+void
+HeartbeatBatcher::flush()
+{
+    HeartbeatBatchMessage* batch = new HeartbeatBatchMessage;
+    batch->mEntries.reserve(mFlushing.size());
+    for (const auto& item : mFlushing) {
+        batch->mEntries.emplace_back(item.second.mSessionId, item.first, item.second.mHeartbeat);
+        if (item.second.mStatsDue) {
+            logStats(item.first, item.second);
+        }
+    }
+    mThreadedNodeRouter.notifyService(batch);
+}
+
+void
+HeartbeatBatcher::logStats(const UUID& aCompId, const Pending& aPending)
+{
+    if (!mStatsLoggerChecked) {
+        mStatsLogger = dynamic_cast<log::AthenaLogger*>(&log::Logger::instance());
+        mStatsLoggerChecked = true;
+        if (!mStatsLogger) {
+            ARRAS_WARN(log::Id("warnNotAthena") <<
+                       "Default logger is not an AthenaLogger : cannot log stats");
+        }
+    }
+    if (!mStatsLogger) return;
+
+    const impl::ExecutorHeartbeat& hb = *aPending.mHeartbeat;
+
+    time_t t = (time_t)hb.mTransmitSecs;
+    struct tm date;
+    localtime_r(&t, &date);
+
+    mStatusBuffer.clear();
+    appendJsonEscaped(mStatusBuffer, hb.mStatus);
+
+    char cpu5[NUMBER_BUFFER_SIZE], cpu60[NUMBER_BUFFER_SIZE], cpuTotal[NUMBER_BUFFER_SIZE];
+
+    // formatted directly into a preallocated buffer : this runs for
+    // every computation on the node, so avoid building a json object
+    int len = snprintf(mStatsBuffer.data(), mStatsBuffer.size(),
+                       "{\"type\":\"ArrasComputationStats/0.0\","
+                       "\"session\":\"%s\",\"computation\":\"%s\","
+                       "\"time\":\"%04d-%02d-%02dT%02d:%02d:%02d\","
+                       "\"threads\":%u,\"hyperthreaded\":%s,"
+                       "\"CpuUsage5Sec\":%s,\"CpuUsage60Sec\":%s,\"CpuUsageTotal\":%s,"
+                       "\"SentMessages5Sec\":%llu,\"SentMessages60Sec\":%llu,\"SentMessagesTotal\":%llu,"
+                       "\"ReceivedMessages5Sec\":%llu,\"ReceivedMessages60Sec\":%llu,\"ReceivedMessagesTotal\":%llu,"
+                       "\"MemoryUsageBytes\":%llu,\"Status\":\"%s\"}",
+                       aPending.mSessionId.toString().c_str(), aCompId.toString().c_str(),
+                       date.tm_year+1900, date.tm_mon+1, date.tm_mday,
+                       date.tm_hour, date.tm_min, date.tm_sec,
+                       (unsigned)hb.mThreads, hb.mHyperthreaded ? "true" : "false",
+                       jsonNumber(cpu5, hb.mCpuUsage5SecsCurrent),
+                       jsonNumber(cpu60, hb.mCpuUsage60SecsCurrent),
+                       jsonNumber(cpuTotal, hb.mCpuUsageTotalSecs),
+                       (unsigned long long)hb.mSentMessages5Sec,
+                       (unsigned long long)hb.mSentMessages60Sec,
+                       (unsigned long long)hb.mSentMessagesTotal,
+                       (unsigned long long)hb.mReceivedMessages5Sec,
+                       (unsigned long long)hb.mReceivedMessages60Sec,
+                       (unsigned long long)hb.mReceivedMessagesTotal,
+                       (unsigned long long)hb.mMemoryUsageBytesCurrent,
+                       mStatusBuffer.c_str());
+    if (len < 0 || static_cast<size_t>(len) >= mStatsBuffer.size()) {
+        ARRAS_WARN(log::Id("warnStatsTruncated") <<
+                   log::Session(aPending.mSessionId.toString()) <<
+                   "Stats for computation " << aCompId.toString() << " too long to log");
+        return;
+    }
+    mStatsLogger->logStats(std::string(mStatsBuffer.data(), len));
+    ARRAS_DEBUG(log::Session(aPending.mSessionId.toString()) <<
+                "Sent stats to athena for computation " << aCompId.toString());
+}
+
+} 
+}
+
@@ -0,0 +1,88 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __ARRAS_HEARTBEATBATCHER_H__
+#define __ARRAS_HEARTBEATBATCHER_H__
+
+#include <core_messages/ExecutorHeartbeat.h>
+#include <message_api/messageapi_types.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// HeartbeatBatcher coalesces ExecutorHeartbeat messages received from
+// computations. Only the latest heartbeat from each computation is kept,
+// and once per interval a background thread forwards them to NodeService
+// as a single HeartbeatBatchMessage. The same thread sends any due stats
+// to the stats logger, so that the endpoint receive threads never do
+// formatting or logging work for heartbeats.
+
+namespace arras4 {
+    namespace log {
+        class AthenaLogger;
+    }
+}
+
+namespace arras4 {
+namespace node {
+
+class ThreadedNodeRouter;
+
+class HeartbeatBatcher
+{
+public:
+    HeartbeatBatcher(ThreadedNodeRouter& aThreadedNodeRouter,
+                     std::chrono::milliseconds aInterval);
+    ~HeartbeatBatcher();
+
+    void start();
+    void stop();
+
+    // record the latest heartbeat for a computation. if statsDue is true,
+    // the stats from this (or a later) heartbeat will be logged at the next flush.
+    // thread safe : called from the IPC endpoint receive threads
+    void addHeartbeat(const impl::ExecutorHeartbeat::ConstPtr& aHeartbeat,
+                      const api::UUID& aSessionId,
+                      const api::UUID& aCompId,
+                      bool statsDue);
+
+private:
+    struct Pending {
+        api::UUID mSessionId;
+        impl::ExecutorHeartbeat::ConstPtr mHeartbeat;
+        bool mStatsDue = false;
+    };
+    typedef std::map<api::UUID, Pending> PendingMap;
+
+    void threadProc();
+    void flush();
+    void logStats(const api::UUID& aCompId, const Pending& aPending);
+
+    ThreadedNodeRouter& mThreadedNodeRouter;
+    const std::chrono::milliseconds mInterval;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    PendingMap mPending;    // protected by mMutex
+    bool mRun = false;      // protected by mMutex
+
+    // only accessed by the batch thread
+    PendingMap mFlushing;
+    std::vector<char> mStatsBuffer;
+    std::string mStatusBuffer;
+    log::AthenaLogger* mStatsLogger = nullptr;
+    bool mStatsLoggerChecked = false;
+
+    std::thread mThread;
+};
+
+} 
+}
+
+#endif // __ARRAS_HEARTBEATBATCHER_H__
+
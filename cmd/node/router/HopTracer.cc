@@ -0,0 +1,140 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "HopTracer.h"
+
+#include <arras4_log/Logger.h>
+#include <arras4_log/LogEventStream.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+namespace {
+
+// sample rates are applied with this resolution
+constexpr unsigned long long SAMPLE_SCALE = 1000000;
+
+thread_local arras4::node::HopTracer::HopPtr tCurrentHop;
+
+// OpenTelemetry ids are lower case hex without dashes
+std::string traceIdHex(const arras4::api::UUID& aId)
+{
+    std::string hex = aId.toString();
+    hex.erase(std::remove(hex.begin(), hex.end(), '-'), hex.end());
+    return hex;
+}
+
+std::string spanIdHex()
+{
+    static thread_local std::mt19937_64 generator(std::random_device{}());
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(generator()));
+    return buf;
+}
+
+// names and descriptions are internal, but make sure they can't break the JSON
+std::string jsonEscape(const std::string& aString)
+{
+    std::string out;
+    for (char c : aString) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20) out += c;
+    }
+    return out;
+}
+
+}
+
+namespace arras4 {
+namespace node {
+
+bool
+HopTracer::configure(const std::string& aPath, double aSampleRate)
+{
+    // stop sampling before touching the file
+    mSampleThreshold = 0;
+    std::lock_guard<std::mutex> lock(mFileMutex);
+    if (mFile.is_open()) mFile.close();
+    if (aSampleRate <= 0 || aPath.empty())
+        return true;
+
+    mFile.open(aPath, std::ios::out | std::ios::app);
+    if (!mFile) {
+        ARRAS_ERROR(log::Id("hopTraceOpenFailed") <<
+                    "Cannot open hop trace file " << aPath);
+        return false;
+    }
+    unsigned long long threshold = static_cast<unsigned long long>(std::min(aSampleRate, 1.0) * SAMPLE_SCALE);
+    mSampleThreshold = threshold ? threshold : 1;
+    ARRAS_INFO("Tracing " << aSampleRate * 100 << "% of messages to " << aPath);
+    return true;
+}
+
+bool
+HopTracer::sampled(const impl::Envelope& anEnvelope) const
+{
+    unsigned long long threshold = mSampleThreshold.load(std::memory_order_relaxed);
+    if (threshold == 0 || !anEnvelope.metadata())
+        return false;
+    // instance ids are random, so some of their bits serve as the hash
+    const api::UUID& id = anEnvelope.metadata()->instanceId();
+    unsigned long long bits;
+    static_assert(sizeof(api::UUID) >= sizeof(bits), "UUID smaller than expected");
+    memcpy(&bits, &id, sizeof(bits));
+    return (bits % SAMPLE_SCALE) < threshold;
+}
+
+const HopTracer::HopPtr&
+HopTracer::current()
+{
+    return tCurrentHop;
+}
+
+void
+HopTracer::setCurrent(const HopPtr& aHop)
+{
+    tCurrentHop = aHop;
+}
+
+unsigned long long
+HopTracer::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void
+HopTracer::recordHop(const Hop& aHop, const std::string& aTo,
+                     unsigned long long aEnqueueNs, unsigned long long aSendNs)
+{
+    if (!enabled())
+        return;
+
+    std::string name = jsonEscape(aHop.mName);
+    char buf[1024];
+    snprintf(buf, sizeof(buf),
+             "{\"traceId\":\"%s\",\"spanId\":\"%s\",\"name\":\"route %s\",\"kind\":\"SPAN_KIND_INTERNAL\","
+             "\"startTimeUnixNano\":%llu,\"endTimeUnixNano\":%llu,"
+             "\"attributes\":{\"arras.node\":\"%s\",\"arras.session\":\"%s\",\"arras.message\":\"%s\","
+             "\"arras.from\":\"%s\",\"arras.to\":\"%s\"},"
+             "\"events\":[{\"name\":\"receive\",\"timeUnixNano\":%llu},"
+             "{\"name\":\"enqueue\",\"timeUnixNano\":%llu},"
+             "{\"name\":\"send\",\"timeUnixNano\":%llu}]}\n",
+             traceIdHex(aHop.mTraceId).c_str(), spanIdHex().c_str(), name.c_str(),
+             aHop.mReceiveNs, aSendNs,
+             mNodeId.toString().c_str(), aHop.mSessionId.toString().c_str(), name.c_str(),
+             jsonEscape(aHop.mFrom).c_str(), jsonEscape(aTo).c_str(),
+             aHop.mReceiveNs, aEnqueueNs, aSendNs);
+
+    std::lock_guard<std::mutex> lock(mFileMutex);
+    if (mFile.is_open()) {
+        mFile << buf;
+        mFile.flush();
+    }
+}
+
+}
+}
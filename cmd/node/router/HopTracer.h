@@ -0,0 +1,78 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __ARRAS_HOPTRACER_H__
+#define __ARRAS_HOPTRACER_H__
+
+#include <message_api/UUID.h>
+#include <message_impl/Envelope.h>
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// HopTracer records how long sampled messages spend in each router they
+// pass through. For every hop (receipt of a message on one endpoint and its
+// sending on another) a span is written with the receive, enqueue and send
+// times, one JSON object per line in OpenTelemetry span layout.
+//
+// Messages are chosen by hashing their instance id, so every router in a
+// multi-node session samples the same messages without any extra data
+// travelling with them. The trace id of a span is the message instance id,
+// so the spans from each node can be joined to show where the time went:
+// the gaps between one router's send and the next router's receive are the
+// links (client, node-to-node or IPC). Times are wall clock, so comparing
+// spans across nodes depends on their clocks being synchronized.
+
+namespace arras4 {
+namespace node {
+
+class HopTracer
+{
+public:
+    // where a sampled message came from : shared by the queue entries of all
+    // its destinations
+    struct Hop {
+        api::UUID mTraceId;
+        api::UUID mSessionId;
+        std::string mName;     // message routing name
+        std::string mFrom;     // describes the receiving endpoint
+        unsigned long long mReceiveNs = 0;
+    };
+    typedef std::shared_ptr<const Hop> HopPtr;
+
+    HopTracer(const api::UUID& aNodeId) : mNodeId(aNodeId) {}
+
+    // start writing spans to aPath, sampling a fraction aSampleRate (0-1) of
+    // messages. A rate of 0 disables tracing. Can be called at any time.
+    // returns false if the file can't be opened
+    bool configure(const std::string& aPath, double aSampleRate);
+
+    bool enabled() const { return mSampleThreshold.load(std::memory_order_relaxed) != 0; }
+    bool sampled(const impl::Envelope& anEnvelope) const;
+
+    // the hop being routed by the calling thread, or null. Set by an endpoint's
+    // receive thread for the duration of routing a sampled message, so that
+    // queueEnvelope on the destination endpoints can pick it up
+    static const HopPtr& current();
+    static void setCurrent(const HopPtr& aHop);
+
+    // write the span for a hop, once it has been sent to aTo
+    void recordHop(const Hop& aHop, const std::string& aTo,
+                   unsigned long long aEnqueueNs, unsigned long long aSendNs);
+
+    static unsigned long long now();
+
+private:
+    const api::UUID mNodeId;
+    std::atomic<unsigned long long> mSampleThreshold{0}; // out of SAMPLE_SCALE
+    std::mutex mFileMutex;
+    std::ofstream mFile;
+};
+
+}
+}
+
+#endif // __ARRAS_HOPTRACER_H__
@@ -0,0 +1,120 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "MappedPayload.h"
+
+#include <arras4_log/Logger.h>
+#include <arras4_log/LogEventStream.h>
+#include <message_api/DataOutStream.h>
+#include <message_impl/OpaqueContent.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+std::string errnoString()
+{
+    return std::string(strerror(errno));
+}
+
+}
+
+namespace arras4 {
+namespace node {
+
+MappedContent::MappedContent(const std::string& aDirectory,
+                             const api::ClassID& aClassId,
+                             unsigned aClassVersion,
+                             const std::string& aRoutingName,
+                             const void* aData, size_t aSize) :
+    mClassId(aClassId),
+    mClassVersion(aClassVersion),
+    mRoutingName(aRoutingName),
+    mSize(aSize)
+{
+    // the file is unlinked straight away : the mapping keeps it alive, and it
+    // disappears when the mapping does, even if the router crashes
+    std::string path = aDirectory + "/arras-payload-XXXXXX";
+    int fd = mkostemp(&path[0], O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot create payload file in " + aDirectory + ": " + errnoString());
+    }
+    unlink(path.c_str());
+
+    // write through the page cache, then map read only. Copying into a fresh
+    // writable mapping would take a page fault (and a zero fill) for every
+    // page, and would raise SIGBUS rather than an error if the disk is full
+    const char* src = static_cast<const char*>(aData);
+    size_t written = 0;
+    while (written < aSize) {
+        ssize_t n = pwrite(fd, src + written, aSize - written, written);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            std::string err = errnoString();
+            close(fd);
+            throw std::runtime_error("Cannot write payload file: " + err);
+        }
+        written += n;
+    }
+    void* base = mmap(nullptr, aSize, PROT_READ, MAP_SHARED, fd, 0);
+    std::string err = errnoString();
+    close(fd);
+    if (base == MAP_FAILED) {
+        throw std::runtime_error("Cannot map payload file: " + err);
+    }
+    mData = base;
+}
+
+MappedContent::~MappedContent()
+{
+    if (mData) {
+        munmap(mData, mSize);
+    }
+}
+
+void
+MappedContent::serialize(api::DataOutStream& to) const
+{
+    to.write(mData, mSize);
+}
+
+void
+MappedContent::deserialize(api::DataInStream&, unsigned)
+{
+    throw std::logic_error("MappedContent cannot be deserialized");
+}
+
+void
+PayloadMapper::mapIfLarge(impl::Envelope& anEnvelope)
+{
+    size_t threshold = mThreshold.load(std::memory_order_acquire);
+    if (threshold == 0)
+        return;
+    std::shared_ptr<const impl::OpaqueContent> opaque = anEnvelope.contentAs<impl::OpaqueContent>();
+    if (!opaque || opaque->dataSize() <= threshold)
+        return;
+
+    try {
+        api::MessageContentConstPtr mapped = std::make_shared<MappedContent>(
+            mDirectory, opaque->classId(), opaque->classVersion(),
+            opaque->defaultRoutingName(), opaque->data(), opaque->dataSize());
+        // releasing the envelope's reference frees the heap copy, unless
+        // something else (e.g. traffic capture) is still holding it
+        anEnvelope = impl::Envelope(mapped, anEnvelope.metadata(), anEnvelope.to());
+        mMappedCount++;
+    } catch (const std::exception& e) {
+        ARRAS_WARN(log::Id("payloadMapFailed") <<
+                   "Large message kept in memory : " << e.what());
+    }
+}
+
+}
+}
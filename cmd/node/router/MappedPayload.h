@@ -0,0 +1,87 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __ARRAS_MAPPEDPAYLOAD_H__
+#define __ARRAS_MAPPEDPAYLOAD_H__
+
+#include <message_api/ContentMacros.h>
+#include <message_impl/Envelope.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+// Very large messages (deep images, checkpoints) can be held by the router
+// for as long as any destination queue references them. When enabled
+// (arras4_router --mapPayloadsOver), payloads above the threshold are moved
+// out of the heap into a shared mapping of an unlinked temporary file.
+// The kernel can write these pages back to the file and reclaim them under
+// memory pressure, instead of swapping out the memory of other sessions.
+// The payload is still received into the heap, since the core message
+// endpoint owns the framing and allocates the content buffer : it is
+// written to the file as soon as the message has been read, and the heap
+// copy is freed when the envelope's content is replaced.
+
+namespace arras4 {
+namespace node {
+
+// serialized content held in a file mapping. It stands in for the
+// impl::OpaqueContent it was made from, and serializes to the same bytes
+class MappedContent : public api::MessageContent
+{
+public:
+    // throws std::runtime_error if the file can't be created or mapped
+    MappedContent(const std::string& aDirectory,
+                  const api::ClassID& aClassId,
+                  unsigned aClassVersion,
+                  const std::string& aRoutingName,
+                  const void* aData, size_t aSize);
+    ~MappedContent();
+
+    const api::ClassID& classId() const { return mClassId; }
+    unsigned classVersion() const { return mClassVersion; }
+    const std::string& defaultRoutingName() const { return mRoutingName; }
+
+    void serialize(api::DataOutStream& to) const;
+    // mapped content is only ever forwarded
+    void deserialize(api::DataInStream& from, unsigned version);
+
+    size_t dataSize() const { return mSize; }
+
+private:
+    const api::ClassID mClassId;
+    const unsigned mClassVersion;
+    const std::string mRoutingName;
+    void* mData = nullptr;
+    size_t mSize = 0;
+};
+
+class PayloadMapper
+{
+public:
+    // a zero threshold disables mapping. Can be called once after the
+    // router has started : the directory is set before the threshold
+    // makes it visible to the receive threads
+    void configure(const std::string& aDirectory, size_t aThreshold) {
+        mDirectory = aDirectory;
+        mThreshold.store(aThreshold, std::memory_order_release);
+    }
+    bool enabled() const { return mThreshold.load(std::memory_order_acquire) != 0; }
+
+    // if anEnvelope holds serialized content larger than the threshold,
+    // replace it with a MappedContent. On failure the envelope is left
+    // unchanged
+    void mapIfLarge(impl::Envelope& anEnvelope);
+
+    unsigned long long mappedCount() const { return mMappedCount; }
+
+private:
+    std::string mDirectory;
+    std::atomic<size_t> mThreshold{0};
+    std::atomic<unsigned long long> mMappedCount{0};
+};
+
+}
+}
+
+#endif // __ARRAS_MAPPEDPAYLOAD_H__
@@ -0,0 +1,240 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "pthread_create_interposer.h"
+#include "NodeProber.h"
+#include "RemoteEndpoint.h"
+#include "ThreadedNodeRouter.h"
+
+#include <node/messages/NodeNetworkMessage.h>
+
+#include <arras4_log/Logger.h>
+#include <arras4_log/LogEventStream.h>
+
+#include <algorithm>
+
+namespace {
+
+// padding sent with bandwidth probes
+constexpr unsigned BANDWIDTH_PROBE_BYTES = 1024 * 1024;
+
+// a bandwidth probe is sent every this many rounds
+constexpr unsigned long long BANDWIDTH_PROBE_ROUNDS = 6;
+
+// weight given to each new sample in the moving averages
+constexpr double SAMPLE_WEIGHT = 0.2;
+
+// probes without a reply after this many intervals are counted as lost
+constexpr unsigned PROBE_TIMEOUT_INTERVALS = 3;
+
+double ewma(double aAverage, double aSample, bool aFirst)
+{
+    return aFirst ? aSample : aAverage + SAMPLE_WEIGHT * (aSample - aAverage);
+}
+
+// probes are addressed to the node itself, with no session or computation
+arras4::api::AddressList nodeAddress(const arras4::api::UUID& aNodeId)
+{
+    arras4::api::Address addr;
+    addr.node = aNodeId;
+    return arras4::api::AddressList{addr};
+}
+
+}
+
+using namespace arras4::api;
+
+namespace arras4 {
+namespace node {
+
+NodeProber::NodeProber(ThreadedNodeRouter& aThreadedNodeRouter) :
+    mThreadedNodeRouter(aThreadedNodeRouter)
+{
+}
+
+NodeProber::~NodeProber()
+{
+    stop();
+}
+
+void
+NodeProber::start(std::chrono::milliseconds aInterval)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mRun || aInterval.count() <= 0) return;
+    mInterval = aInterval;
+    mRun = true;
+    set_thread_stacksize(KB_256);
+    mThread = std::thread(&NodeProber::threadProc, this);
+    set_thread_stacksize(0);
+}
+
+void
+NodeProber::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRun = false;
+        mCondition.notify_all();
+    }
+    if (mThread.joinable()) mThread.join();
+}
+
+void
+NodeProber::threadProc()
+{
+    log::Logger::instance().setThreadName("node_prober");
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (mRun) {
+        mCondition.wait_for(lock, mInterval);
+        if (!mRun) break;
+        lock.unlock();
+        probeRound();
+        sendReport();
+        lock.lock();
+    }
+}
+
+void
+NodeProber::probeRound()
+{
+    std::map<UUID, std::shared_ptr<RemoteEndpoint> > nodes = mThreadedNodeRouter.getNodePeers();
+    bool bandwidthRound = (++mRound % BANDWIDTH_PROBE_ROUNDS) == 0;
+    std::vector<UUID> bandwidthNodes;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        // forget nodes that have disconnected
+        for (auto it = mLinks.begin(); it != mLinks.end();) {
+            if (nodes.count(it->first)) ++it;
+            else it = mLinks.erase(it);
+        }
+
+        // count probes that haven't been answered in time as lost
+        Clock::time_point cutoff = Clock::now() - mInterval * PROBE_TIMEOUT_INTERVALS;
+        for (auto it = mOutstanding.begin(); it != mOutstanding.end();) {
+            if (it->second.mSent < cutoff) {
+                auto link = mLinks.find(it->second.mNodeId);
+                if (link != mLinks.end()) link->second.mLost++;
+                it = mOutstanding.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        // the bandwidth estimate needs a round trip time to subtract
+        if (bandwidthRound) {
+            for (const auto& link : mLinks) {
+                if (link.second.mSamples) bandwidthNodes.push_back(link.first);
+            }
+        }
+    }
+
+    for (const auto& node : nodes) {
+        sendProbe(*node.second, node.first, 0);
+        if (std::find(bandwidthNodes.begin(), bandwidthNodes.end(), node.first) != bandwidthNodes.end()) {
+            sendProbe(*node.second, node.first, BANDWIDTH_PROBE_BYTES);
+        }
+    }
+}
+
+void
+NodeProber::sendProbe(RemoteEndpoint& aTo, const UUID& aNodeId, unsigned aSize)
+{
+    NodeProbeMessage* probe = new NodeProbeMessage;
+    probe->mPadding.assign(aSize, '\0');
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        probe->mProbeId = mNextProbeId++;
+        Outstanding& outstanding = mOutstanding[probe->mProbeId];
+        outstanding.mNodeId = aNodeId;
+        outstanding.mSize = aSize;
+        // measured from the time of queueing, so that the figures include
+        // any wait behind session traffic
+        outstanding.mSent = Clock::now();
+    }
+    impl::Envelope env(probe);
+    aTo.queueEnvelope(env, nodeAddress(aNodeId));
+}
+
+void
+NodeProber::handleProbe(RemoteEndpoint& aFrom, const UUID& aNodeId,
+                        const NodeProbeMessage& aProbe)
+{
+    if (!aProbe.mReply) {
+        NodeProbeMessage* reply = new NodeProbeMessage;
+        reply->mProbeId = aProbe.mProbeId;
+        reply->mReply = true;
+        reply->mRequestSize = static_cast<unsigned>(aProbe.mPadding.size());
+        impl::Envelope env(reply);
+        aFrom.queueEnvelope(env, nodeAddress(aNodeId));
+        return;
+    }
+
+    Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mOutstanding.find(aProbe.mProbeId);
+    if (it == mOutstanding.end() || it->second.mNodeId != aNodeId) {
+        // late reply to a probe that was counted as lost
+        return;
+    }
+    double rttMs = std::chrono::duration<double, std::milli>(now - it->second.mSent).count();
+    unsigned size = it->second.mSize;
+    mOutstanding.erase(it);
+
+    Link& link = mLinks[aNodeId];
+    if (size == 0) {
+        bool first = (link.mSamples == 0);
+        link.mRttMs = ewma(link.mRttMs, rttMs, first);
+        link.mMinRttMs = first ? rttMs : std::min(link.mMinRttMs, rttMs);
+        link.mLastRttMs = rttMs;
+        link.mSamples++;
+    } else {
+        // the extra time over a small probe is spent transferring the padding
+        double transferMs = rttMs - link.mRttMs;
+        if (transferMs > 0) {
+            double mbps = (size * 8.0) / (transferMs * 1000.0);
+            link.mBandwidthMbps = ewma(link.mBandwidthMbps, mbps, link.mBandwidthMbps == 0);
+        }
+    }
+    link.mUpdated = now;
+}
+
+Object
+NodeProber::report() const
+{
+    Object report(Json::objectValue);
+    Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (const auto& item : mLinks) {
+        const Link& link = item.second;
+        if (link.mSamples == 0) continue;
+        Object& entry = report[item.first.toString()];
+        entry["rttMs"] = link.mRttMs;
+        entry["minRttMs"] = link.mMinRttMs;
+        entry["lastRttMs"] = link.mLastRttMs;
+        if (link.mBandwidthMbps > 0)
+            entry["bandwidthMbps"] = link.mBandwidthMbps;
+        entry["samples"] = static_cast<Object::UInt64>(link.mSamples);
+        entry["lost"] = static_cast<Object::UInt64>(link.mLost);
+        entry["ageSecs"] = std::chrono::duration<double>(now - link.mUpdated).count();
+    }
+    return report;
+}
+
+void
+NodeProber::sendReport()
+{
+    Object links = report();
+    // an empty report is sent once, when the last link goes away
+    if (links.empty() && !mReported) return;
+    mReported = !links.empty();
+
+    NodeNetworkMessage* network = new NodeNetworkMessage;
+    network->mReport = objectToString(links);
+    mThreadedNodeRouter.notifyService(network);
+}
+
+}
+}
@@ -0,0 +1,102 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __ARRAS_NODEPROBER_H__
+#define __ARRAS_NODEPROBER_H__
+
+#include <node/messages/NodeProbeMessage.h>
+
+#include <message_api/Object.h>
+#include <message_api/UUID.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+// NodeProber measures the links to the other nodes this router is connected
+// to, so that placement can take network quality into account. Once per
+// interval a background thread sends a small NodeProbeMessage over each node
+// connection, and the remote router echoes it back : the time until the reply
+// arrives gives the round trip time. Every few rounds a bandwidth probe with
+// a large padding is sent as well. Its reply takes longer than a small
+// probe's by roughly the time needed to transfer the padding, which gives an
+// estimate of the achievable bandwidth.
+//
+// Probes travel in the same send queues as session traffic, so the figures
+// include any queueing delay on a busy link. Only existing node connections
+// are probed : nodes connect to each other when they first share a session.
+// The latest figures are sent to NodeService as a NodeNetworkMessage after
+// every round.
+
+namespace arras4 {
+namespace node {
+
+class RemoteEndpoint;
+class ThreadedNodeRouter;
+
+class NodeProber
+{
+public:
+    NodeProber(ThreadedNodeRouter& aThreadedNodeRouter);
+    ~NodeProber();
+
+    // a zero interval leaves probing off. Incoming probes are answered
+    // whether or not this router is probing
+    void start(std::chrono::milliseconds aInterval);
+    void stop();
+
+    // handle a probe received from node aNodeId on endpoint aFrom : requests
+    // are answered, replies are measured.
+    // thread safe : called from the node endpoint receive threads
+    void handleProbe(RemoteEndpoint& aFrom, const api::UUID& aNodeId,
+                     const NodeProbeMessage& aProbe);
+
+    // latest measurements as a JSON-compatible object, keyed by node id
+    api::Object report() const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Link {
+        double mRttMs = 0;          // moving average
+        double mMinRttMs = 0;
+        double mLastRttMs = 0;
+        double mBandwidthMbps = 0;  // moving average, 0 until measured
+        unsigned long long mSamples = 0;
+        unsigned long long mLost = 0;
+        Clock::time_point mUpdated;
+    };
+    struct Outstanding {
+        api::UUID mNodeId;
+        Clock::time_point mSent;
+        unsigned mSize = 0;
+    };
+
+    void threadProc();
+    void probeRound();
+    void sendProbe(RemoteEndpoint& aTo, const api::UUID& aNodeId, unsigned aSize);
+    void sendReport();
+
+    ThreadedNodeRouter& mThreadedNodeRouter;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::chrono::milliseconds mInterval{0};
+    bool mRun = false;                          // protected by mMutex
+    std::map<api::UUID, Link> mLinks;           // protected by mMutex
+    std::map<unsigned, Outstanding> mOutstanding; // protected by mMutex
+    unsigned mNextProbeId = 0;                  // protected by mMutex
+
+    // only accessed by the probe thread
+    unsigned long long mRound = 0;
+    bool mReported = false;
+
+    std::thread mThread;
+};
+
+}
+}
+
+#endif // __ARRAS_NODEPROBER_H__
@@ -58,6 +58,9 @@ constexpr int NEGOTIATION_TIMEOUT = 5000; // time in milliseconds that a connect
 // time in milliseconds wait for SessionStatusMessage to be sent before giving up
 constexpr int SESSIONSTATUSMESSAGE_DRAIN_TIMEOUT = 5000;
 
+// time in milliseconds to wait for all the listeners to take the SessionStatusMessage
+constexpr int LISTENER_DRAIN_TIMEOUT = 500;
+
 // time in microseconds to wait on the service to router queue before checking for an exit request
 constexpr unsigned long SERVICETOROUTER_QUEUE_TIMEOUT_USEC= 500000; // timeout every 1/2 of a second
 
@@ -103,6 +106,7 @@ NodeRouter::start()
     // start the routing thread
     mThread = std::thread(&NodeRouter::threadProc, this);
     mServiceToRouterThread = std::thread(&NodeRouter::serviceToRouterProc, this);
+    mThreadedNodeRouter.startHeartbeatBatching();
 }
 
 struct PeerConnectFilterContext : public ListenServer::ConnectFilterContext
@@ -204,6 +208,7 @@ NodeRouter::serviceToRouterProc()
 			Object object;
 			api::stringToObject(routingDataMessage->mRoutingData, object);
 			putSessionRoutingData(sessionId, object);
+			mThreadedNodeRouter.capture().startSession(sessionId, routingDataMessage->mRoutingData);
                         // send one back as an acknowledgement
 			SessionRoutingDataMessage* message = new SessionRoutingDataMessage(SessionRoutingAction::Acknowledge,
                                                                                            sessionId);
@@ -217,10 +222,14 @@ NodeRouter::serviceToRouterProc()
                         SessionRoutingData::Ptr routingData = mThreadedNodeRouter.sessionRoutingData(sessionId);
                         if (routingData) {
                             routingData->updateClientAddresser(object);
+                            routingData->updateMemoryLimit(object);
+                            routingData->updateClientConflation(object);
+                            routingData->updateClientCongestion(object);
                         }
                     }
 		    else if (routingDataMessage->mAction == SessionRoutingAction::Delete) {
                         // the router should no longer need the route for this session
+			mThreadedNodeRouter.notifySessionTraffic(sessionId, true);
 			mThreadedNodeRouter.deleteSessionRoutingData(sessionId);
                     }
                 }
@@ -262,6 +271,33 @@ NodeRouter::threadProc()
         }
         if (ctx->mFailed) return ep;
 
+        if (ctx->mRegData.mType == REGISTRATION_CLIENT &&
+            ctx->mRegData.mComputationId.valid()) {
+            // a client registration that carries its own id (in mComputationId)
+            // is a read-only listener. A session can have any number of these
+            const UUID& sessionId = ctx->mRegData.mSessionId;
+            const UUID& listenerId = ctx->mRegData.mComputationId;
+            const SessionRoutingData::Ptr routingData = getSessionRoutingData(sessionId);
+            if (!routingData || !routingData->isEntryNode()) {
+                ARRAS_ERROR(log::Id("badListenerConnection") << log::Session(sessionId.toString()) <<
+                            "refusing listener connection : session is not hosted by this entry node");
+                throw std::runtime_error("refusing listener connection for sessionId:" + sessionId.toString());
+            }
+            std::string traceInfo("N:"+ getNodeId().toString() + " listener");
+            RemoteEndpoint* lep = new RemoteEndpoint(aPeer, PeerManager::PEER_LISTENER, listenerId,
+                                                     sessionId, mThreadedNodeRouter, traceInfo);
+            lep->setQueueLimit(routingData->listenerMaxQueued(),
+                               routingData->listenerMaxQueuedBytes(),
+                               routingData->listenerDisconnectWhenFull() ?
+                               RemoteEndpoint::QueueFullPolicy::Disconnect :
+                               RemoteEndpoint::QueueFullPolicy::Drop);
+            mThreadedNodeRouter.trackListener(sessionId, lep);
+            ARRAS_DEBUG(log::Session(sessionId.toString()) <<
+                        "New connection is listener " << listenerId.toString());
+            // the endpoint has taken ownership of the peer
+            return lep;
+        }
+
         if (ctx->mRegData.mType == REGISTRATION_CLIENT) {
             // refuse the client connection if session already has a client
             RemoteEndpoint::Ptr existingEndpoint = mThreadedNodeRouter.findClientPeer(ctx->mRegData.mSessionId);
@@ -425,7 +461,7 @@ NodeRouter::threadProc()
             std::string traceInfo("N:"+getNodeId().toString() + " C:"+ctx->mRegData.mComputationId.toString());
             ep = new RemoteEndpoint(aPeer, PeerManager::PEER_IPC, ctx->mRegData.mComputationId, 
                                     ctx->mRegData.mSessionId, mThreadedNodeRouter,traceInfo);
-            mThreadedNodeRouter.trackIpc(ctx->mRegData.mComputationId, ep);
+            mThreadedNodeRouter.trackIpc(ctx->mRegData.mSessionId, ctx->mRegData.mComputationId, ep);
 
         }
 
@@ -518,6 +554,8 @@ NodeRouter::stop()
 
     if (mThread.joinable()) mThread.join();
     if (mServiceToRouterThread.joinable()) mServiceToRouterThread.join();
+    mThreadedNodeRouter.stopHeartbeatBatching();
+    mThreadedNodeRouter.nodeProber().stop();
 }
 
 void
@@ -553,6 +591,21 @@ NodeRouter::kickClient(const UUID& aSessId, const std::string& aReason, const st
         // clear any pending messages for this client
         mThreadedNodeRouter.clearStashedEnvelopes(aSessId);
     }
+
+    // listeners get the final status too, but aren't waited for as long.
+    // Their send threads drain them in parallel, against one deadline
+    RemoteEndpointList listeners = mThreadedNodeRouter.getListeners(aSessId);
+    for (const RemoteEndpoint::Ptr& listener : listeners) {
+        sendSessionStatusToClient(statusJson, *listener);
+    }
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() +
+        std::chrono::milliseconds(LISTENER_DRAIN_TIMEOUT);
+    for (const RemoteEndpoint::Ptr& listener : listeners) {
+        std::chrono::steady_clock::duration left = deadline - std::chrono::steady_clock::now();
+        listener->drain(std::max(std::chrono::milliseconds(0),
+                                 std::chrono::duration_cast<std::chrono::milliseconds>(left)));
+        listener->flagForDestruction();
+    }
 }
 
 } // namespace service
@@ -6,6 +6,7 @@
 #include "NodeRouterManage.h"
 
 #include <cstring>
+#include <stdexcept>
 #include <unistd.h>
 
 namespace arras4 {
@@ -16,9 +17,16 @@ namespace node {
 // these functions allow managing of the NodeRouter without having it's implementation
 //
 NodeRouter*
-createNodeRouter(const api::UUID& aNodeId, unsigned short aInetSocket, unsigned short aIpcSocket)
+createNodeRouter(const api::UUID& aNodeId, unsigned short aInetSocket, unsigned short aIpcSocket,
+                 ReceiveMode aReceiveMode,
+                 const std::string& aCaptureDir,
+                 bool aCapturePayloads,
+                 unsigned aShardCount)
 {
     NodeRouter* router = new NodeRouter(aNodeId, aInetSocket, aIpcSocket);
+    router->mThreadedNodeRouter.setShardCount(aShardCount);
+    router->mThreadedNodeRouter.setReceiveMode(aReceiveMode);
+    router->mThreadedNodeRouter.capture().setDirectory(aCaptureDir, aCapturePayloads);
     router->start();
     return router;
 }
@@ -62,6 +70,39 @@ destroyNodeRouter(NodeRouter* nodeRouter)
     delete nodeRouter;
 }
 
+void
+setRouterPayloadMapping(NodeRouter* nodeRouter, const std::string& aDirectory, size_t aThreshold)
+{
+    nodeRouter->mThreadedNodeRouter.payloadMapper().configure(aDirectory, aThreshold);
+}
+
+bool
+setRouterHopTracing(NodeRouter* nodeRouter, const std::string& aPath, double aSampleRate)
+{
+    return nodeRouter->mThreadedNodeRouter.hopTracer().configure(aPath, aSampleRate);
+}
+
+bool
+setRouterBusyPolling(NodeRouter* nodeRouter, const std::string& aCpuList,
+                     unsigned aIdleMs, bool aAllSessions)
+{
+    std::vector<int> cpus;
+    try {
+        cpus = BusyPoller::parseCpuList(aCpuList);
+    } catch (const std::invalid_argument&) {
+        return false;
+    }
+    nodeRouter->mThreadedNodeRouter.busyPoller().configure(cpus, std::chrono::milliseconds(aIdleMs),
+                                                           aAllSessions);
+    return true;
+}
+
+void
+startRouterNodeProbing(NodeRouter* nodeRouter, unsigned aIntervalSecs)
+{
+    nodeRouter->mThreadedNodeRouter.nodeProber().start(std::chrono::seconds(aIntervalSecs));
+}
+
 void
 requestRouterShutdown(NodeRouter* nodeRouter)
 {
@@ -4,6 +4,8 @@
 #ifndef __ARRAS_NODEROUTERMANAGE_H__
 #define __ARRAS_NODEROUTERMANAGE_H__
 
+#include "NodeRouterOptions.h"
+
 #include <message_api/UUID.h>
 #include <string>
 
@@ -11,9 +13,28 @@ namespace arras4 {
 namespace node {
 
 class NodeRouter;
-NodeRouter* createNodeRouter(const api::UUID& aNodeId, unsigned short aNetSocket, unsigned short aIpcSocket);
+// a non-empty aCaptureDir enables traffic capture to that directory (see RouterTrace.h)
+// aShardCount > 1 splits the router's session tables into that many shards (see PeerManager.h)
+NodeRouter* createNodeRouter(const api::UUID& aNodeId, unsigned short aNetSocket, unsigned short aIpcSocket,
+                             ReceiveMode aReceiveMode = ReceiveMode::Poll,
+                             const std::string& aCaptureDir = std::string(),
+                             bool aCapturePayloads = false,
+                             unsigned aShardCount = 1);
 pid_t forkNodeRouter(const api::UUID& aNodeId, unsigned short aNetSocket, unsigned short aIpcSocket);
 void destroyNodeRouter(NodeRouter* nodeRouter);
+// move received payloads larger than aThreshold bytes into file mappings
+// in aDirectory (see MappedPayload.h). A threshold of 0 turns this off
+void setRouterPayloadMapping(NodeRouter* nodeRouter, const std::string& aDirectory, size_t aThreshold);
+// write per-hop timing spans for a fraction aSampleRate of routed messages
+// to aPath (see HopTracer.h). A rate of 0 turns tracing off
+bool setRouterHopTracing(NodeRouter* nodeRouter, const std::string& aPath, double aSampleRate);
+// busy poll the endpoints of eligible sessions on the reserved cpus in aCpuList
+// (e.g. "6,7" or "4-7"), backing off after aIdleMs without messages (see BusyPoll.h).
+// returns false if aCpuList is invalid
+bool setRouterBusyPolling(NodeRouter* nodeRouter, const std::string& aCpuList,
+                          unsigned aIdleMs, bool aAllSessions);
+// probe the links to connected nodes every aIntervalSecs seconds (see NodeProber.h)
+void startRouterNodeProbing(NodeRouter* nodeRouter, unsigned aIntervalSecs);
 void requestRouterShutdown(NodeRouter* nodeRouter);
 void waitForServiceDisconnected(NodeRouter* nodeRouter);
 
@@ -11,6 +11,12 @@ namespace arras4 {
 namespace node {
 
 
+// how the endpoint receive threads wait for incoming messages
+enum class ReceiveMode {
+    Poll,      // poll() with a timeout before reading each message
+    Blocking   // block in the read itself : one less system call per message
+};
+
 struct NodeRouterOptions {
     unsigned short mNetPort;
     std::string mIpcName;
@@ -4,6 +4,8 @@
 #include "PeerManager.h"
 #include "RemoteEndpoint.h"
 
+#include <cstring>
+
 #define AUTO_LOCK(m) std::lock_guard<std::mutex> __LOCK(m)
 #define AUTO_RLOCK(rm) std::lock_guard<std::recursive_mutex> __LOCK(rm)
 
@@ -28,7 +30,7 @@ PeerManager::peerTypeName(PeerType pt)
 
 PeerManager::PeerManager()
 {
-
+    setShardCount(1);
 }
 
 PeerManager::~PeerManager()
@@ -36,56 +38,89 @@ PeerManager::~PeerManager()
 
 }
 
+void
+PeerManager::setShardCount(size_t aCount)
+{
+    if (aCount == 0) aCount = 1;
+    mShards.clear();
+    for (size_t i = 0; i < aCount; i++) {
+        mShards.emplace_back(new Shard);
+    }
+}
+
+PeerManager::Shard&
+PeerManager::shardFor(const UUID& aSessionId) const
+{
+    return *mShards[sessionShard(aSessionId, mShards.size())];
+}
+
 RemoteEndpoint::Ptr
 PeerManager::trackClient(const UUID& aId,  RemoteEndpoint* aPeer)
 {
-    AUTO_LOCK(mMutex);
+    Shard& shard = shardFor(aId);
     RemoteEndpoint::Ptr peerPtr(aPeer);
-    mClients[aId] = peerPtr;
-
-    // deliver any messages that have been stashed for this client
-    Envelopes& msgs = mPendingEnvelopes[aId];
 
-    for (const auto& msg : msgs) {
-        aPeer->queueEnvelope(msg);
+    // deliver any messages that have been stashed for this client. The
+    // client is only added to the table once the stash is empty, so that
+    // stashed messages go ahead of anything routed to it directly.
+    // Envelopes are queued with the shard unlocked, because queueing to a
+    // client can route a ClientCongestion message back through here
+    while (true) {
+        Stash stash;
+        {
+            AUTO_LOCK(shard.mMutex);
+            auto it = shard.mPendingEnvelopes.find(aId);
+            if (it == shard.mPendingEnvelopes.end()) {
+                shard.mClients[aId] = peerPtr;
+                return peerPtr;
+            }
+            stash = std::move(it->second);
+            shard.mPendingEnvelopes.erase(it);
+        }
+        for (const auto& msg : stash.mEnvelopes) {
+            aPeer->queueEnvelope(msg);
+        }
+        // messages are now charged to the client's queue
+        releaseStash(stash);
     }
-    return peerPtr;
-
 }
 
 RemoteEndpoint::Ptr
 PeerManager::trackNode(const UUID& aId, RemoteEndpoint*  aPeer)
 {
-    AUTO_LOCK(mMutex);
+    AUTO_LOCK(mNodesMutex);
     RemoteEndpoint::Ptr peerPtr(aPeer);
     mNodes[aId] = peerPtr;
     return peerPtr;
 }
 
 RemoteEndpoint::Ptr
-PeerManager::trackIpc(const UUID& aId, RemoteEndpoint*  aPeer)
+PeerManager::trackIpc(const UUID& aSessionId, const UUID& aId, RemoteEndpoint*  aPeer)
 {
-    AUTO_LOCK(mMutex);
+    Shard& shard = shardFor(aSessionId);
+    AUTO_LOCK(shard.mMutex);
     RemoteEndpoint::Ptr peerPtr(aPeer);
-    mIpc[aId] = peerPtr;
+    shard.mIpc[aId] = peerPtr;
     return peerPtr;
 }
 
 RemoteEndpoint::Ptr
 PeerManager::trackListener(const UUID& aId, RemoteEndpoint*  aPeer)
 {
-    AUTO_LOCK(mMutex);
+    Shard& shard = shardFor(aId);
+    AUTO_LOCK(shard.mMutex);
     RemoteEndpoint::Ptr peerPtr(aPeer);
-    mListeners[aId].push_back(peerPtr);
+    shard.mListeners[aId].push_back(peerPtr);
     return peerPtr;
 }
 
 RemoteEndpoint::Ptr
 PeerManager::findClientPeer(const UUID& aId) const
 {
-    AUTO_LOCK(mMutex);
-    auto it = mClients.find(aId);
-    if (it != mClients.end()) return it->second;
+    const Shard& shard = shardFor(aId);
+    AUTO_LOCK(shard.mMutex);
+    auto it = shard.mClients.find(aId);
+    if (it != shard.mClients.end()) return it->second;
 
     return RemoteEndpoint::Ptr();
 }
@@ -93,19 +128,27 @@ PeerManager::findClientPeer(const UUID& aId) const
 RemoteEndpoint::Ptr
 PeerManager::findNodePeer(const UUID& aId) const
 {
-    AUTO_LOCK(mMutex);
+    AUTO_LOCK(mNodesMutex);
     auto it = mNodes.find(aId);
     if (it != mNodes.end()) return it->second;
 
     return RemoteEndpoint::Ptr();
 }
 
+PeerManager::PeerTable
+PeerManager::getNodePeers() const
+{
+    AUTO_LOCK(mNodesMutex);
+    return mNodes;
+}
+
 RemoteEndpoint::Ptr
-PeerManager::findIpcPeer(const UUID& aId) const
+PeerManager::findIpcPeer(const UUID& aSessionId, const UUID& aId) const
 {
-    AUTO_LOCK(mMutex);
-    auto it = mIpc.find(aId);
-    if (it != mIpc.end()) return it->second;
+    const Shard& shard = shardFor(aSessionId);
+    AUTO_LOCK(shard.mMutex);
+    auto it = shard.mIpc.find(aId);
+    if (it != shard.mIpc.end()) return it->second;
 
     return RemoteEndpoint::Ptr();
 }
@@ -114,9 +157,10 @@ PeerManager::findIpcPeer(const UUID& aId) const
 RemoteEndpointList 
 PeerManager::getListeners(const UUID& aId) const
 {
-    AUTO_LOCK(mMutex);
-    auto it = mListeners.find(aId);
-    if (it != mListeners.end()) return it->second;
+    const Shard& shard = shardFor(aId);
+    AUTO_LOCK(shard.mMutex);
+    auto it = shard.mListeners.find(aId);
+    if (it != shard.mListeners.end()) return it->second;
     
     return RemoteEndpointList();
 }
@@ -125,12 +169,17 @@ PeerManager::PeerType
 PeerManager::findPeer(const RemoteEndpoint* aEndpoint, UUID& aId)
 const
 {
-    // no need to lock since each of the called functions locks
-    if (findPeer(mClients, aEndpoint, aId)) return PEER_CLIENT;
-    else if (findPeer(mNodes, aEndpoint, aId)) return PEER_NODE;
-    else if (findPeer(mIpc, aEndpoint, aId)) return PEER_IPC;
-    else if (findPeer(mListeners, aEndpoint, aId)) return PEER_LISTENER;
-    else return PEER_NONE;
+    {
+        AUTO_LOCK(mNodesMutex);
+        if (findPeer(mNodes, aEndpoint, aId)) return PEER_NODE;
+    }
+    for (const auto& shard : mShards) {
+        AUTO_LOCK(shard->mMutex);
+        if (findPeer(shard->mClients, aEndpoint, aId)) return PEER_CLIENT;
+        else if (findPeer(shard->mIpc, aEndpoint, aId)) return PEER_IPC;
+        else if (findPeer(shard->mListeners, aEndpoint, aId)) return PEER_LISTENER;
+    }
+    return PEER_NONE;
 }
 
 // while the mutex prevents corruption of the tables it is the responsibilty
@@ -139,34 +188,74 @@ const
 PeerManager::PeerType
 PeerManager::destroyPeer(const RemoteEndpoint*  aPeer, UUID& aId)
 {
-    if (eraseIfFound(mClients, aPeer, aId)) return PEER_CLIENT;
-    else if (eraseIfFound(mNodes, aPeer, aId)) return PEER_NODE;
-    else if (eraseIfFound(mIpc, aPeer, aId)) return PEER_IPC;
-    else if (eraseIfFound(mListeners, aPeer, aId)) return PEER_LISTENER;
-    else return PEER_NONE;
+    {
+        AUTO_LOCK(mNodesMutex);
+        if (eraseIfFound(mNodes, aPeer, aId)) return PEER_NODE;
+    }
+    for (const auto& shard : mShards) {
+        AUTO_LOCK(shard->mMutex);
+        if (eraseIfFound(shard->mClients, aPeer, aId)) return PEER_CLIENT;
+        else if (eraseIfFound(shard->mIpc, aPeer, aId)) return PEER_IPC;
+        else if (eraseIfFound(shard->mListeners, aPeer, aId)) return PEER_LISTENER;
+    }
+    return PEER_NONE;
 }
 
-void
-PeerManager::stashEnvelope(const UUID& aSessionId, const impl::Envelope& anEnvelope)
-{
-    AUTO_LOCK(mMutex);
-
-    // need to check again for the client while locked
-    // and either queue it or stash it
-    auto it = mClients.find(aSessionId);
-    if (it != mClients.end()) {
-        it->second->queueEnvelope(anEnvelope);
-    } else {
-        Envelopes& msgs = mPendingEnvelopes[aSessionId];
-        msgs.push_back(anEnvelope);
+size_t
+PeerManager::stashEnvelope(const UUID& aSessionId, const impl::Envelope& anEnvelope,
+                           const SessionMemory::Ptr& aMemory)
+{
+    Shard& shard = shardFor(aSessionId);
+    RemoteEndpoint::Ptr client;
+    {
+        AUTO_LOCK(shard.mMutex);
+
+        // need to check again for the client while locked
+        // and either queue it or stash it
+        auto it = shard.mClients.find(aSessionId);
+        if (it != shard.mClients.end()) {
+            client = it->second;
+        } else {
+            Stash& stash = shard.mPendingEnvelopes[aSessionId];
+            if (aMemory) {
+                size_t bytes = SessionMemory::envelopeSize(anEnvelope);
+                if (!aMemory->charge(bytes)) {
+                    // session has exceeded its memory limit
+                    return 0;
+                }
+                stash.mMemory = aMemory;
+                stash.mBytes += bytes;
+            }
+            stash.mEnvelopes.push_back(anEnvelope);
+            return stash.mEnvelopes.size();
+        }
     }
+    // queued unlocked, as in trackClient
+    client->queueEnvelope(anEnvelope);
+    return 0;
 }
 
 void
 PeerManager::clearStashedEnvelopes(const UUID& aSessionId)
 {
-    AUTO_LOCK(mMutex);
-    mPendingEnvelopes.erase(aSessionId);
+    Shard& shard = shardFor(aSessionId);
+    AUTO_LOCK(shard.mMutex);
+    auto it = shard.mPendingEnvelopes.find(aSessionId);
+    if (it != shard.mPendingEnvelopes.end()) {
+        releaseStash(it->second);
+        shard.mPendingEnvelopes.erase(it);
+    }
+}
+
+// called with the shard mutex locked, or once the stash has
+// been taken out of the table
+void
+PeerManager::releaseStash(Stash& aStash)
+{
+    if (aStash.mMemory) {
+        aStash.mMemory->release(aStash.mBytes);
+        aStash.mBytes = 0;
+    }
 }
 
 // while the mutex prevents corruption of the tables it is the responsibilty
@@ -176,7 +265,6 @@ bool
 PeerManager::eraseIfFound(PeerTable& aHaystack, const RemoteEndpoint* aNeedle, UUID& aId)
 {
     bool found = false;
-    AUTO_LOCK(mMutex);
     for (PeerTable::iterator it = aHaystack.begin(); it != aHaystack.end(); ++it) {
         if (it->second.get() == aNeedle) {
             aId = it->first;
@@ -193,7 +281,6 @@ bool
 PeerManager::eraseIfFound(ListenerTable& aHaystack, const RemoteEndpoint* aNeedle, UUID& aId)
 {
     bool found = false;
-    AUTO_LOCK(mMutex);
     for (ListenerTable::iterator it = aHaystack.begin(); it != aHaystack.end(); ++it) {
         for (RemoteEndpointList::iterator jt = it->second.begin();
              jt != it->second.end(); ++jt) {
@@ -215,10 +302,9 @@ PeerManager::eraseIfFound(ListenerTable& aHaystack, const RemoteEndpoint* aNeedl
 }
 
 bool
-PeerManager::findPeer(const PeerTable& aHaystack, const RemoteEndpoint* aNeedle, UUID& aId) const
+PeerManager::findPeer(const PeerTable& aHaystack, const RemoteEndpoint* aNeedle, UUID& aId)
 {
     bool found = false;
-    AUTO_LOCK(mMutex);
     for (auto& it : aHaystack) {
         if (it.second.get() == aNeedle) {
             aId = it.first;
@@ -231,10 +317,9 @@ PeerManager::findPeer(const PeerTable& aHaystack, const RemoteEndpoint* aNeedle,
 }
 
 bool
-PeerManager::findPeer(const ListenerTable& aHaystack, const RemoteEndpoint* aNeedle, UUID& aId) const
+PeerManager::findPeer(const ListenerTable& aHaystack, const RemoteEndpoint* aNeedle, UUID& aId)
 { 
     bool found = false;
-    AUTO_LOCK(mMutex);
     for (auto& it : aHaystack) {
         for (auto& jt : it.second) {
             if (jt.get() == aNeedle) {
@@ -248,6 +333,16 @@ PeerManager::findPeer(const ListenerTable& aHaystack, const RemoteEndpoint* aNee
     return found;
 }
 
+size_t
+sessionShard(const UUID& aSessionId, size_t aShardCount)
+{
+    if (aShardCount <= 1) return 0;
+    // session ids are random, so some of their bits serve as the hash
+    unsigned long long bits;
+    memcpy(&bits, &aSessionId, sizeof(bits));
+    return bits % aShardCount;
+}
+
 }
 }
 
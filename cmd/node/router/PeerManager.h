@@ -6,6 +6,7 @@
 
 #include <message_api/messageapi_types.h>
 #include <message_impl/Envelope.h>
+#include "SessionMemory.h"
 #include <map>
 #include <mutex>
 #include <vector>
@@ -16,6 +17,14 @@
 // of the tables but it is still the responsibility of the calling
 // code to make sure that an entry isn't removed before all need
 // for the RemoteEndpoint is done.
+//
+// Tables are divided into shards by session id (see setShardCount), each
+// with its own lock, so that routing for sessions in different shards
+// doesn't contend. Clients, listeners, computations and stashed messages
+// belong to the shard of their session. Node connections are shared by
+// all sessions and have a separate table. Lookups by endpoint pointer
+// (findPeer, destroyPeer) search every shard, but these only happen on
+// disconnect.
 
 namespace arras4 {
     namespace node {
@@ -40,45 +49,71 @@ public:
     PeerManager();
     ~PeerManager();
 
+    // must be called before any peers are tracked. The default is one shard
+    void setShardCount(size_t aCount);
+    size_t shardCount() const { return mShards.size(); }
+
     std::shared_ptr<RemoteEndpoint> trackClient(const api::UUID& aId,  RemoteEndpoint* aPeer);
     std::shared_ptr<RemoteEndpoint> trackNode(const api::UUID& aId, RemoteEndpoint*  aPeer);
-    std::shared_ptr<RemoteEndpoint> trackIpc(const api::UUID& aId, RemoteEndpoint*  aPeer);
+    std::shared_ptr<RemoteEndpoint> trackIpc(const api::UUID& aSessionId, const api::UUID& aId, RemoteEndpoint*  aPeer);
     std::shared_ptr<RemoteEndpoint> trackListener(const api::UUID& aId, RemoteEndpoint*  aPeer);
     std::shared_ptr<RemoteEndpoint> findClientPeer(const api::UUID& aId) const;
     std::shared_ptr<RemoteEndpoint> findNodePeer(const api::UUID& aId) const;
-    std::shared_ptr<RemoteEndpoint> findIpcPeer(const api::UUID& aId) const;
+    std::shared_ptr<RemoteEndpoint> findIpcPeer(const api::UUID& aSessionId, const api::UUID& aId) const;
     RemoteEndpointList getListeners(const api::UUID& aId) const;
+    // all connected nodes, by node id
+    std::map<api::UUID, std::shared_ptr<RemoteEndpoint> > getNodePeers() const;
     PeerType findPeer(const RemoteEndpoint* aEndpoint, api::UUID& aId) const;
     PeerType destroyPeer(const RemoteEndpoint*  aPeer, api::UUID& aId);
 
     // stash messages pending for not-yet-connected clients (these will be
     // sent automatically for any new client when trackClient(...) is called
     // with the RemoteEndpoint)
-    void stashEnvelope(const api::UUID& aSessionId, const impl::Envelope& anEnvelope);
+    // stashed messages are charged to the session's memory (if given).
+    // returns the number of messages now stashed for the session (0 if
+    // the envelope was queued to the client or dropped)
+    size_t stashEnvelope(const api::UUID& aSessionId, const impl::Envelope& anEnvelope,
+                       const SessionMemory::Ptr& aMemory);
     // clear any stashed messages for a client that did not make it in time
     void clearStashedEnvelopes(const api::UUID& aSessionId);
 
 private:
     typedef std::map<api::UUID, std::shared_ptr<RemoteEndpoint> > PeerTable;
-    PeerTable mClients;
-    PeerTable mNodes;
-    PeerTable mIpc;
     typedef std::map<api::UUID, RemoteEndpointList > ListenerTable;
-    ListenerTable mListeners;
 
     typedef std::vector<impl::Envelope> Envelopes;
-    typedef std::map<api::UUID /* session ID */, Envelopes> PendingEnvelopes;
-    PendingEnvelopes mPendingEnvelopes;
+    struct Stash {
+        Envelopes mEnvelopes;
+        SessionMemory::Ptr mMemory;
+        size_t mBytes = 0;  // charged to mMemory
+    };
+    typedef std::map<api::UUID /* session ID */, Stash> PendingEnvelopes;
+    void releaseStash(Stash& aStash);
+
+    // the peers of the sessions that hash to one shard
+    struct Shard {
+        PeerTable mClients;     // by session id
+        PeerTable mIpc;         // by computation id
+        ListenerTable mListeners; // by session id
+        PendingEnvelopes mPendingEnvelopes;
+        mutable std::mutex mMutex;
+    };
+    std::vector<std::unique_ptr<Shard> > mShards;
+    Shard& shardFor(const api::UUID& aSessionId) const;
 
-    bool eraseIfFound(PeerTable& aHaystack, const RemoteEndpoint* aNeedle, api::UUID& aId);
-    bool eraseIfFound(ListenerTable& aHaystack, const RemoteEndpoint* aNeedle, api::UUID& aId);
-    bool findPeer(const PeerTable& aHaystack, const RemoteEndpoint* aNeedle, api::UUID& aId) const;
-    bool findPeer(const ListenerTable& aHaystack, const RemoteEndpoint* aNeedle, api::UUID& aId) const;
+    PeerTable mNodes;
+    mutable std::mutex mNodesMutex;
 
-    // thread-safety
-    mutable std::mutex mMutex;
+    // these are called with the mutex for aHaystack locked
+    static bool eraseIfFound(PeerTable& aHaystack, const RemoteEndpoint* aNeedle, api::UUID& aId);
+    static bool eraseIfFound(ListenerTable& aHaystack, const RemoteEndpoint* aNeedle, api::UUID& aId);
+    static bool findPeer(const PeerTable& aHaystack, const RemoteEndpoint* aNeedle, api::UUID& aId);
+    static bool findPeer(const ListenerTable& aHaystack, const RemoteEndpoint* aNeedle, api::UUID& aId);
 };
 
+// the shard (0 to aShardCount-1) that a session belongs to
+size_t sessionShard(const api::UUID& aSessionId, size_t aShardCount);
+
 
 } 
 }
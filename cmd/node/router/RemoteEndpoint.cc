@@ -7,7 +7,6 @@
 
 #include <arras4_log/Logger.h>
 #include <arras4_log/LogEventStream.h>
-#include <arras4_athena/AthenaLogger.h>
 
 #include <network/InetSocketPeer.h>
 #include <network/SocketPeer.h>
@@ -21,10 +20,11 @@
 #include <core_messages/ControlMessage.h>
 #include <core_messages/PongMessage.h>
 
+#include <node/messages/NodeProbeMessage.h>
+
 #include <exceptions/InternalError.h>
 #include <exceptions/ShutdownException.h>
 
-#include <boost/format.hpp>
 #include <chrono>
 #include <functional>
 #include <memory>
@@ -36,6 +36,10 @@
 // interval between sending stats
 constexpr unsigned long long SEND_STATS_INTERVAL_SECS = 30;
 
+// node endpoints drop cache entries for deleted sessions when the
+// routing data cache reaches this size
+constexpr size_t ROUTING_CACHE_PRUNE_SIZE = 64;
+
 using namespace std::placeholders;
 using namespace arras4::api;
 using namespace arras4::impl;
@@ -47,30 +51,14 @@ namespace node {
 std::string
 RemoteEndpoint::describe() const
 {
-    if (mPeerType == PeerManager::PEER_CLIENT) {
-        return "client";
-    } else if (mPeerType == PeerManager::PEER_NODE) {
-        return "node("+mUUID.toString()+")";
-    } else if (mPeerType == PeerManager::PEER_IPC) {
-        return "computation("+mUUID.toString()+")";
-    } else if (mPeerType == PeerManager::PEER_SERVICE) {
-        return "service";
-    }
-    return "peer("+mUUID.toString()+")";
+    if (!mPolicy.mDescribeId) return mPolicy.mName;
+    return std::string(mPolicy.mName) + "(" + mUUID.toString() + ")";
 }
 
 void
 RemoteEndpoint::disconnect()
 {
-    if (mPeerType == PeerManager::PEER_CLIENT) {
-        ARRAS_DEBUG(log::Session(mSessionId.toString()) <<
-                   "Client disconnected");
-
-        mThreadedNodeRouter.notifyClientDisconnected(mSessionId, "clientDroppedConnection");
-    } else if (mPeerType == PeerManager::PEER_SERVICE) {
-        ARRAS_DEBUG("arras4_node has disconnected. Shutting down arras4_noderouter.");
-        mThreadedNodeRouter.serviceDisconnected();
-    }
+    if (mPolicy.mOnDisconnect) (this->*mPolicy.mOnDisconnect)();
     flagForDestruction();
 }
 
@@ -86,11 +74,16 @@ RemoteEndpoint::sendThread()
 
     while (1) {
         impl::Envelope envelope;        
+        HopTracer::HopPtr hop;
+        unsigned long long enqueueNs = 0;
         bool shouldDisconnect = false;
         try {  
             mMessageQueue->pop(envelope);
+            takeQueuedEntry(envelope, hop, enqueueNs);
             if (mShutdown) return;
-            sendEnvelope(envelope);
+            if (!envelope.isEmpty()) sendEnvelope(envelope);
+            if (hop) mThreadedNodeRouter.hopTracer().recordHop(*hop, describe(), enqueueNs,
+                                                               HopTracer::now());
         } 
 
         catch (const impl::ShutdownException &) {
@@ -203,6 +196,56 @@ RemoteEndpoint::sendThreadWithConnect()
 // timeout in milliseconds of reads
 const int ENDPOINT_POLL_TIMEOUT = 1000;
 
+const RemoteEndpoint::ReceivePolicy&
+RemoteEndpoint::receivePolicy(PeerManager::PeerType aType)
+{
+    // built on first use, after the message class ids have been initialized
+    static const ReceivePolicy client{
+        {{impl::ControlMessage::ID, &RemoteEndpoint::handleClientControl},
+         {impl::ExecutorHeartbeat::ID, &RemoteEndpoint::ignoreMessage},
+         {impl::PongMessage::ID, &RemoteEndpoint::routeFromSession}},
+        &RemoteEndpoint::routeFromSession, &RemoteEndpoint::notifyClientDropped,
+        "client", false, false, false, true};
+    static const ReceivePolicy ipc{
+        {{impl::ControlMessage::ID, &RemoteEndpoint::checkControl},
+         {impl::ExecutorHeartbeat::ID, &RemoteEndpoint::handleHeartbeat},
+         {impl::PongMessage::ID, &RemoteEndpoint::routeFromSession}},
+        &RemoteEndpoint::routeFromSession, nullptr,
+        "computation", true, false, false, true};
+    static const ReceivePolicy nodePeer{
+        {{impl::ControlMessage::ID, &RemoteEndpoint::checkControl},
+         {impl::ExecutorHeartbeat::ID, &RemoteEndpoint::ignoreMessage},
+         {impl::PongMessage::ID, &RemoteEndpoint::routeFromNode},
+         {NodeProbeMessage::ID, &RemoteEndpoint::handleNodeProbe}},
+        &RemoteEndpoint::routeFromNode, nullptr,
+        "node", true, false, true, true};
+    static const ReceivePolicy listener{
+        {{impl::ControlMessage::ID, &RemoteEndpoint::checkControl},
+         {impl::ExecutorHeartbeat::ID, &RemoteEndpoint::ignoreMessage}},
+        &RemoteEndpoint::ignoreFromListener, nullptr,
+        "listener", true, false, false, true};
+    // every message from NodeService is handled by NodeRouter
+    static const ReceivePolicy service{
+        {},
+        &RemoteEndpoint::forwardToService, &RemoteEndpoint::notifyServiceDropped,
+        "service", false, true, false, false};
+    static const ReceivePolicy other{
+        {{impl::ControlMessage::ID, &RemoteEndpoint::checkControl},
+         {impl::ExecutorHeartbeat::ID, &RemoteEndpoint::ignoreMessage},
+         {impl::PongMessage::ID, &RemoteEndpoint::routeFromSession}},
+        &RemoteEndpoint::routeFromSession, nullptr,
+        "peer", true, false, false, true};
+
+    switch (aType) {
+    case PeerManager::PEER_CLIENT: return client;
+    case PeerManager::PEER_IPC: return ipc;
+    case PeerManager::PEER_NODE: return nodePeer;
+    case PeerManager::PEER_LISTENER: return listener;
+    case PeerManager::PEER_SERVICE: return service;
+    default: return other;
+    }
+}
+
 int
 RemoteEndpoint::onEndpointActivity()
 {
@@ -211,55 +254,140 @@ RemoteEndpoint::onEndpointActivity()
     // callers
     receiveEnvelope();
 
-    if (mPeerType == PeerManager::PEER_SERVICE) {
-        mThreadedNodeRouter.pushServiceToRouterQueue(mLastEnvelope);
+    // chosen by receiveEnvelope from the endpoint's policy
+    (this->*mLastAction)();
 
-    } else if (mLastEnvelope.classId() == impl::ControlMessage::ID) {
-        // ControlMessage are not routed
-        if (mPeerType == PeerManager::PEER_CLIENT) { 
-            auto cm = mLastEnvelope.contentAs<impl::ControlMessage>();
-            // Note that this relies on the fact that receive() always deserializes Control messages
-            if (cm && cm->command() == "disconnect") {
-                mThreadedNodeRouter.notifyClientDisconnected(mSessionId, "clientShutdown");
-            }
-        } else if (mLastEnvelope.to().size() == 1
-                   && mLastEnvelope.to().front().computation.isNull()
-                   && mLastEnvelope.to().front().node == mThreadedNodeRouter.getNodeId()) {
-            ARRAS_ERROR(log::Id("badControlMessage") <<
-                        log::Session(mSessionId.toString()) <<
-                        "Unexpected control message from " << describe());
-        }
-       
-    } else if (mLastEnvelope.classId() == impl::ExecutorHeartbeat::ID) {
-        // ExecutorHeartbeat are not routed
-        // These should only come from IPC connections. Ignore anything else
-        if (mPeerType == PeerManager::PEER_IPC) {
-            // note this relies on the fact that receive() always deserializes ExecutorHeartbeat
-            auto heartbeat = mLastEnvelope.contentAs<impl::ExecutorHeartbeat>();
-
-            // forward heartbeats to NodeService. need to add a from address because the computation doesn't
-            mThreadedNodeRouter.notifyHeartbeat(heartbeat, mSessionId.toString(), mUUID.toString());
-            
-            // send stats to stats log, if it's time
-            sendStats(heartbeat);
-        }
+    disposeEnvelope();
+    return 0;
+}
+
+void
+RemoteEndpoint::forwardToService()
+{
+    mThreadedNodeRouter.pushServiceToRouterQueue(mLastEnvelope);
+}
+
+void
+RemoteEndpoint::routeFromSession()
+{
+    if (mRoutingData) routeToSession(mRoutingData);
+}
+
+void
+RemoteEndpoint::routeFromNode()
+{
+    // node connections carry many sessions : use the routing data
+    // of the message's session
+    const UUID& sessionId = mLastEnvelope.to().front().session;
+    SessionRoutingData::Ptr routingData = cachedRoutingData(sessionId);
+    if (routingData == nullptr) {
+        ARRAS_WARN("Received message for unknown session(" << sessionId.toString() << ") from " << describe());
+        return;
+    }
+    routeToSession(routingData);
+}
+
+void
+RemoteEndpoint::routeToSession(const SessionRoutingData::Ptr& aRoutingData)
+{
+    // sampled messages carry their hop to the destination queues via
+    // the current thread
+    HopTracer& tracer = mThreadedNodeRouter.hopTracer();
+    if (tracer.enabled() && tracer.sampled(mLastEnvelope)) {
+        std::shared_ptr<HopTracer::Hop> hop = std::make_shared<HopTracer::Hop>();
+        hop->mTraceId = mLastEnvelope.metadata()->instanceId();
+        hop->mSessionId = aRoutingData->sessionId();
+        hop->mName = mLastEnvelope.metadata()->routingName();
+        hop->mFrom = describe();
+        hop->mReceiveNs = mReceiveNs;
+        HopTracer::setCurrent(hop);
+    }
+    // the message is charged to the session's memory by each queue (or
+    // stash) it goes into, not while it is being routed : once a session
+    // has failed its messages are dropped here
+    size_t bytes = SessionMemory::envelopeSize(mLastEnvelope);
+    aRoutingData->traffic()->received(mPeerType, bytes);
+    if (!aRoutingData->memory()->hasFailed()) {
+        routeMessage(mLastEnvelope, aRoutingData, mThreadedNodeRouter);
     } else {
-        if (mPeerType == PeerManager::PEER_NODE) {
-            // can't use cached routing information, get it for the session
-            const UUID& sessionId = mLastEnvelope.to().front().session;
-            SessionRoutingData::Ptr routingData = mThreadedNodeRouter.sessionRoutingData(sessionId);
-            if (routingData == nullptr) {
-                ARRAS_WARN("Received message for unknown session(" << sessionId.toString() << ") from " << describe());
-            } else {
-                routeMessage(mLastEnvelope, routingData, mThreadedNodeRouter);
-            }
-        } else {
-            routeMessage(mLastEnvelope, mRoutingData, mThreadedNodeRouter);
-        }
+        ARRAS_DEBUG(log::Session(aRoutingData->sessionId().toString()) <<
+                    "Dropped message from " << describe() << ": session memory limit exceeded");
+        aRoutingData->traffic()->dropped();
     }
+    HopTracer::setCurrent(HopTracer::HopPtr());
+}
 
-    disposeEnvelope();
-    return 0;
+void
+RemoteEndpoint::ignoreFromListener()
+{
+    // listeners are read-only
+    ARRAS_DEBUG(log::Session(mSessionId.toString()) <<
+                "Ignored message from " << describe());
+}
+
+void
+RemoteEndpoint::ignoreMessage()
+{
+}
+
+void
+RemoteEndpoint::handleClientControl()
+{
+    // ControlMessage are not routed
+    auto cm = mLastEnvelope.contentAs<impl::ControlMessage>();
+    if (cm && cm->command() == "disconnect") {
+        mThreadedNodeRouter.notifyClientDisconnected(mSessionId, "clientShutdown");
+    }
+}
+
+void
+RemoteEndpoint::checkControl()
+{
+    // ControlMessage are not routed
+    if (mLastEnvelope.to().size() == 1
+        && mLastEnvelope.to().front().computation.isNull()
+        && mLastEnvelope.to().front().node == mThreadedNodeRouter.getNodeId()) {
+        ARRAS_ERROR(log::Id("badControlMessage") <<
+                    log::Session(mSessionId.toString()) <<
+                    "Unexpected control message from " << describe());
+    }
+}
+
+void
+RemoteEndpoint::handleHeartbeat()
+{
+    // ExecutorHeartbeat are not routed
+    auto heartbeat = mLastEnvelope.contentAs<impl::ExecutorHeartbeat>();
+
+    // forward heartbeats to NodeService, with stats sent to the stats log if it's time.
+    // these are batched, so that nothing more expensive than a map update happens here
+    mThreadedNodeRouter.notifyHeartbeat(heartbeat, mSessionId, mUUID, statsDue(heartbeat));
+}
+
+void
+RemoteEndpoint::handleNodeProbe()
+{
+    // link probes between routers are not routed
+    auto probe = mLastEnvelope.contentAs<NodeProbeMessage>();
+    if (probe) {
+        mThreadedNodeRouter.nodeProber().handleProbe(*this, mUUID, *probe);
+    }
+}
+
+void
+RemoteEndpoint::notifyClientDropped()
+{
+    ARRAS_DEBUG(log::Session(mSessionId.toString()) <<
+               "Client disconnected");
+
+    mThreadedNodeRouter.notifyClientDisconnected(mSessionId, "clientDroppedConnection");
+}
+
+void
+RemoteEndpoint::notifyServiceDropped()
+{
+    ARRAS_DEBUG("arras4_node has disconnected. Shutting down arras4_noderouter.");
+    mThreadedNodeRouter.serviceDisconnected();
 }
 
 void
@@ -278,21 +406,68 @@ RemoteEndpoint::receiveThread()
         }
     }
 
-    while (1) { 
+    // in blocking mode the thread waits inside the read itself, saving a
+    // poll() call per message. The destructor shuts down the socket to wake it.
+    // Node endpoints always poll, because their peer can be replaced by setPeer()
+    const bool blocking = (mThreadedNodeRouter.receiveMode() == ReceiveMode::Blocking) &&
+                          (mPeerType != PeerManager::PEER_NODE);
+
+    // client and computation endpoints of eligible sessions spin on a reserved
+    // cpu while messages are arriving (see BusyPoll.h)
+    BusyPoller& busyPoller = mThreadedNodeRouter.busyPoller();
+    const bool busyPollable = !blocking && busyPoller.enabled() && mRoutingData &&
+        (mPeerType == PeerManager::PEER_CLIENT || mPeerType == PeerManager::PEER_IPC) &&
+        (busyPoller.allSessions() || mRoutingData->busyPoll());
+    BusyPoller::Slot busySlot(busyPoller);
+    bool socketBusyPollSet = false;
+    std::chrono::steady_clock::time_point lastActivity;
 
-        struct pollfd pfd;
-        pfd.fd = fd();
-        pfd.events = POLLIN;
+    while (1) { 
 
-        int r = ::poll(&pfd, 1, ENDPOINT_POLL_TIMEOUT);
+        // exit the thread when asked to shutdown
+        if (mShutdown) return;
 
-        if (r < 0) {
-            disconnect();
-            return; // exit thread
+        // stop reading from the client or computation while its session
+        // is over the memory limit, so that the producer is throttled
+        // by the socket. The other session endpoints keep draining
+        if (mRoutingData && 
+            mRoutingData->memory()->shouldThrottle() &&
+            !mRoutingData->memory()->waitForSpace(std::chrono::milliseconds(ENDPOINT_POLL_TIMEOUT))) {
+            continue;
         }
 
-        // exit the thread when asked to shutdown
-        if (mShutdown) return;
+        int r = 1;
+        if (!blocking) {
+            struct pollfd pfd;
+            pfd.fd = fd();
+            pfd.events = POLLIN;
+
+            r = ::poll(&pfd, 1, busySlot.held() ? 0 : ENDPOINT_POLL_TIMEOUT);
+
+            if (r < 0) {
+                disconnect();
+                return; // exit thread
+            }
+
+            // exit the thread when asked to shutdown
+            if (mShutdown) return;
+
+            if (busySlot.held()) {
+                std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                if (r == 1) {
+                    lastActivity = now;
+                } else if (now - lastActivity > busyPoller.idlePeriod()) {
+                    // idle : give the cpu back and wait normally
+                    busySlot.release();
+                }
+            } else if (r == 1 && busyPollable && busySlot.acquire()) {
+                if (!socketBusyPollSet) {
+                    BusyPoller::setSocketBusyPoll(pfd.fd);
+                    socketBusyPollSet = true;
+                }
+                lastActivity = std::chrono::steady_clock::now();
+            }
+        }
 
         if (r == 1) {
             bool shouldDisconnect = false;
@@ -336,7 +511,9 @@ RemoteEndpoint::receiveThread()
             }
 
             if (shouldDisconnect) {
-                disconnect();
+                // a blocked read fails when the destructor shuts down the socket,
+                // and the endpoint mustn't then be queued for destruction again
+                if (!mShutdown) disconnect();
                 return; // exit thread
             }
         }
@@ -351,6 +528,7 @@ RemoteEndpoint::RemoteEndpoint(
     ThreadedNodeRouter& aThreadedNodeRouter,
     const std::string& traceInfo) :
     mPeerType(aType),
+    mPolicy(receivePolicy(aType)),
     mUUID(aUuid),
     mShutdown(false),
     mFlaggedForDestruction(false), 
@@ -398,6 +576,7 @@ RemoteEndpoint::RemoteEndpoint(
     const std::string& traceInfo) :
     mNodeInfo(aNodeInfo),
     mPeerType(aType),
+    mPolicy(receivePolicy(aType)),
     mUUID(aUuid),
     mShutdown(false),
     mFlaggedForDestruction(false), 
@@ -448,6 +627,29 @@ RemoteEndpoint::~RemoteEndpoint()
     if (mSendThread.joinable()) mSendThread.join();
     if (mReceiveThread.joinable()) mReceiveThread.join();
 
+    // release memory charged for envelopes that were never sent
+    {
+        std::lock_guard<std::mutex> lock(mQueueMutex);
+        for (const QueuedCharge& charge : mQueuedCharges) {
+            if (charge.mMemory) charge.mMemory->release(charge.mBytes);
+        }
+        mQueuedCharges.clear();
+        for (const auto& slot : mConflationSlots) {
+            if (slot.second.mMemory) slot.second.mMemory->release(slot.second.mBytes);
+        }
+        mConflationSlots.clear();
+        if (mConflatedCount) {
+            ARRAS_DEBUG(log::Session(mSessionId.toString()) <<
+                        mConflatedCount << " messages to " << describe() <<
+                        " were replaced by newer ones before being sent");
+        }
+        if (mDroppedCount) {
+            ARRAS_INFO(log::Session(mSessionId.toString()) <<
+                       mDroppedCount << " messages to " << describe() <<
+                       " were dropped because its queue was full");
+        }
+    }
+
     delete mPeer;
     delete mMessageEndpoint;
 }
@@ -457,19 +659,39 @@ RemoteEndpoint::receiveEnvelope()
 {
     // message is read as OpaqueContent to avoid deserialization cost
     mLastEnvelope = mMessageEndpoint->getEnvelope();
-
-    // these three message types are handled directly by RemoteEndpoint,
-    // and must always be fully deserialized (see onEndpointActivity)
-    if ((mLastEnvelope.classId() == impl::ControlMessage::ID) || 
-        (mLastEnvelope.classId() == impl::ExecutorHeartbeat::ID) ||
-        (mLastEnvelope.classId() == impl::PongMessage::ID) ||
-        (mPeerType == PeerManager::PEER_SERVICE)) {
+    if (mThreadedNodeRouter.hopTracer().enabled()) mReceiveNs = HopTracer::now();
+
+    // the message types in the policy's table are handled directly by
+    // RemoteEndpoint, and must always be fully deserialized
+    mLastAction = mPolicy.mRoute;
+    bool deserialize = mPolicy.mDeserializeAll;
+    const ClassID& classId = mLastEnvelope.classId();
+    for (const ReceivePolicy::Handler& handler : mPolicy.mHandlers) {
+        if (handler.mClassId == classId) {
+            mLastAction = handler.mAction;
+            deserialize = true;
+            break;
+        }
+    }
+    if (deserialize) {
         MessageReader::deserializeContent(mLastEnvelope);
     }
 
     // give subclass (specifically ClientRemoteEndpoint)
     // the chance to address the incoming envelope
     addressReceivedEnvelope();
+
+    // record the message if traffic capture is enabled
+    RouterCapture& capture = mThreadedNodeRouter.capture();
+    if (capture.enabled() && mPolicy.mCaptured) {
+        // node connections are shared by sessions, so take the session from the address
+        const api::UUID& sessionId = (mPolicy.mSharedBySessions && !mLastEnvelope.to().empty()) ?
+            mLastEnvelope.to().front().session : mSessionId;
+        capture.record(sessionId, static_cast<uint8_t>(mPeerType), mUUID, mLastEnvelope);
+    }
+
+    // move very large payloads out of the heap before they are queued
+    mThreadedNodeRouter.payloadMapper().mapIfLarge(mLastEnvelope);
 }
 
 void
@@ -479,16 +701,217 @@ RemoteEndpoint::disposeEnvelope()
     mLastEnvelope.clear();
 }
 
+// find the session that owns an envelope being queued. Client and
+// computation endpoints belong to a single session, but node endpoints
+// carry traffic for many sessions
+SessionRoutingData::Ptr
+RemoteEndpoint::sessionRoutingDataFor(const Envelope& anEnvelope) const
+{
+    if (mRoutingData)
+        return mRoutingData;
+    if (mPeerType == PeerManager::PEER_SERVICE || anEnvelope.to().empty())
+        return SessionRoutingData::Ptr();
+    return cachedRoutingData(anEnvelope.to().front().session);
+}
+
+// routing data for the sessions seen on a node endpoint is cached, rather
+// than looked up in the routing table for every envelope. Entries are
+// dropped once the session is deleted from the table
+SessionRoutingData::Ptr
+RemoteEndpoint::cachedRoutingData(const UUID& aSessionId) const
+{
+    std::lock_guard<std::mutex> lock(mRoutingCacheMutex);
+    auto it = mRoutingCache.find(aSessionId);
+    if (it != mRoutingCache.end()) {
+        SessionRoutingData::Ptr data = it->second.lock();
+        if (data && !data->removed())
+            return data;
+        mRoutingCache.erase(it);
+    }
+    SessionRoutingData::Ptr data = mThreadedNodeRouter.sessionRoutingData(aSessionId);
+    if (data) {
+        if (mRoutingCache.size() >= ROUTING_CACHE_PRUNE_SIZE) {
+            for (auto jt = mRoutingCache.begin(); jt != mRoutingCache.end(); ) {
+                SessionRoutingData::Ptr cached = jt->second.lock();
+                if (!cached || cached->removed())
+                    jt = mRoutingCache.erase(jt);
+                else
+                    ++jt;
+            }
+        }
+        mRoutingCache[aSessionId] = data;
+    }
+    return data;
+}
+
+void
+RemoteEndpoint::takeQueuedEntry(Envelope& anEnvelope,
+                                HopTracer::HopPtr& aHop,
+                                unsigned long long& aEnqueueNs)
+{
+    SessionMemory::Ptr memory;
+    SessionTraffic::Ptr traffic;
+    std::chrono::steady_clock::time_point queuedAt;
+    size_t bytes = 0;
+    size_t depth, depthBytes;
+    {
+        std::lock_guard<std::mutex> lock(mQueueMutex);
+        if (mQueuedCharges.empty()) return;
+        QueuedCharge& charge = mQueuedCharges.front();
+        traffic = std::move(charge.mTraffic);
+        queuedAt = charge.mQueuedAt;
+        if (charge.mConflated) {
+            auto it = mConflationSlots.find(charge.mKey);
+            if (it != mConflationSlots.end()) {
+                anEnvelope = it->second.mEnvelope;
+                memory = it->second.mMemory;
+                bytes = it->second.mBytes;
+                mConflationSlots.erase(it);
+            }
+        } else {
+            memory = charge.mMemory;
+            bytes = charge.mBytes;
+            aHop = std::move(charge.mHop);
+            aEnqueueNs = charge.mEnqueueNs;
+        }
+        mQueuedCharges.pop_front();
+        mQueuedBytes -= bytes;
+        depth = mQueuedCharges.size();
+        depthBytes = mQueuedBytes;
+    }
+    if (memory) memory->release(bytes);
+    if (traffic && !anEnvelope.isEmpty()) {
+        traffic->sent(mPeerType, SessionMemory::envelopeSize(anEnvelope),
+                      std::chrono::steady_clock::now() - queuedAt);
+    }
+    queueChanged(depth, depthBytes, true);
+}
+
 void
 RemoteEndpoint::queueEnvelope(const Envelope& anEnvelope)
 {
+    SessionRoutingData::Ptr routingData = sessionRoutingDataFor(anEnvelope);
+    QueuedCharge charge{routingData ? routingData->memory() : SessionMemory::Ptr(),
+                        SessionMemory::envelopeSize(anEnvelope)};
+    if (routingData) {
+        charge.mTraffic = routingData->traffic();
+        charge.mQueuedAt = std::chrono::steady_clock::now();
+    }
+    charge.mHop = HopTracer::current();
+    if (charge.mHop) charge.mEnqueueNs = HopTracer::now();
+    bool full = false;
+    if (charge.mMemory) {
+        // a listener's queue that is already full drops the message
+        // without charging it, so that a slow listener can't push the
+        // session over its memory limit
+        if (mPeerType == PeerManager::PEER_LISTENER) {
+            std::lock_guard<std::mutex> lock(mQueueMutex);
+            full = queueFull_wlock(charge.mBytes);
+        }
+        if (full) {
+            charge.mMemory.reset();
+        } else if (!charge.mMemory->charge(charge.mBytes)) {
+            ARRAS_DEBUG(log::Session(mSessionId.toString()) <<
+                        "Message to " << describe() << " dropped: session memory limit exceeded");
+            charge.mTraffic->dropped();
+            return;
+        }
+    }
+    // client messages of some classes only need their latest value delivered
+    bool conflate = (mPeerType == PeerManager::PEER_CLIENT) &&
+        mRoutingData && mRoutingData->conflatesToClient(anEnvelope);
+    SessionMemory::Ptr replacedMemory;
+    size_t replacedBytes = 0;
+    bool queued = false;
+    size_t depth = 0, depthBytes = 0;
     try {
-        mMessageQueue->push(anEnvelope);
+        // the charge goes in first, so it is there when the send thread pops the envelope
+        std::lock_guard<std::mutex> lock(mQueueMutex);
+        if (full || queueFull_wlock(charge.mBytes)) {
+            full = true;
+            mDroppedCount++;
+        } else if (conflate) {
+            ConflationKey key(anEnvelope.classId(),
+                              anEnvelope.metadata() ? anEnvelope.metadata()->from().computation : api::UUID());
+            auto it = mConflationSlots.find(key);
+            if (it != mConflationSlots.end()) {
+                // replace the unsent message : its placeholder is already queued
+                replacedMemory = it->second.mMemory;
+                replacedBytes = it->second.mBytes;
+                it->second = ConflationSlot{anEnvelope, charge.mMemory, charge.mBytes};
+                mConflatedCount++;
+                mQueuedBytes = mQueuedBytes + charge.mBytes - replacedBytes;
+            } else {
+                // the slot holds the charge, and an empty envelope is queued
+                // so that the payload can be freed as soon as it is replaced
+                mConflationSlots[key] = ConflationSlot{anEnvelope, charge.mMemory, charge.mBytes};
+                QueuedCharge placeholder{SessionMemory::Ptr(), 0, true, key};
+                placeholder.mTraffic = charge.mTraffic;
+                placeholder.mQueuedAt = charge.mQueuedAt;
+                mQueuedCharges.push_back(placeholder);
+                try {
+                    mMessageQueue->push(Envelope());
+                } catch (...) {
+                    mQueuedCharges.pop_back();
+                    mConflationSlots.erase(key);
+                    throw;
+                }
+                mQueuedBytes += charge.mBytes;
+            }
+        } else {
+            mQueuedCharges.push_back(charge);
+            try {
+                mMessageQueue->push(anEnvelope);
+            } catch (...) {
+                mQueuedCharges.pop_back();
+                throw;
+            }
+            mQueuedBytes += charge.mBytes;
+        }
+        queued = !full;
+        depth = mQueuedCharges.size();
+        depthBytes = mQueuedBytes;
     } catch (const impl::ShutdownException&) {
+        if (charge.mMemory) charge.mMemory->release(charge.mBytes);
         // if queue has been shutdown, if means this RemoteEndpoint
         // is closing : simply fail to deliver the message
         ARRAS_DEBUG("Message undelivered due to endpoint shutdown: " << anEnvelope.describe());
     }
+    if (replacedMemory) replacedMemory->release(replacedBytes);
+    if (queued) {
+        if (charge.mTraffic) charge.mTraffic->queued(depth, depthBytes);
+        queueChanged(depth, depthBytes, false);
+    }
+    if (full) {
+        if (charge.mMemory) charge.mMemory->release(charge.mBytes);
+        if (charge.mTraffic) charge.mTraffic->dropped();
+        if (mQueueFullPolicy == QueueFullPolicy::Disconnect) {
+            ARRAS_WARN(log::Id("endpointQueueFull") <<
+                       log::Session(mSessionId.toString()) <<
+                       "Disconnecting " << describe() << " : send queue is full");
+            flagForDestruction();
+        }
+    }
+}
+
+void
+RemoteEndpoint::setQueueLimit(size_t aMaxMessages, size_t aMaxBytes, QueueFullPolicy aPolicy)
+{
+    std::lock_guard<std::mutex> lock(mQueueMutex);
+    mMaxQueued = aMaxMessages;
+    mMaxQueuedBytes = aMaxBytes;
+    mQueueFullPolicy = aPolicy;
+}
+
+// true if a bounded queue has no room for another envelope of aBytes.
+// A single envelope larger than the byte limit is let into an empty queue
+bool
+RemoteEndpoint::queueFull_wlock(size_t aBytes) const
+{
+    if (mMaxQueued && mQueuedCharges.size() >= mMaxQueued)
+        return true;
+    return mMaxQueuedBytes && !mQueuedCharges.empty() &&
+        mQueuedBytes + aBytes > mMaxQueuedBytes;
 }
 
 void
@@ -584,64 +1007,22 @@ RemoteEndpoint::initStatsTime()
     mNextStatsTime = now.tv_sec + (hash & 0x1f);
 }
 
-void 
-RemoteEndpoint::sendStats(const impl::ExecutorHeartbeat::ConstPtr& aHeartbeat)
+bool
+RemoteEndpoint::statsDue(const impl::ExecutorHeartbeat::ConstPtr& aHeartbeat)
 { 
-    // send stats taken from the heartbeat message to the stats log,
-    // if it's time to do so
+    // stats taken from the heartbeat message are sent to the
+    // stats log if it's time to do so
     if ((aHeartbeat->mTransmitSecs < mNextStatsTime) ||
         (mNextStatsTime == 0)) {
-        return;
-    }
-
-    log::AthenaLogger* logger = dynamic_cast<log::AthenaLogger*>(&log::Logger::instance());
-    if (!logger) {
-        ARRAS_WARN(log::Id("warnNotAthena") <<
-                   "Default logger is not an AthenaLogger : cannot log stats");
-        mNextStatsTime = 0;
-        return;
+        return false;
     }
 
-    // format transmit time
-    time_t t = (time_t)aHeartbeat->mTransmitSecs;
-    tm* date = localtime(&t);
-    std::string transmitTime = boost::str(boost::format("%04d-%02d-%02dT%02d:%02d:%02d")
-                                          % (date->tm_year+1900) % date->tm_mon % date->tm_mday
-                                          % date->tm_hour % date->tm_min % date->tm_sec);
-
-    // send heartbeat stats out to the stats logger, and reset the next time
-    Object stats;
-
-    stats["type"] = "ArrasComputationStats/0.0";
-    stats["session"] = mSessionId.toString();
-    stats["computation"] = mUUID.toString();
-    stats["time"] = transmitTime;
-    stats["threads"] = aHeartbeat->mThreads;
-    stats["hyperthreaded"] = aHeartbeat->mHyperthreaded;
-    stats["CpuUsage5Sec"] = aHeartbeat->mCpuUsage5SecsCurrent;
-    stats["CpuUsage60Sec"] = aHeartbeat->mCpuUsage60SecsCurrent;
-    stats["CpuUsageTotal"] = aHeartbeat->mCpuUsageTotalSecs;
-    // jsoncpp needs us to specify int or long long... 
-    stats["SentMessages5Sec"] = (unsigned)aHeartbeat->mSentMessages5Sec;
-    stats["SentMessages60Sec"] = (unsigned)aHeartbeat->mSentMessages60Sec;
-    stats["SentMessagesTotal"] = (unsigned)aHeartbeat->mSentMessagesTotal;
-    stats["ReceivedMessages5Sec"] = (unsigned)aHeartbeat->mReceivedMessages5Sec;
-    stats["ReceivedMessages60Sec"] = (unsigned)aHeartbeat->mReceivedMessages60Sec;
-    stats["ReceivedMessagesTotal"] = (unsigned)aHeartbeat->mReceivedMessagesTotal;
-    stats["MemoryUsageBytes"] = (unsigned)aHeartbeat->mMemoryUsageBytesCurrent;
-    stats["Status"] = aHeartbeat->mStatus;
-    
-    std::string statsStr = api::objectToString(stats);
-    logger->logStats(statsStr);
-    ARRAS_DEBUG(log::Session(mSessionId.toString()) <<
-                "Sent stats to athena for computation " << mUUID.toString());
-  
     struct timeval now;
     gettimeofday(&now, nullptr);
     mNextStatsTime = now.tv_sec + SEND_STATS_INTERVAL_SECS;
+    return true;
 }
 
 } 
 }
 
-
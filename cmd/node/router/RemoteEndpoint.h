@@ -4,6 +4,7 @@
 #ifndef __ARRAS_REMOTEENDPOINT_H__
 #define __ARRAS_REMOTEENDPOINT_H__
 
+#include "HopTracer.h"
 #include "PeerManager.h"
 #include "ThreadedNodeRouter.h"
 
@@ -13,11 +14,14 @@
 #include <message_impl/Envelope.h>
 
 #include <condition_variable>
+#include <deque>
+#include <map>
 #include <shared_impl/MessageQueue.h>
 #include <core_messages/ExecutorHeartbeat.h>
 
 #include <mutex>
 #include <thread>
+#include <vector>
 
 #include <network/network_types.h>
 
@@ -93,6 +97,13 @@ namespace arras4 {
 
             void setPeer(network::Peer* aPeer);
 
+            // bound the send queue by message count and bytes (used for listener
+            // endpoints, so that a slow observer can't hold an unlimited amount of
+            // data). When the queue is full, new envelopes are dropped or the
+            // endpoint is disconnected. 0 means no limit
+            enum class QueueFullPolicy { Drop, Disconnect };
+            void setQueueLimit(size_t aMaxMessages, size_t aMaxBytes, QueueFullPolicy aPolicy);
+
             const api::UUID& sessionId() { return mSessionId; }
 
             // string description of the peer : e.g. "Computation(xxx)" or "Node(yyy)"
@@ -107,6 +118,14 @@ namespace arras4 {
             // (in normal cases, a message is already addressed, 
             // but not when it comes from the client)
             virtual void addressReceivedEnvelope() {}
+
+            // overridden by subclass (ClientRemoteEndpoint) to watch
+            // the send queue. Called after an envelope is queued
+            // (aSent = false) or taken for sending (aSent = true), with the
+            // number and size of envelopes remaining in the queue. This may
+            // route a message, so queueEnvelope must not be called with a
+            // PeerManager lock held
+            virtual void queueChanged(size_t /*aMessages*/, size_t /*aBytes*/, bool /*aSent*/) {}
             
             friend class ListenServer;
             // support for select() in ListenServer
@@ -117,6 +136,9 @@ namespace arras4 {
             // cache the most recent message received
             impl::Envelope mLastEnvelope;
 
+            // wall clock time mLastEnvelope was received, only set when hop tracing is on
+            unsigned long long mReceiveNs = 0;
+
             // host entry for NODE connections
             SessionNodeMap::NodeInfo mNodeInfo; // host info for node connection
 
@@ -132,8 +154,94 @@ namespace arras4 {
             std::thread mReceiveThread;
             std::thread mSendThread;
             std::unique_ptr<impl::MessageQueue> mMessageQueue;
+
+            // client endpoints can conflate messages of some classes (see
+            // SessionRoutingData::conflatesToClient). The latest unsent message for
+            // each class and source is held in a slot, and mMessageQueue holds a
+            // single placeholder for the slot : when the send thread reaches the
+            // placeholder it sends whatever the slot holds at that time.
+            typedef std::pair<api::ClassID, api::UUID> ConflationKey;
+            struct ConflationSlot {
+                impl::Envelope mEnvelope;
+                SessionMemory::Ptr mMemory;
+                size_t mBytes;
+            };
+
+            // memory charged for each envelope in mMessageQueue, in the same order.
+            // mQueueMutex keeps the two in step when several threads queue envelopes
+            struct QueuedCharge {
+                SessionMemory::Ptr mMemory; // null if not charged
+                size_t mBytes;
+                bool mConflated = false;    // envelope is a placeholder for a slot
+                ConflationKey mKey;
+                HopTracer::HopPtr mHop;     // set if the envelope is sampled for tracing
+                unsigned long long mEnqueueNs = 0;
+                SessionTraffic::Ptr mTraffic; // null if the session is unknown
+                std::chrono::steady_clock::time_point mQueuedAt;
+            };
+            std::mutex mQueueMutex;
+            std::deque<QueuedCharge> mQueuedCharges;
+            std::map<ConflationKey, ConflationSlot> mConflationSlots; // protected by mQueueMutex
+            unsigned long long mConflatedCount = 0;                   // protected by mQueueMutex
+            size_t mQueuedBytes = 0;                                  // protected by mQueueMutex
+            size_t mMaxQueued = 0;                                    // 0 = unbounded, protected by mQueueMutex
+            size_t mMaxQueuedBytes = 0;                               // 0 = unbounded, protected by mQueueMutex
+            QueueFullPolicy mQueueFullPolicy = QueueFullPolicy::Drop; // protected by mQueueMutex
+            unsigned long long mDroppedCount = 0;                     // protected by mQueueMutex
+            bool queueFull_wlock(size_t aBytes) const;
+            SessionRoutingData::Ptr sessionRoutingDataFor(const impl::Envelope& anEnvelope) const;
+            SessionRoutingData::Ptr cachedRoutingData(const api::UUID& aSessionId) const;
+
+            // routing data of the sessions seen by a node endpoint
+            mutable std::mutex mRoutingCacheMutex;
+            mutable std::map<api::UUID, SessionRoutingData::WeakPtr> mRoutingCache;
+
+            // called by the send thread after popping anEnvelope : releases its charge
+            // and, if it is a placeholder, replaces it with the slot's envelope.
+            // aHop and aEnqueueNs are set if the envelope is being traced
+            void takeQueuedEntry(impl::Envelope& anEnvelope,
+                                 HopTracer::HopPtr& aHop,
+                                 unsigned long long& aEnqueueNs);
            
             const PeerManager::PeerType mPeerType;
+
+            // how the endpoint handles what it receives, chosen by peer type when
+            // the endpoint is created. The few message classes the router handles
+            // itself are looked up in a small table of class ids : every other
+            // message goes straight to mRoute, with no further checks on peer type
+            typedef void (RemoteEndpoint::*ReceiveAction)();
+            struct ReceivePolicy {
+                struct Handler {
+                    api::ClassID mClassId;
+                    ReceiveAction mAction;
+                };
+                std::vector<Handler> mHandlers; // these classes are always deserialized
+                ReceiveAction mRoute;           // all other messages
+                ReceiveAction mOnDisconnect;    // may be null
+                const char* mName;              // for describe()
+                bool mDescribeId;               // describe() includes mUUID
+                bool mDeserializeAll;
+                bool mSharedBySessions;         // session is taken from each envelope's address
+                bool mCaptured;                 // included in traffic capture
+            };
+            static const ReceivePolicy& receivePolicy(PeerManager::PeerType aType);
+            const ReceivePolicy& mPolicy;
+            ReceiveAction mLastAction = nullptr; // for mLastEnvelope, set by receiveEnvelope()
+
+            // receive actions
+            void routeFromSession();
+            void routeFromNode();
+            void routeToSession(const SessionRoutingData::Ptr& aRoutingData);
+            void forwardToService();
+            void ignoreFromListener();
+            void ignoreMessage();
+            void handleClientControl();
+            void checkControl();
+            void handleHeartbeat();
+            void handleNodeProbe();
+            void notifyClientDropped();
+            void notifyServiceDropped();
+
             const api::UUID mUUID;
 
             // the send and receive threads can decide the RemoteEndpoint needs to
@@ -161,9 +269,10 @@ namespace arras4 {
             // should be sent (only applies to IPC connections)
             unsigned long long mNextStatsTime;
 
-            // send heartbeat stats to the stats logger
+            // decide when heartbeat stats should go to the stats logger.
+            // the logging itself is done by ThreadedNodeRouter's HeartbeatBatcher
             void initStatsTime();
-            void sendStats(const impl::ExecutorHeartbeat::ConstPtr& aHeartbeat);
+            bool statsDue(const impl::ExecutorHeartbeat::ConstPtr& aHeartbeat);
 
             // "traceInfo" is a string output in trace messages to indicate the 
             // identity of the sending and receiving processes: "C:<compid>","N:<nodeid>","client"
@@ -75,7 +75,16 @@ sendToLocalClient(const UUID& sessionId,
     } else {
         // if we are supposed to have the client, and we didn't find them, then
         // they have not connected yet and we should stash messages for them until they do connect
-        aThreadedNodeRouter.stashEnvelope(sessionId, envelope);
+        SessionRoutingData::Ptr routingData = aThreadedNodeRouter.sessionRoutingData(sessionId);
+        size_t stashed = aThreadedNodeRouter.stashEnvelope(sessionId, envelope,
+                                                           routingData ? routingData->memory() : SessionMemory::Ptr());
+        if (routingData) routingData->traffic()->stashed(stashed);
+    }
+
+    // each listener has its own bounded queue. The queued envelopes
+    // share the message content with the client's, rather than copying it
+    for (const RemoteEndpoint::Ptr& listener : aThreadedNodeRouter.getListeners(sessionId)) {
+        listener->queueEnvelope(envelope);
     }
 }
 
@@ -87,7 +96,7 @@ sendToLocalComputation(const UUID& sessionId,
                        const Envelope& envelope,
                        ThreadedNodeRouter& aThreadedNodeRouter)
 {
-    RemoteEndpoint::Ptr dest = aThreadedNodeRouter.findIpcPeer(computationId);     
+    RemoteEndpoint::Ptr dest = aThreadedNodeRouter.findIpcPeer(sessionId, computationId);     
     if (dest) {
         dest->queueEnvelope(envelope);
     }    
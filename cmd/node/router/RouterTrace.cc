@@ -0,0 +1,367 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "RouterTrace.h"
+
+#include <arras4_log/Logger.h>
+#include <arras4_log/LogEventStream.h>
+#include <message_impl/OpaqueContent.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// trace files are grown in steps of this size
+constexpr size_t TRACE_GROW_SIZE = 16 * 1024 * 1024;
+
+// recording stops (with a warning) when a trace reaches this size
+constexpr size_t TRACE_MAX_SIZE = 4ull * 1024 * 1024 * 1024;
+
+inline size_t pad8(size_t n) { return (n + 7) & ~size_t(7); }
+
+std::string errnoString()
+{
+    return std::string(strerror(errno));
+}
+
+void putUUID(char* aDest, const arras4::api::UUID& aId)
+{
+    memset(aDest, 0, arras4::node::TRACE_UUID_SIZE);
+    if (!aId.isNull()) {
+        std::string s = aId.toString();
+        memcpy(aDest, s.data(), std::min(s.size(), arras4::node::TRACE_UUID_SIZE));
+    }
+}
+
+arras4::api::UUID getUUID(const char* aSource)
+{
+    size_t len = strnlen(aSource, arras4::node::TRACE_UUID_SIZE);
+    if (len == 0)
+        return arras4::api::UUID();
+    return arras4::api::UUID(std::string(aSource, len));
+}
+
+}
+
+namespace arras4 {
+namespace node {
+
+TraceWriter::TraceWriter(const std::string& aPath,
+                         const api::UUID& aSessionId,
+                         const api::UUID& aNodeId,
+                         const std::string& aRouting,
+                         bool aCapturePayloads) :
+    mPath(aPath),
+    mCapturePayloads(aCapturePayloads),
+    mStart(std::chrono::steady_clock::now())
+{
+    mFd = open(aPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (mFd < 0) {
+        throw std::runtime_error("Cannot create trace file " + aPath + ": " + errnoString());
+    }
+
+    // map the largest size the trace can reach up front, so that the mapping
+    // never has to move under concurrent writers. Only the part covered by
+    // the file (mFileSize) is ever touched
+    void* base = mmap(nullptr, TRACE_MAX_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+    if (base == MAP_FAILED) {
+        std::string err = errnoString();
+        close(mFd);
+        throw std::runtime_error("Cannot map trace file " + aPath + ": " + err);
+    }
+    mBase = static_cast<char*>(base);
+
+    size_t headerSize = pad8(sizeof(TraceFileHeader) + aRouting.size());
+    if (!extend(0, headerSize)) {
+        munmap(mBase, TRACE_MAX_SIZE);
+        close(mFd);
+        throw std::runtime_error("Cannot extend trace file " + aPath);
+    }
+
+    TraceFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.mMagic, TRACE_MAGIC, sizeof(header.mMagic));
+    header.mVersion = TRACE_VERSION;
+    header.mRoutingSize = static_cast<uint32_t>(aRouting.size());
+    putUUID(header.mSessionId, aSessionId);
+    putUUID(header.mNodeId, aNodeId);
+    header.mStartTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    memcpy(mBase, &header, sizeof(header));
+    memcpy(mBase + sizeof(header), aRouting.data(), aRouting.size());
+    mUsed = headerSize;
+}
+
+TraceWriter::~TraceWriter()
+{
+    if (mBase) {
+        munmap(mBase, TRACE_MAX_SIZE);
+    }
+    if (mFd >= 0) {
+        // drop the unused space left by the last extension, and
+        // anything after a record that couldn't be written
+        size_t end = std::min(std::min(mUsed.load(), mFileSize.load()), mDataEnd);
+        if (ftruncate(mFd, end) != 0) {
+            ARRAS_WARN(log::Id("traceTruncateFailed") <<
+                       "Failed to truncate trace file " << mPath << ": " << errnoString());
+        }
+        close(mFd);
+    }
+}
+
+bool
+TraceWriter::extend(size_t anOffset, size_t anEnd)
+{
+    if (anEnd <= mFileSize.load(std::memory_order_acquire))
+        return true;
+
+    std::lock_guard<std::mutex> lock(mExtendMutex);
+    if (!mFull) {
+        size_t newSize = mFileSize.load(std::memory_order_relaxed);
+        if (anEnd <= newSize)
+            return true;
+        while (newSize < anEnd)
+            newSize += TRACE_GROW_SIZE;
+        if (newSize <= TRACE_MAX_SIZE && ftruncate(mFd, newSize) == 0) {
+            mFileSize.store(newSize, std::memory_order_release);
+            return true;
+        }
+        ARRAS_WARN(log::Id("traceFull") <<
+                   "Trace file " << mPath << " cannot be extended : capture stopped after " <<
+                   mRecordCount << " messages");
+        mFull = true;
+    }
+    // records reserved after this one may also fail, but none before it
+    // can : the file ends at the earliest failure
+    mDataEnd = std::min(mDataEnd, anOffset);
+    return false;
+}
+
+void
+TraceWriter::record(uint8_t aPeerType,
+                    const api::UUID& aSourceId,
+                    const impl::Envelope& anEnvelope)
+{
+    if (mFull.load(std::memory_order_relaxed))
+        return;
+
+    TraceRecordHeader header;
+    memset(&header, 0, sizeof(header));
+    header.mPeerType = aPeerType;
+    header.mTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - mStart).count();
+    putUUID(header.mClassId, anEnvelope.classId());
+    putUUID(header.mSourceId, aSourceId);
+
+    // routed messages are read as OpaqueContent, so their size (and
+    // content) is available without deserializing them
+    std::shared_ptr<const impl::OpaqueContent> opaque = anEnvelope.contentAs<impl::OpaqueContent>();
+    if (opaque) {
+        header.mFlags |= TRACE_ROUTED;
+        header.mClassVersion = opaque->classVersion();
+        header.mContentSize = opaque->dataSize();
+        if (mCapturePayloads) {
+            header.mFlags |= TRACE_HAS_PAYLOAD;
+            header.mPayloadSize = opaque->dataSize();
+        }
+    }
+
+    const api::AddressList& to = anEnvelope.to();
+    size_t toCount = std::min(to.size(), size_t(UINT16_MAX));
+    header.mToCount = static_cast<uint16_t>(toCount);
+
+    std::string name;
+    if (anEnvelope.metadata()) {
+        name = anEnvelope.metadata()->routingName();
+    }
+    header.mNameSize = static_cast<uint32_t>(name.size());
+
+    size_t recordSize = pad8(sizeof(header) + toCount * sizeof(TraceAddress) +
+                             name.size() + header.mPayloadSize);
+    header.mRecordSize = recordSize;
+
+    size_t offset = mUsed.fetch_add(recordSize);
+    if (!extend(offset, offset + recordSize))
+        return;
+
+    char* dest = mBase + offset;
+    memcpy(dest, &header, sizeof(header));
+    dest += sizeof(header);
+    for (size_t i = 0; i < toCount; i++) {
+        TraceAddress* addr = reinterpret_cast<TraceAddress*>(dest);
+        putUUID(addr->mSession, to[i].session);
+        putUUID(addr->mNode, to[i].node);
+        putUUID(addr->mComputation, to[i].computation);
+        dest += sizeof(TraceAddress);
+    }
+    memcpy(dest, name.data(), name.size());
+    dest += name.size();
+    if (header.mPayloadSize) {
+        memcpy(dest, opaque->data(), header.mPayloadSize);
+    }
+    mRecordCount++;
+}
+
+TraceReader::TraceReader(const std::string& aPath)
+{
+    mFd = open(aPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (mFd < 0) {
+        throw std::runtime_error("Cannot open trace file " + aPath + ": " + errnoString());
+    }
+    struct stat st;
+    if (fstat(mFd, &st) != 0 ||
+        static_cast<size_t>(st.st_size) < sizeof(TraceFileHeader)) {
+        close(mFd);
+        throw std::runtime_error("Trace file " + aPath + " is too short");
+    }
+    mSize = st.st_size;
+    void* base = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, mFd, 0);
+    if (base == MAP_FAILED) {
+        close(mFd);
+        throw std::runtime_error("Cannot map trace file " + aPath + ": " + errnoString());
+    }
+    mBase = static_cast<const char*>(base);
+    mHeader = reinterpret_cast<const TraceFileHeader*>(mBase);
+    if (memcmp(mHeader->mMagic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 ||
+        mHeader->mVersion != TRACE_VERSION ||
+        sizeof(TraceFileHeader) + mHeader->mRoutingSize > mSize) {
+        munmap(const_cast<char*>(mBase), mSize);
+        close(mFd);
+        throw std::runtime_error("File " + aPath + " is not a valid router trace");
+    }
+    mFirstRecord = pad8(sizeof(TraceFileHeader) + mHeader->mRoutingSize);
+    mPosition = mFirstRecord;
+}
+
+TraceReader::~TraceReader()
+{
+    munmap(const_cast<char*>(mBase), mSize);
+    close(mFd);
+}
+
+api::UUID
+TraceReader::sessionId() const
+{
+    return getUUID(mHeader->mSessionId);
+}
+
+api::UUID
+TraceReader::nodeId() const
+{
+    return getUUID(mHeader->mNodeId);
+}
+
+std::string
+TraceReader::routing() const
+{
+    return std::string(mBase + sizeof(TraceFileHeader), mHeader->mRoutingSize);
+}
+
+bool
+TraceReader::next(Record& aRecord)
+{
+    if (mPosition + sizeof(TraceRecordHeader) > mSize)
+        return false;
+    const TraceRecordHeader* header = reinterpret_cast<const TraceRecordHeader*>(mBase + mPosition);
+    // a zero size means we've reached space that was never written
+    // (e.g. the router didn't shut down cleanly)
+    if (header->mRecordSize == 0 || mPosition + header->mRecordSize > mSize)
+        return false;
+
+    const char* p = mBase + mPosition + sizeof(TraceRecordHeader);
+    aRecord.mHeader = header;
+    aRecord.mClassId = getUUID(header->mClassId);
+    aRecord.mSourceId = getUUID(header->mSourceId);
+    aRecord.mTo.clear();
+    for (unsigned i = 0; i < header->mToCount; i++) {
+        const TraceAddress* addr = reinterpret_cast<const TraceAddress*>(p);
+        api::Address to;
+        to.session = getUUID(addr->mSession);
+        to.node = getUUID(addr->mNode);
+        to.computation = getUUID(addr->mComputation);
+        aRecord.mTo.push_back(to);
+        p += sizeof(TraceAddress);
+    }
+    aRecord.mName.assign(p, header->mNameSize);
+    p += header->mNameSize;
+    aRecord.mPayload = (header->mFlags & TRACE_HAS_PAYLOAD) ? p : nullptr;
+
+    mPosition += header->mRecordSize;
+    return true;
+}
+
+void
+TraceReader::rewind()
+{
+    mPosition = mFirstRecord;
+}
+
+void
+RouterCapture::startSession(const api::UUID& aSessionId, const std::string& aRouting)
+{
+    if (!enabled())
+        return;
+    std::string path = mDirectory + "/router-" + aSessionId.toString() + ".trace";
+    try {
+        TraceWriter::Ptr writer = std::make_shared<TraceWriter>(path, aSessionId, mNodeId,
+                                                                aRouting, mCapturePayloads);
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::shared_ptr<WriterMap> writers = std::make_shared<WriterMap>(*mWriters);
+        (*writers)[aSessionId] = writer;
+        std::atomic_store(&mWriters, std::shared_ptr<const WriterMap>(writers));
+    } catch (const std::exception& e) {
+        ARRAS_ERROR(log::Id("traceStartFailed") <<
+                    log::Session(aSessionId.toString()) <<
+                    "Traffic capture not started : " << e.what());
+        return;
+    }
+    ARRAS_INFO(log::Session(aSessionId.toString()) <<
+               "Capturing router traffic to " << path);
+}
+
+void
+RouterCapture::endSession(const api::UUID& aSessionId)
+{
+    if (!enabled())
+        return;
+    TraceWriter::Ptr writer;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mWriters->find(aSessionId);
+        if (it == mWriters->end())
+            return;
+        writer = it->second;
+        std::shared_ptr<WriterMap> writers = std::make_shared<WriterMap>(*mWriters);
+        writers->erase(aSessionId);
+        std::atomic_store(&mWriters, std::shared_ptr<const WriterMap>(writers));
+    }
+    ARRAS_INFO(log::Session(aSessionId.toString()) <<
+               "Captured " << writer->recordCount() << " messages to " << writer->path());
+    // file is closed when the last endpoint using the writer releases it
+}
+
+void
+RouterCapture::record(const api::UUID& aSessionId,
+                      uint8_t aPeerType,
+                      const api::UUID& aSourceId,
+                      const impl::Envelope& anEnvelope)
+{
+    // the snapshot keeps the writer alive until the record is complete
+    std::shared_ptr<const WriterMap> writers = std::atomic_load(&mWriters);
+    auto it = writers->find(aSessionId);
+    if (it == writers->end())
+        return;
+    it->second->record(aPeerType, aSourceId, anEnvelope);
+}
+
+}
+}
@@ -0,0 +1,194 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __ARRAS_ROUTERTRACE_H__
+#define __ARRAS_ROUTERTRACE_H__
+
+#include <message_api/messageapi_types.h>
+#include <message_api/UUID.h>
+#include <message_impl/Envelope.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Router traffic capture. When enabled (arras4_router --captureDir) every
+// message received by a router endpoint is recorded to a per-session trace
+// file "<captureDir>/router-<sessionId>.trace", which can be played back
+// against a router with arras4_router_replay.
+//
+// A trace file is a TraceFileHeader, followed by the routing data
+// JSON of the session, followed by a sequence of records. Each record is
+// a TraceRecordHeader, mToCount TraceAddress, the routing name
+// of the message and (if TRACE_HAS_PAYLOAD is set) the serialized message
+// content. Records are padded to a multiple of 8 bytes. UUIDs are stored
+// in string form, so the file doesn't depend on the layout of api::UUID.
+//
+// Files are written through a shared memory mapping. Each record reserves
+// its space with an atomic add, so endpoints recording the same session
+// copy into the mapping concurrently : a lock is only taken when the file
+// has to be extended.
+
+namespace arras4 {
+namespace node {
+
+constexpr char TRACE_MAGIC[8] = { 'A','R','R','T','R','A','C','E' };
+constexpr uint32_t TRACE_VERSION = 2;
+
+// record flags
+constexpr uint8_t TRACE_ROUTED = 0x1;       // message was routed (not control/heartbeat)
+constexpr uint8_t TRACE_HAS_PAYLOAD = 0x2;  // record includes message content
+
+// UUID in string form, zero padded. All zeros is a null UUID
+constexpr size_t TRACE_UUID_SIZE = 36;
+typedef char TraceUUID[TRACE_UUID_SIZE];
+
+struct TraceFileHeader {
+    char mMagic[8];
+    uint32_t mVersion;
+    uint32_t mRoutingSize;   // bytes of routing JSON following the header
+    TraceUUID mSessionId;
+    TraceUUID mNodeId;       // node that made the capture
+    uint64_t mStartTime;     // wall clock at start of capture, ns since epoch
+};
+
+struct TraceRecordHeader {
+    uint64_t mRecordSize;    // total size, including header and padding
+    uint64_t mTime;          // ns since start of capture
+    uint64_t mContentSize;   // serialized content size (0 if unknown)
+    uint64_t mPayloadSize;   // bytes of content recorded (0 unless TRACE_HAS_PAYLOAD)
+    uint32_t mNameSize;      // length of routing name
+    uint32_t mClassVersion;
+    uint16_t mToCount;       // number of TraceAddress following the header
+    uint8_t mPeerType;       // PeerManager::PeerType of receiving endpoint
+    uint8_t mFlags;
+    TraceUUID mClassId;
+    TraceUUID mSourceId;     // id of the endpoint that received the message
+};
+
+// a destination api::Address
+struct TraceAddress {
+    TraceUUID mSession;
+    TraceUUID mNode;
+    TraceUUID mComputation;
+};
+
+// writes the trace file for a single session. thread safe
+class TraceWriter
+{
+public:
+    typedef std::shared_ptr<TraceWriter> Ptr;
+
+    // throws std::runtime_error if the file cannot be created
+    TraceWriter(const std::string& aPath,
+                const api::UUID& aSessionId,
+                const api::UUID& aNodeId,
+                const std::string& aRouting,
+                bool aCapturePayloads);
+    ~TraceWriter();
+
+    void record(uint8_t aPeerType,
+                const api::UUID& aSourceId,
+                const impl::Envelope& anEnvelope);
+
+    const std::string& path() const { return mPath; }
+    size_t recordCount() const { return mRecordCount; }
+
+private:
+    // make sure the file covers [anOffset, anEnd), extending it if
+    // necessary. Returns false once the trace is full
+    bool extend(size_t anOffset, size_t anEnd);
+
+    const std::string mPath;
+    const bool mCapturePayloads;
+    const std::chrono::steady_clock::time_point mStart;
+    int mFd = -1;
+    char* mBase = nullptr;               // maps the maximum trace size, so never moves
+    std::atomic<size_t> mUsed{0};        // bytes reserved by records
+    std::atomic<size_t> mFileSize{0};
+    std::atomic<size_t> mRecordCount{0};
+    std::atomic<bool> mFull{false};
+
+    std::mutex mExtendMutex;
+    size_t mDataEnd = SIZE_MAX;          // first record that couldn't be written
+};
+
+// reads a trace file, mapping it into memory
+class TraceReader
+{
+public:
+    // throws std::runtime_error if the file cannot be read or is invalid
+    TraceReader(const std::string& aPath);
+    ~TraceReader();
+
+    const TraceFileHeader& header() const { return *mHeader; }
+    api::UUID sessionId() const;
+    api::UUID nodeId() const;
+    std::string routing() const;
+
+    struct Record {
+        const TraceRecordHeader* mHeader = nullptr;
+        api::ClassID mClassId;
+        api::UUID mSourceId;
+        std::vector<api::Address> mTo;
+        std::string mName;
+        const char* mPayload = nullptr;
+    };
+
+    // read the next record, returning false at the end of the file
+    bool next(Record& aRecord);
+    void rewind();
+
+private:
+    int mFd = -1;
+    const char* mBase = nullptr;
+    size_t mSize = 0;
+    size_t mFirstRecord = 0;
+    size_t mPosition = 0;
+    const TraceFileHeader* mHeader = nullptr;
+};
+
+// owns the trace writers for all sessions being captured
+class RouterCapture
+{
+public:
+    RouterCapture(const api::UUID& aNodeId) : mNodeId(aNodeId) {}
+
+    // set before the router starts. an empty directory disables capture
+    void setDirectory(const std::string& aDirectory, bool aCapturePayloads) {
+        mDirectory = aDirectory;
+        mCapturePayloads = aCapturePayloads;
+    }
+    bool enabled() const { return !mDirectory.empty(); }
+
+    void startSession(const api::UUID& aSessionId, const std::string& aRouting);
+    void endSession(const api::UUID& aSessionId);
+
+    // messages for sessions that are not being captured are ignored
+    void record(const api::UUID& aSessionId,
+                uint8_t aPeerType,
+                const api::UUID& aSourceId,
+                const impl::Envelope& anEnvelope);
+
+private:
+    typedef std::map<api::UUID, TraceWriter::Ptr> WriterMap;
+
+    const api::UUID mNodeId;
+    std::string mDirectory;
+    bool mCapturePayloads = false;
+
+    // start and end replace the map, so that record can look up the
+    // writer from a snapshot without taking a lock
+    std::mutex mMutex;
+    std::shared_ptr<const WriterMap> mWriters{std::make_shared<WriterMap>()};
+};
+
+}
+}
+
+#endif // __ARRAS_ROUTERTRACE_H__
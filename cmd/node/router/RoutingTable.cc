@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "RoutingTable.h"
+#include "PeerManager.h"
 #include <arras4_log/Logger.h>
 #include <arras4_log/LogEventStream.h>
 
@@ -13,7 +14,7 @@ namespace node {
 
 RoutingTable::RoutingTable()
 {
-
+    setShardCount(1);
 }
 
 RoutingTable::~RoutingTable()
@@ -21,15 +22,32 @@ RoutingTable::~RoutingTable()
 
 }
 
+void
+RoutingTable::setShardCount(size_t aCount)
+{
+    if (aCount == 0) aCount = 1;
+    mShards.clear();
+    for (size_t i = 0; i < aCount; i++) {
+        mShards.emplace_back(new Shard);
+    }
+}
+
+RoutingTable::Shard&
+RoutingTable::shardFor(const api::UUID& aSessionId) const
+{
+    return *mShards[sessionShard(aSessionId, mShards.size())];
+}
+
 SessionRoutingData::Ptr
 RoutingTable::sessionRoutingData(const api::UUID& aSessionId)
 const
 {
-    AUTO_LOCK(mMutex);
-    const auto it = mRoutingDataWeak.find(aSessionId);
+    const Shard& shard = shardFor(aSessionId);
+    AUTO_LOCK(shard.mMutex);
+    const auto it = shard.mRoutingDataWeak.find(aSessionId);
 
     // does the entry exist all
-    if (it == mRoutingDataWeak.end()) return SessionRoutingData::Ptr();
+    if (it == shard.mRoutingDataWeak.end()) return SessionRoutingData::Ptr();
 
     // lock() will return a default constructed SessionRoutingData::Ptr
     // if the object expired
@@ -45,9 +63,10 @@ void
 RoutingTable::addSessionRoutingData(const api::UUID& aSessionId, 
                                     SessionRoutingData::Ptr data)
 {
-    AUTO_LOCK(mMutex); 
-    mRoutingDataWeak.insert(RouteTableWeak::value_type(aSessionId,data));
-    mRoutingData.insert(RouteTable::value_type(aSessionId,data));
+    Shard& shard = shardFor(aSessionId);
+    AUTO_LOCK(shard.mMutex); 
+    shard.mRoutingDataWeak.insert(RouteTableWeak::value_type(aSessionId,data));
+    shard.mRoutingData.insert(RouteTable::value_type(aSessionId,data));
 }
 
 //
@@ -56,8 +75,9 @@ RoutingTable::addSessionRoutingData(const api::UUID& aSessionId,
 void
 RoutingTable::releaseSessionRoutingData(const api::UUID& aSessionId)
 {
-    AUTO_LOCK(mMutex);
-    mRoutingData.erase(aSessionId);
+    Shard& shard = shardFor(aSessionId);
+    AUTO_LOCK(shard.mMutex);
+    shard.mRoutingData.erase(aSessionId);
 }
 
 //
@@ -66,20 +86,24 @@ RoutingTable::releaseSessionRoutingData(const api::UUID& aSessionId)
 void
 RoutingTable::deleteSessionRoutingData(const api::UUID& aSessionId)
 {
-    AUTO_LOCK(mMutex);
+    Shard& shard = shardFor(aSessionId);
+    AUTO_LOCK(shard.mMutex);
 
     // remove it from the shared table
-    mRoutingData.erase(aSessionId);
+    shard.mRoutingData.erase(aSessionId);
 
     // remove it from the 
-    const auto it = mRoutingDataWeak.find(aSessionId);
-    if (it != mRoutingDataWeak.end()) {
-        if (!it->second.expired()) {
+    const auto it = shard.mRoutingDataWeak.find(aSessionId);
+    if (it != shard.mRoutingDataWeak.end()) {
+        SessionRoutingData::Ptr data = it->second.lock();
+        if (data) {
             ARRAS_WARN(log::Id("routingDataInUse") <<
                        log::Session(aSessionId.toString()) <<
                        "delete of SessionRoutingData when pointer still in use");
+            // endpoints that have cached it stop using it
+            data->markRemoved();
         }
-        mRoutingDataWeak.erase(it);
+        shard.mRoutingDataWeak.erase(it);
     }
 }
 
@@ -89,11 +113,14 @@ RoutingTable::deleteSessionRoutingData(const api::UUID& aSessionId)
 bool
 RoutingTable::findNodeInfo(const api::UUID& aNodeId, /*out*/SessionNodeMap::NodeInfo& info) const
 {
-    AUTO_LOCK(mMutex); 
-    for (auto iter: mRoutingDataWeak) {
-        SessionRoutingData::Ptr data = iter.second.lock();
-        if (data != nullptr) {
-            if (data->nodeMap().findNodeInfo(aNodeId, info)) return true;
+    // only used when a node connects, so searching every shard is fine
+    for (const auto& shard : mShards) {
+        AUTO_LOCK(shard->mMutex); 
+        for (auto iter: shard->mRoutingDataWeak) {
+            SessionRoutingData::Ptr data = iter.second.lock();
+            if (data != nullptr) {
+                if (data->nodeMap().findNodeInfo(aNodeId, info)) return true;
+            }
         }
     }
     return false;
@@ -9,7 +9,9 @@
 
 #include <message_api/messageapi_types.h>
 
+#include <memory>
 #include <mutex>
+#include <vector>
 
 #define AUTO_LOCK(m) std::lock_guard<std::mutex> __LOCK(m)
 #define AUTO_RLOCK(rm) std::lock_guard<std::recursive_mutex> __LOCK(rm)
@@ -29,6 +31,9 @@
 // a node. The code assumes the sessions are consistent, and can look up
 // node info for a given node id by using the first session it finds that
 // uses that node
+//
+// Like PeerManager, the table is divided into shards by session id, each
+// with its own lock (see setShardCount)
 
 namespace arras4 {
     namespace node {
@@ -40,6 +45,9 @@ namespace arras4 {
             RoutingTable();
             ~RoutingTable();
 
+            // must be called before any sessions are added. The default is one shard
+            void setShardCount(size_t aCount);
+
             SessionRoutingData::Ptr sessionRoutingData(const api::UUID& aSessionId) const;
             void addSessionRoutingData(const api::UUID& aSessionId,
                                        SessionRoutingData::Ptr data);
@@ -52,11 +60,15 @@ namespace arras4 {
         private:
             typedef std::map<api::UUID /* session ID */, SessionRoutingData::WeakPtr> RouteTableWeak;
             typedef std::map<api::UUID /* session ID */, SessionRoutingData::Ptr> RouteTable;
-            RouteTableWeak mRoutingDataWeak;
-            RouteTable mRoutingData;
+            struct Shard {
+                RouteTableWeak mRoutingDataWeak;
+                RouteTable mRoutingData;
 
-            // thread-safety
-            mutable std::mutex mMutex;
+                // thread-safety
+                mutable std::mutex mMutex;
+            };
+            std::vector<std::unique_ptr<Shard> > mShards;
+            Shard& shardFor(const api::UUID& aSessionId) const;
         };
 
 } 
@@ -0,0 +1,165 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "SessionMemory.h"
+#include "MappedPayload.h"
+
+#include <arras4_log/Logger.h>
+#include <arras4_log/LogEventStream.h>
+#include <message_impl/OpaqueContent.h>
+
+namespace {
+
+// sessions using the "throttle" policy are failed if they reach this multiple
+// of their limit, since messages from other nodes are not throttled
+constexpr size_t THROTTLE_HARD_LIMIT_FACTOR = 2;
+
+// nominal size charged for messages that have been deserialized
+// (control messages, heartbeats and the like are small)
+constexpr size_t DESERIALIZED_MESSAGE_SIZE = 256;
+
+}
+
+namespace arras4 {
+namespace node {
+
+SessionMemory::SessionMemory(const api::UUID& aSessionId,
+                             api::ObjectConstRef aSessionRouting) :
+    mSessionId(aSessionId),
+    mBytes(0),
+    mPeakBytes(0),
+    mMaxBytes(0),
+    mPolicy(Policy::Throttle),
+    mFailed(false)
+{
+    update(aSessionRouting);
+}
+
+void
+SessionMemory::update(api::ObjectConstRef aSessionRouting)
+{
+    // anything left out of the new routing data goes back to the
+    // default : no limit, "throttle"
+    api::ObjectConstRef limit = aSessionRouting["memoryLimit"];
+    if (limit.isObject() && limit["maxBytes"].isIntegral())
+        mMaxBytes = static_cast<size_t>(limit["maxBytes"].asUInt64());
+    else
+        mMaxBytes = 0;
+    mPolicy = Policy::Throttle;
+    if (limit.isObject() && limit["policy"].isString()) {
+        std::string policy = limit["policy"].asString();
+        if (policy == "fail") {
+            mPolicy = Policy::Fail;
+        } else if (policy == "throttle") {
+            mPolicy = Policy::Throttle;
+        } else {
+            ARRAS_WARN(log::Id("badMemoryPolicy") <<
+                       log::Session(mSessionId.toString()) <<
+                       "Unknown memoryLimit policy '" << policy << "': using 'throttle'");
+            mPolicy = Policy::Throttle;
+        }
+    }
+    ARRAS_DEBUG(log::Session(mSessionId.toString()) <<
+                "Router memory limit for session is " << mMaxBytes << " bytes, policy " <<
+                (mPolicy == Policy::Fail ? "fail" : "throttle"));
+    // the limit may have been raised or removed : wake throttled producers
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCondition.notify_all();
+}
+
+void
+SessionMemory::setFailureHandler(const FailureHandler& handler)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mFailureHandler = handler;
+}
+
+/* static */ size_t
+SessionMemory::envelopeSize(const impl::Envelope& anEnvelope)
+{
+    // routed messages are normally left in serialized form
+    std::shared_ptr<const impl::OpaqueContent> opaque = anEnvelope.contentAs<impl::OpaqueContent>();
+    if (opaque)
+        return opaque->dataSize();
+    // large payloads may have been moved to a file mapping, but still count
+    std::shared_ptr<const MappedContent> mapped = anEnvelope.contentAs<MappedContent>();
+    if (mapped)
+        return mapped->dataSize();
+    return DESERIALIZED_MESSAGE_SIZE;
+}
+
+bool
+SessionMemory::charge(size_t bytes)
+{
+    if (mFailed)
+        return false;
+
+    size_t total = (mBytes += bytes);
+    size_t peak = mPeakBytes;
+    while (total > peak && !mPeakBytes.compare_exchange_weak(peak, total)) {}
+
+    size_t maxBytes = mMaxBytes;
+    if (maxBytes == 0 || total <= maxBytes)
+        return true;
+
+    if (mPolicy == Policy::Fail ||
+        total > maxBytes * THROTTLE_HARD_LIMIT_FACTOR) {
+        mBytes -= bytes;
+        fail(total);
+        return false;
+    }
+    return true;
+}
+
+void
+SessionMemory::release(size_t bytes)
+{
+    size_t total = (mBytes -= bytes);
+    size_t maxBytes = mMaxBytes;
+    if (maxBytes != 0 && total <= maxBytes && total + bytes > maxBytes) {
+        // just dropped back under the limit : wake throttled producers
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCondition.notify_all();
+    }
+}
+
+bool
+SessionMemory::shouldThrottle() const
+{
+    size_t maxBytes = mMaxBytes;
+    return (mPolicy == Policy::Throttle) && 
+        (maxBytes != 0) && (mBytes > maxBytes) && !mFailed;
+}
+
+bool
+SessionMemory::waitForSpace(const std::chrono::milliseconds& timeout)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    return mCondition.wait_for(lock, timeout, [this] { return !shouldThrottle(); });
+}
+
+void
+SessionMemory::fail(size_t total)
+{
+    bool expected = false;
+    if (!mFailed.compare_exchange_strong(expected, true))
+        return; // already failed
+ 
+    std::string reason = "Router memory limit exceeded: session buffered " +
+        std::to_string(total) + " bytes, limit is " + std::to_string(mMaxBytes.load()) + " bytes";
+    ARRAS_ERROR(log::Id("sessionMemoryLimit") <<
+                log::Session(mSessionId.toString()) << reason);
+
+    FailureHandler handler;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        handler = mFailureHandler;
+        mCondition.notify_all();
+    }
+    if (handler)
+        handler(mSessionId, reason);
+}
+
+}
+}
+
@@ -0,0 +1,102 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __ARRAS_SESSIONMEMORY_H__
+#define __ARRAS_SESSIONMEMORY_H__
+
+#include <message_api/messageapi_types.h>
+#include <message_api/Object.h>
+#include <message_impl/Envelope.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+/** SessionMemory accounts for the message data that the router is
+ *  holding on behalf of a session : envelopes in endpoint send queues
+ *  and envelopes stashed for a client that hasn't connected yet. Each
+ *  envelope is charged once, when it is queued or stashed : an envelope
+ *  whose payload is shared by several queues is counted once per queue.
+ *
+ *  The limit and policy are read from the session routing data :
+ *
+ *     "<sessionId>": { ...
+ *          "memoryLimit": { "maxBytes": <int>, "policy": "throttle" | "fail" }
+ *     }
+ *
+ *  With no limit (or maxBytes 0) only accounting is done. Routing data
+ *  updates that leave out "memoryLimit" remove the limit.
+ *
+ *  "throttle" stops the receive threads of the session's client and 
+ *  computation endpoints from reading more messages until the total drops
+ *  back under the limit. Messages arriving from other nodes can't be
+ *  throttled without blocking other sessions, so if the total keeps growing
+ *  to THROTTLE_HARD_LIMIT_FACTOR times the limit the session is failed anyway.
+ *
+ *  "fail" drops the message that exceeds the limit, and all subsequent 
+ *  messages for the session, and calls the failure handler so that
+ *  Coordinator can be told to delete the session.
+**/
+
+namespace arras4 {
+    namespace node {
+
+        class SessionMemory
+        {
+        public:
+            enum class Policy { Throttle, Fail };
+
+            typedef std::shared_ptr<SessionMemory> Ptr;
+            typedef std::function<void(const api::UUID& sessionId, const std::string& reason)> FailureHandler;
+
+            SessionMemory(const api::UUID& aSessionId, api::ObjectConstRef aSessionRouting);
+
+            // update limit and policy from new session routing data
+            void update(api::ObjectConstRef aSessionRouting);
+
+            // called (once) when a session is failed for exceeding its limit
+            void setFailureHandler(const FailureHandler& handler);
+
+            // estimate of the memory held by an envelope
+            static size_t envelopeSize(const impl::Envelope& anEnvelope);
+
+            // charge bytes to the session. returns false if the
+            // message should be dropped because the session has failed
+            bool charge(size_t bytes);
+            void release(size_t bytes);
+
+            // true if producers for this session should stop reading
+            bool shouldThrottle() const;
+            // wait up to timeout for the session to drop below its limit.
+            // returns true if producers may continue
+            bool waitForSpace(const std::chrono::milliseconds& timeout);
+
+            bool hasFailed() const { return mFailed; }
+            size_t bytes() const { return mBytes; }
+            size_t peakBytes() const { return mPeakBytes; }
+            size_t maxBytes() const { return mMaxBytes; }
+            Policy policy() const { return mPolicy; }
+
+        private:
+            void fail(size_t total);
+
+            const api::UUID mSessionId;
+            std::atomic<size_t> mBytes;
+            std::atomic<size_t> mPeakBytes;
+            std::atomic<size_t> mMaxBytes;
+            std::atomic<Policy> mPolicy;
+            std::atomic<bool> mFailed;
+
+            std::mutex mMutex;
+            std::condition_variable mCondition;
+            FailureHandler mFailureHandler; // protected by mMutex
+        };
+
+    } 
+} 
+
+#endif // __ARRAS_SESSIONMEMORY_H__
+
@@ -4,9 +4,22 @@
 #include "SessionRoutingData.h"
 #include "SessionNodeMap.h"
 
+#include <arras4_log/Logger.h>
+#include <arras4_log/LogEventStream.h>
+#include <core_messages/ControlMessage.h>
+#include <core_messages/SessionStatusMessage.h>
+#include <message_impl/Envelope.h>
 #include <routing/ComputationMap.h>
 #include <routing/Addresser.h>
 
+namespace {
+
+// default bound on each listener's send queue
+constexpr size_t DEFAULT_LISTENER_MAX_QUEUED = 1000;
+constexpr size_t DEFAULT_LISTENER_MAX_QUEUED_BYTES = 64 * 1024 * 1024;
+
+}
+
 namespace arras4 {
 namespace node {
 
@@ -17,6 +30,21 @@ SessionRoutingData::SessionRoutingData(const api::UUID& aSessionId,
       mNodeId(aNodeId)
 {
     mNodeMap = new SessionNodeMap(aRoutingData[aSessionId.toString()]);
+    mMemory = std::make_shared<SessionMemory>(aSessionId, aRoutingData[aSessionId.toString()]);
+    mTraffic = std::make_shared<SessionTraffic>();
+    updateClientConflation(aRoutingData);
+    updateClientCongestion(aRoutingData);
+
+    api::ObjectConstRef listeners = aRoutingData[aSessionId.toString()]["listeners"];
+    mListenerMaxQueued = listeners["maxQueued"].isIntegral() ?
+        listeners["maxQueued"].asUInt() : DEFAULT_LISTENER_MAX_QUEUED;
+    mListenerMaxQueuedBytes = listeners["maxQueuedBytes"].isIntegral() ?
+        static_cast<size_t>(listeners["maxQueuedBytes"].asUInt64()) : DEFAULT_LISTENER_MAX_QUEUED_BYTES;
+    mListenerDisconnectWhenFull = listeners["policy"].isString() &&
+        listeners["policy"].asString() == "disconnect";
+
+    api::ObjectConstRef busyPoll = aRoutingData[aSessionId.toString()]["busyPoll"];
+    mBusyPoll = busyPoll.isBool() && busyPoll.asBool();
 
     if (aNodeId == mNodeMap->getEntryNodeId()) {
 	mClientAddresser = new impl::Addresser();
@@ -42,6 +70,74 @@ SessionRoutingData::updateClientAddresser(api::ObjectConstRef aRoutingData)
     mClientAddresser->update(api::UUID::null,compMap,messageFilter);
 }
 
+void 
+SessionRoutingData::updateMemoryLimit(api::ObjectConstRef aRoutingData)
+{
+    mMemory->update(aRoutingData[mSessionId.toString()]);
+}
+
+void
+SessionRoutingData::updateClientConflation(api::ObjectConstRef aRoutingData)
+{
+    std::shared_ptr<NameSet> names = std::make_shared<NameSet>();
+    api::ObjectConstRef list = aRoutingData[mSessionId.toString()]["clientConflation"];
+    if (list.isArray()) {
+        for (api::ObjectConstIterator it = list.begin(); it != list.end(); ++it) {
+            if ((*it).isString()) {
+                names->insert((*it).asString());
+            }
+        }
+    } else if (!list.isNull()) {
+        ARRAS_WARN(log::Id("badClientConflation") <<
+                   log::Session(mSessionId.toString()) <<
+                   "Routing data 'clientConflation' should be an array of message names");
+    }
+    std::atomic_store(&mClientConflation, std::shared_ptr<const NameSet>(names));
+}
+
+void
+SessionRoutingData::updateClientCongestion(api::ObjectConstRef aRoutingData)
+{
+    std::shared_ptr<ClientCongestionLimits> limits;
+    api::ObjectConstRef config = aRoutingData[mSessionId.toString()]["clientCongestion"];
+    if (config.isObject()) {
+        limits = std::make_shared<ClientCongestionLimits>();
+        limits->mHighWatermark = config["highWatermark"].isIntegral() ? config["highWatermark"].asUInt() : 0;
+        limits->mLowWatermark = config["lowWatermark"].isIntegral() ? config["lowWatermark"].asUInt() :
+            limits->mHighWatermark / 2;
+        limits->mHighWatermarkBytes = config["highWatermarkBytes"].isIntegral() ?
+            static_cast<size_t>(config["highWatermarkBytes"].asUInt64()) : 0;
+        limits->mLowWatermarkBytes = config["lowWatermarkBytes"].isIntegral() ?
+            static_cast<size_t>(config["lowWatermarkBytes"].asUInt64()) : limits->mHighWatermarkBytes / 2;
+        limits->mMinInterval = std::chrono::milliseconds(config["minIntervalMs"].isIntegral() ?
+                                                         config["minIntervalMs"].asUInt() : 1000);
+        if (limits->mHighWatermark == 0 && limits->mHighWatermarkBytes == 0) {
+            ARRAS_WARN(log::Id("badClientCongestion") <<
+                       log::Session(mSessionId.toString()) <<
+                       "Routing data 'clientCongestion' has no high watermark : ignored");
+            limits.reset();
+        }
+    }
+    std::atomic_store(&mClientCongestion, std::shared_ptr<const ClientCongestionLimits>(limits));
+}
+
+bool
+SessionRoutingData::conflatesToClient(const impl::Envelope& anEnvelope) const
+{
+    std::shared_ptr<const NameSet> names = std::atomic_load(&mClientConflation);
+    if (names->empty())
+        return false;
+
+    // control and status messages are always delivered
+    if (anEnvelope.classId() == impl::ControlMessage::ID ||
+        anEnvelope.classId() == impl::SessionStatusMessage::ID)
+        return false;
+
+    if (anEnvelope.metadata() &&
+        names->count(anEnvelope.metadata()->routingName()))
+        return true;
+    return names->count(anEnvelope.classId().toString()) > 0;
+}
 
 SessionRoutingData::~SessionRoutingData()
 {
@@ -8,7 +8,14 @@
 #include <message_api/UUID.h>
 #include <message_api/Object.h>
 
+#include "SessionMemory.h"
+#include "SessionTraffic.h"
+
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <set>
+#include <string>
 
 /** SessionRoutingData holds the per-session routing information that node
  *  requires.
@@ -22,12 +29,43 @@
  *   node for the computation. It contains the information needed to
  *   address messages that the client sends to the entry computation.
  *
+ *   - SessionMemory accounts for the message data held by the router
+ *   for the session, and enforces the session's memory limit.
+ *
+ *   - SessionTraffic counts the session's messages, for the summary
+ *   reported to NodeService when the session ends.
+ *
+ *   - The client conflation list names message classes that the client
+ *   only needs the latest value of (e.g. progressive frames). It is set in
+ *   the routing data as [sessionId]["clientConflation"], an array of
+ *   message routing names or class ids. A message of one of these classes
+ *   queued for the client replaces any unsent message of the same class
+ *   from the same source.
+ *
+ *   - The client congestion limits are the queue watermarks at which the
+ *   client endpoint sends ClientCongestion messages to the session's
+ *   computations. Set as [sessionId]["clientCongestion"] =
+ *   { "highWatermark": <messages>, "lowWatermark": <messages>,
+ *     "highWatermarkBytes": <bytes>, "lowWatermarkBytes": <bytes>,
+ *     "minIntervalMs": <ms> }. Absent means no congestion messages are sent.
+ *
+ *   - The listener limits bound the send queue of each read-only listener
+ *   connected to the session. Set as [sessionId]["listeners"] =
+ *   { "maxQueued": <messages>, "maxQueuedBytes": <bytes>,
+ *     "policy": "drop" | "disconnect" } when the session starts. Messages
+ *   queued for listeners also count towards the session's memory limit.
+ *
+ *   - The busy poll flag makes the session's client and computation
+ *   endpoints eligible for busy polling (see BusyPoll.h). Set as
+ *   [sessionId]["busyPoll"] = true when the session starts.
+ *
 **/
 
 namespace arras4 {
  
     namespace impl {
          class Addresser;
+         class Envelope;
     }
 
     namespace node {
@@ -51,6 +89,9 @@ namespace arras4 {
             // see SessionNodeMap.h for more on node map update
             void updateNodeMap(api::ObjectConstRef aRoutingData);
             void updateClientAddresser(api::ObjectConstRef aRoutingData);
+            void updateMemoryLimit(api::ObjectConstRef aRoutingData);
+            void updateClientConflation(api::ObjectConstRef aRoutingData);
+            void updateClientCongestion(api::ObjectConstRef aRoutingData);
 
             const api::UUID& sessionId() const { return mSessionId; }
             const api::UUID& nodeId() const { return mNodeId; }
@@ -60,6 +101,34 @@ namespace arras4 {
             bool isEntryNode() const { return mClientAddresser != nullptr; }
 	    impl::Addresser* clientAddresser() const { return mClientAddresser; }
 	           // returns nullptr if this node is not the entry node
+            const SessionMemory::Ptr& memory() const { return mMemory; }
+                   // always valid, and may outlive the routing data
+            const SessionTraffic::Ptr& traffic() const { return mTraffic; }
+                   // always valid, and may outlive the routing data
+            bool conflatesToClient(const impl::Envelope& anEnvelope) const;
+                   // true if anEnvelope may be replaced in the client
+                   // send queue by a later one of the same class and source
+
+            struct ClientCongestionLimits {
+                size_t mHighWatermark;       // messages (0 = no limit)
+                size_t mLowWatermark;
+                size_t mHighWatermarkBytes;  // bytes (0 = no limit)
+                size_t mLowWatermarkBytes;
+                std::chrono::milliseconds mMinInterval; // between "congested" messages
+            };
+            std::shared_ptr<const ClientCongestionLimits> clientCongestion() const {
+                return std::atomic_load(&mClientCongestion);
+            }      // null if congestion messages are disabled for the session
+
+            size_t listenerMaxQueued() const { return mListenerMaxQueued; }
+            size_t listenerMaxQueuedBytes() const { return mListenerMaxQueuedBytes; }
+            bool listenerDisconnectWhenFull() const { return mListenerDisconnectWhenFull; }
+            bool busyPoll() const { return mBusyPoll; }
+
+            void markRemoved() { mRemoved = true; }
+            bool removed() const { return mRemoved; }
+                   // true once the session has been deleted from the
+                   // routing table : cached pointers should be dropped
               
             typedef std::shared_ptr<SessionRoutingData> Ptr;
             typedef std::weak_ptr<SessionRoutingData> WeakPtr;
@@ -70,6 +139,18 @@ namespace arras4 {
             api::UUID mNodeId;
             impl::Addresser* mClientAddresser; // may be null
             SessionNodeMap* mNodeMap;    // always valid
+            SessionMemory::Ptr mMemory;  // always valid
+            SessionTraffic::Ptr mTraffic; // always valid
+
+            // replaced as a whole on update, so readers don't need a lock
+            typedef std::set<std::string> NameSet;
+            std::shared_ptr<const NameSet> mClientConflation; // always valid
+            std::shared_ptr<const ClientCongestionLimits> mClientCongestion; // may be null
+            size_t mListenerMaxQueued;
+            size_t mListenerMaxQueuedBytes;
+            bool mListenerDisconnectWhenFull;
+            bool mBusyPoll;
+            std::atomic<bool> mRemoved{false};
         };
 
     } 
@@ -0,0 +1,124 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "SessionTraffic.h"
+
+#include <algorithm>
+
+namespace {
+
+// raise anAtomic to aValue if it is lower
+template <typename T>
+void updateMax(std::atomic<T>& anAtomic, T aValue)
+{
+    T current = anAtomic.load(std::memory_order_relaxed);
+    while (aValue > current &&
+           !anAtomic.compare_exchange_weak(current, aValue, std::memory_order_relaxed)) {}
+}
+
+}
+
+namespace arras4 {
+namespace node {
+
+SessionTraffic::SessionTraffic() :
+    mStart(std::chrono::steady_clock::now())
+{
+    for (auto& bucket : mWaitBuckets) {
+        bucket = 0;
+    }
+}
+
+void
+SessionTraffic::received(PeerManager::PeerType aFrom, size_t aBytes)
+{
+    Counter& counter = mReceived[aFrom];
+    counter.mMessages.fetch_add(1, std::memory_order_relaxed);
+    counter.mBytes.fetch_add(aBytes, std::memory_order_relaxed);
+}
+
+void
+SessionTraffic::sent(PeerManager::PeerType aTo, size_t aBytes,
+                     std::chrono::steady_clock::duration aWait)
+{
+    Counter& counter = mSent[aTo];
+    counter.mMessages.fetch_add(1, std::memory_order_relaxed);
+    counter.mBytes.fetch_add(aBytes, std::memory_order_relaxed);
+
+    unsigned long long us = std::chrono::duration_cast<std::chrono::microseconds>(aWait).count();
+    unsigned bucket = 0;
+    while (bucket < WAIT_BUCKETS - 1 && (1ull << bucket) <= us) {
+        bucket++;
+    }
+    mWaitBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    updateMax(mMaxWaitUs, us);
+}
+
+void
+SessionTraffic::queued(size_t aDepth, size_t aDepthBytes)
+{
+    updateMax(mPeakQueued, aDepth);
+    updateMax(mPeakQueuedBytes, aDepthBytes);
+}
+
+void
+SessionTraffic::stashed(size_t aDepth)
+{
+    updateMax(mPeakStashed, aDepth);
+}
+
+api::Object
+SessionTraffic::report() const
+{
+    api::Object report;
+    report["durationSecs"] = static_cast<double>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - mStart).count()) / 1000.0;
+
+    for (unsigned type = PeerManager::PEER_CLIENT; type < PeerManager::PEER_SERVICE; type++) {
+        std::string name = PeerManager::peerTypeName(static_cast<PeerManager::PeerType>(type));
+        const Counter& in = mReceived[type];
+        const Counter& out = mSent[type];
+        if (in.mMessages) {
+            report["received"][name]["messages"] = static_cast<api::Object::UInt64>(in.mMessages.load());
+            report["received"][name]["bytes"] = static_cast<api::Object::UInt64>(in.mBytes.load());
+        }
+        if (out.mMessages) {
+            report["sent"][name]["messages"] = static_cast<api::Object::UInt64>(out.mMessages.load());
+            report["sent"][name]["bytes"] = static_cast<api::Object::UInt64>(out.mBytes.load());
+        }
+    }
+    report["peakQueued"] = static_cast<api::Object::UInt64>(mPeakQueued.load());
+    report["peakQueuedBytes"] = static_cast<api::Object::UInt64>(mPeakQueuedBytes.load());
+    report["peakStashed"] = static_cast<api::Object::UInt64>(mPeakStashed.load());
+    report["dropped"] = static_cast<api::Object::UInt64>(mDropped.load());
+
+    // queue wait percentiles, in microseconds
+    unsigned long long counts[WAIT_BUCKETS];
+    unsigned long long total = 0;
+    for (unsigned i = 0; i < WAIT_BUCKETS; i++) {
+        counts[i] = mWaitBuckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total) {
+        const std::pair<const char*, double> percentiles[] = {
+            { "p50", 0.5 }, { "p90", 0.9 }, { "p99", 0.99 }
+        };
+        for (const auto& p : percentiles) {
+            unsigned long long target = static_cast<unsigned long long>(p.second * total);
+            unsigned long long seen = 0;
+            unsigned bucket = 0;
+            for (; bucket < WAIT_BUCKETS - 1; bucket++) {
+                seen += counts[bucket];
+                if (seen > target) break;
+            }
+            report["queueWaitUs"][p.first] = static_cast<api::Object::UInt64>(
+                std::min(1ull << bucket, mMaxWaitUs.load()));
+        }
+        report["queueWaitUs"]["max"] = static_cast<api::Object::UInt64>(mMaxWaitUs.load());
+    }
+    return report;
+}
+
+}
+}
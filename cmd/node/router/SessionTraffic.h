@@ -0,0 +1,73 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __ARRAS_SESSIONTRAFFIC_H__
+#define __ARRAS_SESSIONTRAFFIC_H__
+
+#include "PeerManager.h"
+
+#include <message_api/Object.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+/** SessionTraffic counts the messages the router handles for a session,
+ *  so that a summary can be reported when the session ends :
+ *
+ *   - messages and bytes received from and sent to each type of peer
+ *     (client, node, computation, listener)
+ *   - the peak depth of any send queue holding the session's messages
+ *   - the peak number of messages stashed for a client that hadn't
+ *     connected yet
+ *   - messages dropped (memory limit or full listener queue)
+ *   - percentiles of the time messages waited in send queues
+ *
+ *  All counters are atomics, updated by the endpoint threads without locks.
+ *  Wait times are kept in a histogram with power of 2 buckets, so the
+ *  percentiles are approximate (the upper bound of the bucket).
+**/
+
+namespace arras4 {
+    namespace node {
+
+        class SessionTraffic
+        {
+        public:
+            typedef std::shared_ptr<SessionTraffic> Ptr;
+
+            SessionTraffic();
+
+            void received(PeerManager::PeerType aFrom, size_t aBytes);
+            void sent(PeerManager::PeerType aTo, size_t aBytes,
+                      std::chrono::steady_clock::duration aWait);
+            void queued(size_t aDepth, size_t aDepthBytes);
+            void stashed(size_t aDepth);
+            void dropped() { mDropped++; }
+
+            // summary as a JSON-compatible object
+            api::Object report() const;
+
+        private:
+            static constexpr unsigned PEER_TYPES = PeerManager::PEER_SERVICE + 1;
+            static constexpr unsigned WAIT_BUCKETS = 32; // bucket n : wait < 2^n microseconds
+
+            struct Counter {
+                std::atomic<unsigned long long> mMessages{0};
+                std::atomic<unsigned long long> mBytes{0};
+            };
+            Counter mReceived[PEER_TYPES];
+            Counter mSent[PEER_TYPES];
+            std::atomic<size_t> mPeakQueued{0};
+            std::atomic<size_t> mPeakQueuedBytes{0};
+            std::atomic<size_t> mPeakStashed{0};
+            std::atomic<unsigned long long> mDropped{0};
+            std::atomic<unsigned long long> mWaitBuckets[WAIT_BUCKETS];
+            std::atomic<unsigned long long> mMaxWaitUs{0};
+            const std::chrono::steady_clock::time_point mStart;
+        };
+
+    } 
+} 
+
+#endif // __ARRAS_SESSIONTRAFFIC_H__
@@ -4,6 +4,8 @@
 #include <core_messages/ControlMessage.h>
 #include <node/messages/ClientConnectionStatusMessage.h>
 #include <node/messages/ComputationStatusMessage.h>
+#include <node/messages/SessionFailureMessage.h>
+#include <node/messages/SessionTrafficMessage.h>
 #include "PeerManager.h"
 #include "RemoteEndpoint.h"
 #include "ThreadedNodeRouter.h"
@@ -11,14 +13,25 @@
 
 using namespace arras4::api;
 
+namespace {
+
+// interval between batches of heartbeats sent to NodeService
+const std::chrono::milliseconds HEARTBEAT_BATCH_INTERVAL(1000);
+
+}
+
 namespace arras4 {
 namespace node {
 
 ThreadedNodeRouter::ThreadedNodeRouter(const UUID& aNodeId) :
     mNodeId(aNodeId),
     mServiceEndpoint(nullptr),
+    mCapture(aNodeId),
+    mHopTracer(aNodeId),
     mServiceToRouterQueue(new impl::MessageQueue()),
-    mServiceDisconnected(false)
+    mServiceDisconnected(false),
+    mHeartbeatBatcher(*this, HEARTBEAT_BATCH_INTERVAL),
+    mNodeProber(*this)
 {
 }
 
@@ -53,6 +66,9 @@ ThreadedNodeRouter::addSessionRoutingData(const UUID& aSessionId,
    SessionRoutingData::Ptr data(new SessionRoutingData(aSessionId,
                                                        mNodeId,
                                                        aRoutingData));
+   data->memory()->setFailureHandler([this](const UUID& sessionId, const std::string& reason) {
+           notifySessionFailed(sessionId, reason);
+       });
    mRoutingTable.addSessionRoutingData(aSessionId, data);
    return data;
 }
@@ -94,6 +110,9 @@ ThreadedNodeRouter::destroyEndpoints()
 void
 ThreadedNodeRouter::notifyClientDisconnected(const UUID& aSessionId, const std::string& aReason)
 {
+    // sent first, so that NodeService can attach it to the disconnect event
+    notifySessionTraffic(aSessionId, false);
+
     ClientConnectionStatus* disco = new ClientConnectionStatus;
     disco->mSessionId = aSessionId;
     disco->mReason = aReason;
@@ -126,12 +145,10 @@ ThreadedNodeRouter::notifyComputationStatus(const api::UUID& aSessionId, const a
 
 
 void
-ThreadedNodeRouter::notifyHeartbeat(std::shared_ptr<const impl::ExecutorHeartbeat>& heartbeat, const std::string& sessionId, const std::string& compId)
+ThreadedNodeRouter::notifyHeartbeat(const impl::ExecutorHeartbeat::ConstPtr& heartbeat, const UUID& sessionId,
+                                    const UUID& compId, bool statsDue)
 {
-    impl::Envelope envelope(heartbeat);
-    Address address(sessionId, mNodeId.toString(), compId);
-    envelope.metadata()->from() = address;
-    notifyService(envelope);
+    mHeartbeatBatcher.addHeartbeat(heartbeat, sessionId, compId, statsDue);
 }
 
 void
@@ -141,6 +158,28 @@ ThreadedNodeRouter::notifyRouterShutdown()
     notifyService(envelope);
 }
 
+void
+ThreadedNodeRouter::notifySessionFailed(const UUID& aSessionId, const std::string& aReason)
+{
+    SessionFailureMessage* failure = new SessionFailureMessage;
+    failure->mSessionId = aSessionId;
+    failure->mReason = aReason;
+    notifyService(failure);
+}
+
+void
+ThreadedNodeRouter::notifySessionTraffic(const UUID& aSessionId, bool aFinal)
+{
+    SessionRoutingData::Ptr routingData = sessionRoutingData(aSessionId);
+    if (!routingData)
+        return;
+    SessionTrafficMessage* traffic = new SessionTrafficMessage;
+    traffic->mSessionId = aSessionId;
+    traffic->mFinal = aFinal;
+    traffic->mReport = api::objectToString(routingData->traffic()->report());
+    notifyService(traffic);
+}
+
 void
 ThreadedNodeRouter::notifyService(arras4::api::MessageContent* message) {
     arras4::impl::Envelope env(message);
@@ -7,7 +7,14 @@
 // this is NodeRouter state which will be used by multiple threads
 // at the same time
 
+#include "BusyPoll.h"
+#include "HeartbeatBatcher.h"
+#include "HopTracer.h"
+#include "MappedPayload.h"
+#include "NodeProber.h"
+#include "NodeRouterOptions.h"
 #include "PeerManager.h"
+#include "RouterTrace.h"
 #include "RoutingTable.h"
 #include "SessionRoutingData.h"
 
@@ -43,6 +50,7 @@ class ThreadedNodeRouter {
         mRoutingTable.releaseSessionRoutingData(aSessionId);
     }
     void deleteSessionRoutingData(const api::UUID& aSessionId) {
+        mCapture.endSession(aSessionId);
         mRoutingTable.deleteSessionRoutingData(aSessionId);
     }
 
@@ -50,14 +58,15 @@ class ThreadedNodeRouter {
     std::shared_ptr<RemoteEndpoint> trackNode(const api::UUID& aId,RemoteEndpoint* aRemoteEndpoint) {
         return mPeerManager.trackNode(aId, aRemoteEndpoint);
     }
-    std::shared_ptr<RemoteEndpoint> trackIpc(const api::UUID& aId, RemoteEndpoint* aRemoteEndpoint) {
-        return mPeerManager.trackIpc(aId, aRemoteEndpoint);
+    std::shared_ptr<RemoteEndpoint> trackIpc(const api::UUID& aSessionId, const api::UUID& aId,
+                                             RemoteEndpoint* aRemoteEndpoint) {
+        return mPeerManager.trackIpc(aSessionId, aId, aRemoteEndpoint);
     }
     PeerManager::PeerType findPeer(const RemoteEndpoint* aRemoteEndpoint, api::UUID& aId) const {
         return mPeerManager.findPeer(aRemoteEndpoint, aId);
     }
-    std::shared_ptr<RemoteEndpoint> findIpcPeer(const api::UUID& aId) const {
-        return mPeerManager.findIpcPeer(aId);
+    std::shared_ptr<RemoteEndpoint> findIpcPeer(const api::UUID& aSessionId, const api::UUID& aId) const {
+        return mPeerManager.findIpcPeer(aSessionId, aId);
     }
     std::shared_ptr<RemoteEndpoint> findClientPeer(const api::UUID& aId) const {
         return mPeerManager.findClientPeer(aId);
@@ -65,6 +74,16 @@ class ThreadedNodeRouter {
     std::shared_ptr<RemoteEndpoint> findNodePeer(const api::UUID& aId) const {
         return mPeerManager.findNodePeer(aId);
     }
+    std::map<api::UUID, std::shared_ptr<RemoteEndpoint> > getNodePeers() const {
+        return mPeerManager.getNodePeers();
+    }
+    // listeners are tracked by session id
+    std::shared_ptr<RemoteEndpoint> trackListener(const api::UUID& aSessionId, RemoteEndpoint* aRemoteEndpoint) {
+        return mPeerManager.trackListener(aSessionId, aRemoteEndpoint);
+    }
+    RemoteEndpointList getListeners(const api::UUID& aSessionId) const {
+        return mPeerManager.getListeners(aSessionId);
+    }
     PeerManager::PeerType untrackPeer(const RemoteEndpoint* aRemoteEndpoint, api::UUID& aId) {
         return mPeerManager.destroyPeer(aRemoteEndpoint, aId);
     }
@@ -76,8 +95,9 @@ class ThreadedNodeRouter {
     void clearStashedEnvelopes(const api::UUID& aSessionId) {
         mPeerManager.clearStashedEnvelopes(aSessionId);
     }
-    void stashEnvelope(const api::UUID& aSessionId, const impl::Envelope& anEnvelope) {
-        mPeerManager.stashEnvelope(aSessionId, anEnvelope);
+    size_t stashEnvelope(const api::UUID& aSessionId, const impl::Envelope& anEnvelope,
+                         const SessionMemory::Ptr& aMemory) {
+        return mPeerManager.stashEnvelope(aSessionId, anEnvelope, aMemory);
     }
 
     // this is thread safe because mNodeId is only set during construction of
@@ -93,14 +113,50 @@ class ThreadedNodeRouter {
         mServiceEndpoint = aEndpoint;
     }
 
+    // set once at startup, before any endpoints exist
+    ReceiveMode receiveMode() const { return mReceiveMode; }
+    void setReceiveMode(ReceiveMode aMode) { mReceiveMode = aMode; }
+
+    // split the routing and peer tables into shards by session id, so
+    // that sessions in different shards don't share locks. Set once at
+    // startup, before any endpoints exist
+    void setShardCount(size_t aCount) {
+        mRoutingTable.setShardCount(aCount);
+        mPeerManager.setShardCount(aCount);
+    }
+    size_t shardCount() const { return mPeerManager.shardCount(); }
+
+    // busy polling of latency-sensitive sessions (see BusyPoll.h)
+    BusyPoller& busyPoller() { return mBusyPoller; }
+
+    // traffic capture : configured once at startup, thread safe after that
+    RouterCapture& capture() { return mCapture; }
+
+    // large payloads held in file mappings (see MappedPayload.h)
+    PayloadMapper& payloadMapper() { return mPayloadMapper; }
+
+    // sampled per-hop timing of routed messages (see HopTracer.h)
+    HopTracer& hopTracer() { return mHopTracer; }
+
+    // measurement of the links to other nodes (see NodeProber.h)
+    NodeProber& nodeProber() { return mNodeProber; }
+
     void destroyEndpoints();
 
     void notifyClientDisconnected(const api::UUID& aSessionId, const std::string& aReason);
     void notifyClientConnected(const api::UUID& aSessionId);
     void notifyComputationStatus(const api::UUID& aSessionId, const api::UUID& aCompId,
                                  const std::string& aStatus);
-    void notifyHeartbeat(std::shared_ptr<const impl::ExecutorHeartbeat>& heartbeat, const std::string& sessionId, const std::string& comp);
+    // heartbeats are coalesced and sent to NodeService periodically as a HeartbeatBatchMessage
+    void notifyHeartbeat(const impl::ExecutorHeartbeat::ConstPtr& heartbeat, const api::UUID& sessionId,
+                         const api::UUID& compId, bool statsDue);
+    void startHeartbeatBatching() { mHeartbeatBatcher.start(); }
+    void stopHeartbeatBatching() { mHeartbeatBatcher.stop(); }
     void notifyRouterShutdown();
+    void notifySessionFailed(const api::UUID& aSessionId, const std::string& aReason);
+    // send the session's traffic summary (see SessionTraffic.h). aFinal is set
+    // when the session's routing data is about to be deleted
+    void notifySessionTraffic(const api::UUID& aSessionId, bool aFinal);
     void notifyService(arras4::api::MessageContent* message);
     void notifyService(impl::Envelope& env);
 
@@ -141,12 +197,20 @@ class ThreadedNodeRouter {
     friend class RemoteEndpoint;
 
     RemoteEndpoint* mServiceEndpoint;
+    ReceiveMode mReceiveMode = ReceiveMode::Poll;
+    RouterCapture mCapture;
+    HopTracer mHopTracer;
+    PayloadMapper mPayloadMapper;
+    BusyPoller mBusyPoller;
 
     std::unique_ptr<arras4::impl::MessageQueue> mServiceToRouterQueue;
 
     bool mServiceDisconnected;
     std::mutex mServiceDisconnectedMutex;
     std::condition_variable mServiceDisconnectedCondition;
+
+    HeartbeatBatcher mHeartbeatBatcher;
+    NodeProber mNodeProber;
 };
 
 } // end namespace node
@@ -0,0 +1,471 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+// arras4_router_replay : plays a router traffic capture (made with
+// arras4_router --captureDir) back against a running router.
+//
+// The tool connects to the router as NodeService, sends it the
+// routing data recorded in the trace, and then connects synthetic
+// computations (over IPC) and a synthetic client (over TCP) in place of the
+// real ones. Each recorded message that arrived from a computation or
+// the client is resent from the corresponding synthetic endpoint, with
+// the same class, routing name, addressing and content size (and the
+// recorded content, if the capture included it), either at the recorded times
+// (scaled by --speed) or as fast as possible (--speed 0). Messages that
+// arrived from other nodes are not replayed, and destinations on other nodes
+// are dropped so that only the local router is exercised.
+//
+// The router must be started with the node id of the capturing node, e.g.
+//     arras4_router --nodeid <id> --ipcName /tmp/replay.ipc --inetPort 0
+// (the id is printed by "arras4_router_replay --trace <file> --info")
+
+#include <arras4_log/Logger.h>
+#include <arras4_log/LogEventStream.h>
+
+#include <boost/program_options.hpp>
+#include <message_api/ContentMacros.h>
+#include <message_api/DataOutStream.h>
+#include <message_api/Object.h>
+#include <message_api/UUID.h>
+#include <message_impl/Envelope.h>
+#include <message_impl/messaging_version.h>
+#include <message_impl/OpaqueContent.h>
+#include <message_impl/PeerMessageEndpoint.h>
+#include <network/InetSocketPeer.h>
+#include <network/IPCSocketPeer.h>
+#include <node/messages/RouterInfoMessage.h>
+#include <node/messages/SessionRoutingDataMessage.h>
+#include <node/router/PeerManager.h>
+#include <node/router/RouterTrace.h>
+#include <shared_impl/RegistrationData.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+
+namespace bpo = boost::program_options;
+
+using namespace arras4;
+using namespace arras4::node;
+
+namespace {
+
+// time to wait for the router to acknowledge the routing data
+const std::chrono::seconds ACKNOWLEDGE_TIMEOUT(10);
+
+// content with the class, version and routing name of a recorded
+// message, serializing to the recorded bytes (or zeros of the same size)
+class ReplayContent : public api::MessageContent
+{
+public:
+    ReplayContent(const api::ClassID& aClassId,
+                  unsigned aClassVersion,
+                  const std::string& aRoutingName,
+                  std::string&& aData)
+        : mClassId(aClassId), mClassVersion(aClassVersion),
+          mRoutingName(aRoutingName), mData(std::move(aData)) {}
+
+    const api::ClassID& classId() const { return mClassId; }
+    unsigned classVersion() const { return mClassVersion; }
+    const std::string& defaultRoutingName() const { return mRoutingName; }
+
+    void serialize(api::DataOutStream& to) const { to.write(mData.data(), mData.size()); }
+    // replayed content is only ever sent
+    void deserialize(api::DataInStream&, unsigned) {
+        throw std::logic_error("ReplayContent cannot be deserialized");
+    }
+
+private:
+    const api::ClassID mClassId;
+    const unsigned mClassVersion;
+    const std::string mRoutingName;
+    const std::string mData;
+};
+
+// when the trace has no payloads, the zeros sent in their place start with
+// this marker and the send time, so that the receiving endpoint can measure
+// delivery latency. Recorded payloads are sent unchanged
+constexpr char LATENCY_MARKER[8] = { 'A','R','R','R','P','L','A','Y' };
+constexpr size_t LATENCY_STAMP_SIZE = sizeof(LATENCY_MARKER) + sizeof(unsigned long long);
+
+unsigned long long steadyNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// one synthetic computation or client
+struct SyntheticEndpoint
+{
+    std::string mName;
+    std::unique_ptr<network::SocketPeer> mPeer;
+    std::unique_ptr<impl::PeerMessageEndpoint> mEndpoint;
+    std::thread mDrainThread;
+
+    // updated by the drain thread
+    std::atomic<unsigned long long> mReceived{0};
+    std::mutex mLatencyMutex;
+    std::vector<unsigned long long> mLatencies; // ns
+};
+
+impl::RegistrationData makeRegistration()
+{
+    return impl::RegistrationData(ARRAS_MESSAGING_API_VERSION_MAJOR,
+                                  ARRAS_MESSAGING_API_VERSION_MINOR,
+                                  ARRAS_MESSAGING_API_VERSION_PATCH);
+}
+
+void drain(SyntheticEndpoint* ep)
+{
+    try {
+        while (true) {
+            impl::Envelope env = ep->mEndpoint->getEnvelope();
+            ep->mReceived++;
+            std::shared_ptr<const impl::OpaqueContent> opaque = env.contentAs<impl::OpaqueContent>();
+            if (opaque && opaque->dataSize() >= LATENCY_STAMP_SIZE &&
+                memcmp(opaque->data(), LATENCY_MARKER, sizeof(LATENCY_MARKER)) == 0) {
+                unsigned long long sendTime;
+                memcpy(&sendTime, static_cast<const char*>(opaque->data()) + sizeof(LATENCY_MARKER),
+                       sizeof(sendTime));
+                unsigned long long now = steadyNow();
+                std::lock_guard<std::mutex> lock(ep->mLatencyMutex);
+                ep->mLatencies.push_back(now - sendTime);
+            }
+        }
+    } catch (const std::exception&) {
+        // peer was shut down or disconnected
+    }
+}
+
+void startDrain(SyntheticEndpoint* ep, const std::string& traceInfo)
+{
+    ep->mEndpoint.reset(new impl::PeerMessageEndpoint(*ep->mPeer, false, traceInfo));
+    ep->mDrainThread = std::thread(drain, ep);
+}
+
+void parseCmdLine(int argc, char* argv[],
+                  bpo::options_description& flags,
+                  bpo::variables_map& cmdOpts)
+{
+    flags.add_options()
+        ("help", "Display command line options")
+        ("trace", bpo::value<std::string>()->required(), "Trace file to replay")
+        ("info", "Print information about the trace and exit")
+        ("ipcName", bpo::value<std::string>(), "IPC socket of the router")
+        ("inetHost", bpo::value<std::string>()->default_value("localhost"), "Host of the router, for the client connection")
+        ("inetPort", bpo::value<unsigned short>()->default_value(0),
+         "TCP port of the router, for the client connection (default: as reported by the router)")
+        ("speed", bpo::value<double>()->default_value(1.0),
+         "Replay speed relative to the recording. 0 sends as fast as possible")
+        ("settle", bpo::value<unsigned>()->default_value(2),
+         "Seconds to wait for messages to be delivered after the last one is sent")
+        ;
+
+    bpo::store(bpo::command_line_parser(argc, argv).
+               options(flags).run(), cmdOpts);
+    bpo::notify(cmdOpts);
+}
+
+void printInfo(TraceReader& reader)
+{
+    std::map<std::string, unsigned long long> counts;
+    unsigned long long total = 0;
+    unsigned long long bytes = 0;
+    unsigned long long duration = 0;
+    TraceReader::Record rec;
+    while (reader.next(rec)) {
+        std::string key = PeerManager::peerTypeName(static_cast<PeerManager::PeerType>(rec.mHeader->mPeerType)) +
+            " " + (rec.mName.empty() ? rec.mClassId.toString() : rec.mName);
+        counts[key]++;
+        total++;
+        bytes += rec.mHeader->mContentSize;
+        duration = rec.mHeader->mTime;
+    }
+    reader.rewind();
+
+    std::cout << "session:  " << reader.sessionId().toString() << "\n"
+              << "node:     " << reader.nodeId().toString() << "\n"
+              << "messages: " << total << " (" << bytes << " bytes) over "
+              << duration / 1e9 << " seconds\n";
+    for (const auto& c : counts) {
+        std::cout << "    " << c.second << "\t" << c.first << "\n";
+    }
+}
+
+void printLatency(const std::vector<std::unique_ptr<SyntheticEndpoint>>& endpoints)
+{
+    std::vector<unsigned long long> all;
+    for (const auto& ep : endpoints) {
+        std::lock_guard<std::mutex> lock(ep->mLatencyMutex);
+        all.insert(all.end(), ep->mLatencies.begin(), ep->mLatencies.end());
+    }
+    if (all.empty())
+        return;
+    std::sort(all.begin(), all.end());
+    auto pct = [&all](double p) { return all[static_cast<size_t>(p * (all.size() - 1))] / 1e3; };
+    std::cout << "latency (us): p50 " << pct(0.5) << " p90 " << pct(0.9)
+              << " p99 " << pct(0.99) << " max " << all.back() / 1e3 << std::endl;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char* argv[])
+{
+    bpo::options_description flags;
+    bpo::variables_map cmdOpts;
+
+    try {
+        parseCmdLine(argc, argv, flags, cmdOpts);
+    } catch(std::exception& e) {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (cmdOpts.count("help")) {
+        std::cout << flags << std::endl;
+        return 0;
+    }
+
+    std::unique_ptr<TraceReader> reader;
+    try {
+        reader.reset(new TraceReader(cmdOpts["trace"].as<std::string>()));
+    } catch (std::exception& e) {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (cmdOpts.count("info")) {
+        printInfo(*reader);
+        return 0;
+    }
+    if (!cmdOpts.count("ipcName")) {
+        std::cerr << "error: --ipcName is required" << std::endl;
+        return 1;
+    }
+
+    const api::UUID sessionId = reader->sessionId();
+    const api::UUID nodeId = reader->nodeId();
+    const std::string ipcName = cmdOpts["ipcName"].as<std::string>();
+    const double speed = cmdOpts["speed"].as<double>();
+    const std::string routing = reader->routing();
+
+    // connect to the router as NodeService and install the recorded routing data
+    SyntheticEndpoint service;
+    service.mName = "service";
+    unsigned short inetPort = cmdOpts["inetPort"].as<unsigned short>();
+    try {
+        network::IPCSocketPeer* peer = new network::IPCSocketPeer();
+        service.mPeer.reset(peer);
+        peer->connect(ipcName);
+        impl::RegistrationData regData = makeRegistration();
+        regData.mType = impl::REGISTRATION_CONTROL;
+        regData.mNodeId = nodeId;
+        peer->send_or_throw(&regData, sizeof(regData), "to router");
+        service.mEndpoint.reset(new impl::PeerMessageEndpoint(*peer, false, "replay service"));
+
+        impl::Envelope init(new SessionRoutingDataMessage(SessionRoutingAction::Initialize,
+                                                          sessionId, routing));
+        service.mEndpoint->putEnvelope(init);
+
+        // the router may send RouterInfo before the acknowledgement. Wait for
+        // each message with poll(), so that a silent router can't block us
+        auto deadline = std::chrono::steady_clock::now() + ACKNOWLEDGE_TIMEOUT;
+        bool acknowledged = false;
+        while (!acknowledged) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now());
+            if (remaining.count() <= 0)
+                break;
+            struct pollfd pfd;
+            pfd.fd = peer->fd();
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            int r = ::poll(&pfd, 1, static_cast<int>(remaining.count()));
+            if (r < 0 && errno == EINTR)
+                continue;
+            if (r <= 0)
+                break;
+            impl::Envelope env = service.mEndpoint->getEnvelope();
+            if (env.classId() == RouterInfoMessage::ID && inetPort == 0) {
+                impl::MessageReader::deserializeContent(env);
+                RouterInfoMessage::ConstPtr info = env.contentAs<RouterInfoMessage>();
+                if (info) inetPort = info->mMessagePort;
+            } else if (env.classId() == SessionRoutingDataMessage::ID) {
+                acknowledged = true;
+            }
+        }
+        if (!acknowledged) {
+            std::cerr << "error: router did not acknowledge routing data" << std::endl;
+            return 1;
+        }
+    } catch (std::exception& e) {
+        std::cerr << "error: cannot connect to router at " << ipcName << ": " << e.what() << std::endl;
+        return 1;
+    }
+    service.mDrainThread = std::thread(drain, &service);
+
+    // connect a synthetic endpoint for every computation on this node,
+    // and for the client if the trace has client traffic
+    api::Object routingObj;
+    api::stringToObject(routing, routingObj);
+    api::ObjectConstRef comps = routingObj[sessionId.toString()]["computations"];
+
+    std::vector<std::unique_ptr<SyntheticEndpoint>> endpoints;
+    std::map<api::UUID, SyntheticEndpoint*> computations;
+    SyntheticEndpoint* client = nullptr;
+    bool hasClientTraffic = false;
+    TraceReader::Record rec;
+    while (reader->next(rec)) {
+        if (rec.mHeader->mPeerType == PeerManager::PEER_CLIENT) {
+            hasClientTraffic = true;
+            break;
+        }
+    }
+    reader->rewind();
+
+    try {
+        for (api::ObjectConstIterator cIt = comps.begin(); cIt != comps.end(); ++cIt) {
+            api::ObjectConstRef info = *cIt;
+            if (!info["nodeId"].isString() || !(api::UUID(info["nodeId"].asString()) == nodeId))
+                continue;
+            api::UUID compId(info["compId"].asString());
+            std::unique_ptr<SyntheticEndpoint> ep(new SyntheticEndpoint);
+            ep->mName = cIt.memberName();
+            network::IPCSocketPeer* peer = new network::IPCSocketPeer();
+            ep->mPeer.reset(peer);
+            peer->connect(ipcName);
+            impl::RegistrationData regData = makeRegistration();
+            regData.mType = impl::REGISTRATION_EXECUTOR;
+            regData.mNodeId = nodeId;
+            regData.mSessionId = sessionId;
+            regData.mComputationId = compId;
+            peer->send_or_throw(&regData, sizeof(regData), "to router");
+            startDrain(ep.get(), "replay C:" + compId.toString());
+            computations[compId] = ep.get();
+            endpoints.push_back(std::move(ep));
+        }
+
+        if (hasClientTraffic) {
+            std::unique_ptr<SyntheticEndpoint> ep(new SyntheticEndpoint);
+            ep->mName = "client";
+            network::InetSocketPeer* peer = new network::InetSocketPeer();
+            ep->mPeer.reset(peer);
+            peer->connect(cmdOpts["inetHost"].as<std::string>().c_str(), inetPort);
+            impl::RegistrationData regData = makeRegistration();
+            regData.mType = impl::REGISTRATION_CLIENT;
+            regData.mSessionId = sessionId;
+            peer->send_or_throw(&regData, sizeof(regData), "to router");
+            startDrain(ep.get(), "replay client");
+            client = ep.get();
+            endpoints.push_back(std::move(ep));
+        }
+    } catch (std::exception& e) {
+        std::cerr << "error: cannot connect synthetic endpoint: " << e.what() << std::endl;
+        return 1;
+    }
+
+    // replay
+    unsigned long long sent = 0, sentBytes = 0, skippedNode = 0, skippedUnrouted = 0, skippedRemote = 0;
+    const auto start = std::chrono::steady_clock::now();
+    while (reader->next(rec)) {
+        const TraceRecordHeader& h = *rec.mHeader;
+        if (!(h.mFlags & TRACE_ROUTED)) {
+            // control messages and heartbeats are not forwarded by the router
+            skippedUnrouted++;
+            continue;
+        }
+        SyntheticEndpoint* source = nullptr;
+        if (h.mPeerType == PeerManager::PEER_CLIENT) {
+            source = client;
+        } else if (h.mPeerType == PeerManager::PEER_IPC) {
+            auto it = computations.find(rec.mSourceId);
+            if (it != computations.end()) source = it->second;
+        }
+        if (source == nullptr) {
+            skippedNode++;
+            continue;
+        }
+
+        // client messages are addressed by the router itself
+        api::AddressList to;
+        for (const api::Address& addr : rec.mTo) {
+            if (addr.node == nodeId) {
+                to.push_back(addr);
+            }
+        }
+        if (to.empty() && h.mPeerType != PeerManager::PEER_CLIENT) {
+            // all destinations were on other nodes
+            skippedRemote++;
+            continue;
+        }
+
+        if (speed > 0) {
+            auto due = start + std::chrono::nanoseconds(static_cast<long long>(h.mTime / speed));
+            std::this_thread::sleep_until(due);
+        }
+
+        std::string data;
+        if (rec.mPayload) {
+            data.assign(rec.mPayload, h.mPayloadSize);
+        } else {
+            data.assign(h.mContentSize, '\0');
+            if (data.size() >= LATENCY_STAMP_SIZE) {
+                unsigned long long sendTime = steadyNow();
+                memcpy(&data[0], LATENCY_MARKER, sizeof(LATENCY_MARKER));
+                memcpy(&data[sizeof(LATENCY_MARKER)], &sendTime, sizeof(sendTime));
+            }
+        }
+        impl::Envelope env(new ReplayContent(rec.mClassId, h.mClassVersion, rec.mName, std::move(data)));
+        env.to() = to;
+        try {
+            source->mEndpoint->putEnvelope(env);
+        } catch (std::exception& e) {
+            std::cerr << "error: send from " << source->mName << " failed: " << e.what() << std::endl;
+            break;
+        }
+        sent++;
+        sentBytes += h.mContentSize;
+    }
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::this_thread::sleep_for(std::chrono::seconds(cmdOpts["settle"].as<unsigned>()));
+
+    // tell the router the session is finished, then disconnect everything
+    try {
+        impl::Envelope del(new SessionRoutingDataMessage(SessionRoutingAction::Delete, sessionId));
+        service.mEndpoint->putEnvelope(del);
+    } catch (std::exception&) {
+        // router has already gone
+    }
+    for (auto& ep : endpoints) {
+        ep->mPeer->shutdown();
+        ep->mDrainThread.join();
+    }
+    service.mPeer->shutdown();
+    service.mDrainThread.join();
+
+    unsigned long long received = 0;
+    for (const auto& ep : endpoints) {
+        received += ep->mReceived;
+        std::cout << "    " << ep->mName << " received " << ep->mReceived << "\n";
+    }
+    std::cout << "sent " << sent << " messages (" << sentBytes << " bytes) in " << elapsed << " s : "
+              << (elapsed > 0 ? sent / elapsed : 0) << " msg/s, "
+              << (elapsed > 0 ? sentBytes / elapsed / (1024 * 1024) : 0) << " MB/s\n"
+              << "received " << received << " messages\n"
+              << "not replayed : " << skippedNode << " from other nodes, "
+              << skippedUnrouted << " unrouted, " << skippedRemote << " for other nodes only" << std::endl;
+    printLatency(endpoints);
+    return 0;
+}
@@ -3,6 +3,7 @@
 
 from session import Session
 from node import Node
+from eventstats import EventStats
 import subprocess
 import time
 
@@ -14,6 +15,7 @@ class Coord(object):
         self.nodes = {}
         self.nodeList = []
         self.currentSession = None
+        self.eventStats = EventStats()
                         
         
     def new(self,filepath=None):
@@ -0,0 +1,126 @@
+# Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+# SPDX-License-Identifier: Apache-2.0
+
+# A Coordinator stand-in that accepts every event node sends, without
+# tracking sessions, and reports how quickly they arrive. Use it to measure
+# event delivery : point node at it with
+#   --coordinatorBaseUrl http://localhost:<port>/coordinator/1
+# then create and delete sessions directly on node (or with cemu, on
+# another port). Counts are printed each time events stop arriving for
+# a while, and are available from GET /eventstats (DELETE resets them)
+#
+# usage: python2.7 eventsink.py [port] [response delay in ms]
+
+import sys
+import time
+import json
+
+from tornado.ioloop import IOLoop, PeriodicCallback
+import tornado.web
+import tornado.gen
+
+from eventstats import EventStats
+
+PORT = 8888
+QUIET_SECS = 2.0
+
+class SinkHandler(tornado.web.RequestHandler):
+
+    def initialize(self,stats,delay):
+        self.stats = stats
+        self.delay = delay
+
+    @tornado.gen.coroutine
+    def respond(self,eventTypes,status=204):
+        self.stats.record(eventTypes)
+        if self.delay > 0:
+            # simulates Coordinator's processing time
+            yield tornado.gen.sleep(self.delay)
+        self.set_status(status)
+
+class NodesHandler(SinkHandler):
+
+    def post(self):
+        print("Node registered")
+
+    def put(self,nodeId=None):
+        pass
+
+    def delete(self,nodeId):
+        print("Node {} deregistered".format(nodeId))
+        self.set_status(204)
+
+class SessionsHandler(SinkHandler):
+
+    @tornado.gen.coroutine
+    def delete(self,sessId):
+        t = self.request.headers.get('X-Arras-Event-Type','sessionDelete')
+        yield self.respond([t])
+
+class HostsHandler(SinkHandler):
+
+    @tornado.gen.coroutine
+    def put(self,sessId,hostId):
+        yield self.respond(['computationReady'],200)
+
+    @tornado.gen.coroutine
+    def delete(self,sessId,hostId):
+        yield self.respond(['computationTerminated'])
+
+class OperationsHandler(SinkHandler):
+
+    @tornado.gen.coroutine
+    def put(self,sessId):
+        yield self.respond(['sessionOperationComplete'],200)
+
+class EventsHandler(SinkHandler):
+
+    @tornado.gen.coroutine
+    def post(self):
+        body = json.loads(self.request.body)
+        yield self.respond([e.get('eventType','unknown') for e in body['events']],200)
+
+class StatsHandler(tornado.web.RequestHandler):
+
+    def initialize(self,stats):
+        self.stats = stats
+
+    def get(self):
+        self.write(self.stats.summary())
+
+    def delete(self):
+        self.stats.reset()
+        self.set_status(204)
+
+def main():
+    port = int(sys.argv[1]) if len(sys.argv) > 1 else PORT
+    delay = float(sys.argv[2]) / 1000.0 if len(sys.argv) > 2 else 0.0
+    stats = EventStats()
+    args = dict(stats=stats,delay=delay)
+    uuid = r"([a-fA-F\-0-9]+)"
+    app = tornado.web.Application([
+        (r"/eventstats",StatsHandler,dict(stats=stats)),
+        (r"/coordinator/1/nodes",NodesHandler,args),
+        (r"/coordinator/1/nodes/"+uuid,NodesHandler,args),
+        (r"/coordinator/1/events",EventsHandler,args),
+        (r"/coordinator/1/sessions/"+uuid,SessionsHandler,args),
+        (r"/coordinator/1/sessions/"+uuid+"/operations",OperationsHandler,args),
+        (r"/coordinator/1/sessions/"+uuid+"/hosts/"+uuid,HostsHandler,args),
+        (r"/coordinator/1/sessions/"+uuid+"/computations/"+uuid,HostsHandler,args)
+    ])
+    app.listen(port)
+    print("Event sink listening on port {}, responding after {}ms".format(port,delay*1000))
+
+    # print the counts once a burst of events is over
+    state = {'shown': 0}
+    def check():
+        s = stats.summary()
+        if stats.last is not None and s['events'] != state['shown'] and \
+           time.time() - stats.last > QUIET_SECS:
+            stats.show()
+            state['shown'] = s['events']
+    PeriodicCallback(check,500).start()
+    IOLoop.current().start()
+
+if __name__ == "__main__":
+    main()
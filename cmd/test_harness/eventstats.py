@@ -0,0 +1,56 @@
+# Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+# SPDX-License-Identifier: Apache-2.0
+
+import threading
+import time
+
+class EventStats(object):
+    """Counts the events node sends to Coordinator, to measure how
+    quickly they arrive"""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.reset()
+
+    def reset(self):
+        with self.lock:
+            self.counts = {}
+            self.requests = 0
+            self.batches = 0
+            self.total = 0
+            self.first = None
+            self.last = None
+
+    # record a request carrying one or more events of the given types
+    def record(self,eventTypes):
+        now = time.time()
+        with self.lock:
+            self.requests += 1
+            if len(eventTypes) > 1:
+                self.batches += 1
+            for t in eventTypes:
+                self.counts[t] = self.counts.get(t,0) + 1
+                self.total += 1
+            if self.first is None:
+                self.first = now
+            self.last = now
+
+    def summary(self):
+        with self.lock:
+            elapsed = 0.0
+            if self.first is not None:
+                elapsed = self.last - self.first
+            rate = self.total / elapsed if elapsed > 0 else 0.0
+            return { 'events': self.total,
+                     'requests': self.requests,
+                     'batches': self.batches,
+                     'elapsedSecs': elapsed,
+                     'eventsPerSec': rate,
+                     'types': dict(self.counts) }
+
+    def show(self):
+        s = self.summary()
+        print("{} events in {} requests ({} batches) over {:.3f}s : {:.1f} events/s".format(
+            s['events'],s['requests'],s['batches'],s['elapsedSecs'],s['eventsPerSec']))
+        for (t,c) in sorted(s['types'].items()):
+            print("  {}: {}".format(t,c))
@@ -18,7 +18,10 @@ class CEMUService(tornado.web.Application):
              (r"/coordinator/1/sessions",SessionsHandler,dict(coord=coord)),
              (r"/coordinator/1/sessions/([a-fA-F\-0-9]+)",SessionsHandler,dict(coord=coord)),
              (r"/coordinator/1/sessions/([a-fA-F\-0-9]+)/hosts/([a-fA-F\-0-9]+)",HostsHandler,dict(coord=coord)),
-             (r"/coordinator/1/sessions/([a-fA-F\-0-9]+)/computations/([a-fA-F\-0-9]+)",HostsHandler,dict(coord=coord))
+             (r"/coordinator/1/sessions/([a-fA-F\-0-9]+)/computations/([a-fA-F\-0-9]+)",HostsHandler,dict(coord=coord)),
+             (r"/coordinator/1/sessions/([a-fA-F\-0-9]+)/operations",OperationsHandler,dict(coord=coord)),
+             (r"/coordinator/1/events",EventsHandler,dict(coord=coord)),
+             (r"/eventstats",EventStatsHandler,dict(coord=coord))
           ]
 
           super(CEMUService, self).__init__(
@@ -64,6 +67,7 @@ class SessionsHandler(BaseHandler):
          reason = "Unknown"
          if 'X-Session-Delete-Reason' in self.request.headers:
              reason = self.request.headers['X-Session-Delete-Reason']
+         self.coord.eventStats.record([self.request.headers.get('X-Arras-Event-Type','sessionDelete')])
          self.coord.session(sessId).deleteRequest(reason)
          self.set_status(204) # NO CONTENT
 
@@ -81,6 +85,7 @@ class HostsHandler(BaseHandler):
     def put(self,sessId,hostId):
         # node is notifying us that a computation(host)
         # is ready
+        self.coord.eventStats.record(['computationReady'])
         self.coord.session(sessId).hostReady(hostId)
 
     def delete(self,sessId,hostId):
@@ -89,4 +94,42 @@ class HostsHandler(BaseHandler):
         reason = "Unknown"
         if 'X-Host-Delete-Reason' in self.request.headers:
              reason = self.request.headers['X-Host-Delete-Reason']
+        self.coord.eventStats.record(['computationTerminated'])
         self.coord.session(sessId).hostExit(hostId,reason)
+
+class OperationsHandler(BaseHandler):
+
+    def put(self,sessId):
+        # node is reporting queued operations that have finished
+        req = json.loads(self.request.body)
+        self.coord.eventStats.record(['sessionOperationComplete'])
+        print("Session {} : {} operations {} {}".format(sessId,req['operation'],
+                                                      req['operationIds'],req['status']))
+
+class EventsHandler(BaseHandler):
+
+    def post(self):
+        # a batch of events for a session, in the order they happened
+        events = json.loads(self.request.body)['events']
+        self.coord.eventStats.record([e.get('eventType','unknown') for e in events])
+        for e in events:
+            t = e.get('eventType')
+            session = self.coord.session(e['sessionId'])
+            if t == 'computationReady':
+                session.hostReady(e['compId'])
+            elif t == 'computationTerminated':
+                session.hostExit(e['compId'],e.get('reason','Unknown'))
+            elif t == 'sessionOperationComplete':
+                print("Session {} : {} operations {} {}".format(e['sessionId'],e['operation'],
+                                                              e['operationIds'],e['status']))
+            elif t != 'shutdownWithError':
+                session.deleteRequest(e.get('reason',t))
+
+class EventStatsHandler(BaseHandler):
+
+    def get(self):
+        self.write(self.coord.eventStats.summary())
+
+    def delete(self):
+        self.coord.eventStats.reset()
+        self.set_status(204)
@@ -66,6 +66,8 @@ class Session(object):
         self.entryId = None
         self.filepath = None
         self.autoDelete = True
+        self.launchTime = None
+        self.startLatency = None
         
     def show(self,prefix=""):
         print("{}({}) session id {}".format(prefix,self.index,self.id))
@@ -156,6 +158,8 @@ class Session(object):
         
     def launch(self):
         (ncs,r) = self.genNodeReqData()
+        self.launchTime = time.time()
+        self.startLatency = None
         for (nid,nc) in ncs.iteritems():
             nd = { nid: nc,
                    "routing": r }
@@ -171,6 +175,8 @@ class Session(object):
 
     def modify(self):
         (ncs,r) = self.genNodeReqData()
+        self.launchTime = time.time()
+        self.startLatency = None
         for (nid,nc) in ncs.iteritems():
             nd = { nid: nc,
                    "routing": r }
@@ -215,6 +221,10 @@ class Session(object):
         c.ready = True
         print "{} is ready".format(c.name)
         self.readyCount += 1
+        # time from launch/modify request until the last computation is ready
+        if self.readyCount == len(self.computations)-1 and self.launchTime is not None:
+            self.startLatency = time.time() - self.launchTime
+            print("Session {} started in {:.2f}s".format(self.id,self.startLatency))
         
     def genNodeReqData(self):
         nodeConfigs = {}
@@ -260,6 +270,18 @@ class Session(object):
                             }
                         }
                     }
+        # optional per-session router memory limit, e.g.
+        # "memoryLimit": { "maxBytes": 100000000, "policy": "fail" }
+        if 'memoryLimit' in self.definition:
+            routing[self.id]['memoryLimit'] = self.definition['memoryLimit']
+        # optional list of message classes the client only needs the latest of, e.g.
+        # "clientConflation": [ "RenderedFrame" ]
+        if 'clientConflation' in self.definition:
+            routing[self.id]['clientConflation'] = self.definition['clientConflation']
+        # optional client queue watermarks for ClientCongestion messages, e.g.
+        # "clientCongestion": { "highWatermark": 100, "lowWatermark": 20 }
+        if 'clientCongestion' in self.definition:
+            routing[self.id]['clientCongestion'] = self.definition['clientCongestion']
         return (nodeConfigs,routing)
 
         
@@ -0,0 +1,25 @@
+# Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+# SPDX-License-Identifier: Apache-2.0
+
+# measures the time from session launch until every computation
+# is ready. Compare runs of a node started with --max-parallel-launches=1
+# (one computation after another) and the default
+import time
+from cemu import coord
+
+print("*> start node")
+print("*> measure(runs)")
+
+def measure(runs=3):
+    latencies = []
+    for i in range(runs):
+        s = coord.new("test4.sd")
+        s.alloc()
+        s.launch()
+        s.waitForReady()
+        latencies.append(s.startLatency)
+        s.delete("latency test")
+        # let the computations exit before the next run
+        time.sleep(5)
+    print("Start latency over {} runs : min {:.2f}s mean {:.2f}s max {:.2f}s".format(
+        runs, min(latencies), sum(latencies)/len(latencies), max(latencies)))
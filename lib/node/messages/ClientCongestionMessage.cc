@@ -0,0 +1,32 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "ClientCongestionMessage.h"
+
+namespace arras4 {
+namespace node {
+
+ARRAS_CONTENT_IMPL(ClientCongestion);
+
+void 
+ClientCongestion::serialize(api::DataOutStream& to) const
+{
+    to << mSessionId;
+    to << mCongested;
+    to << mQueuedMessages;
+    to << mQueuedBytes;
+    to << mDrainRate;
+}
+
+void
+ClientCongestion::deserialize(api::DataInStream& from, unsigned)
+{
+    from >> mSessionId;
+    from >> mCongested;
+    from >> mQueuedMessages;
+    from >> mQueuedBytes;
+    from >> mDrainRate;
+}
+
+}
+}
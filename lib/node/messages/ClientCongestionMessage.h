@@ -0,0 +1,36 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __ARRAS_CLIENTCONGESTIONMESSAGE_H__
+#define __ARRAS_CLIENTCONGESTIONMESSAGE_H__
+
+#include <message_api/ContentMacros.h>
+
+namespace arras4 {
+    namespace node {
+
+        // Sent by the entry node router to all computations in a session when
+        // the queue of messages waiting to go to the client crosses its high
+        // watermark (mCongested = true), and again when it falls back below
+        // the low watermark (mCongested = false). Computations can use this
+        // to reduce the rate or quality of what they send to the client.
+        // Only sent for sessions that set "clientCongestion" in their routing data.
+        struct ClientCongestion : public api::ObjectContent
+        {
+            ARRAS_CONTENT_CLASS(ClientCongestion, "5e0b7d2a-3c1f-4e86-a9d4-17b2c6f83e50",0);
+            ClientCongestion() {}
+            ~ClientCongestion() {}
+ 
+            void serialize(api::DataOutStream& to) const;
+            void deserialize(api::DataInStream& from, unsigned version);
+
+            api::UUID mSessionId;
+            bool mCongested = false;
+            unsigned mQueuedMessages = 0;        // messages waiting to be sent to the client
+            unsigned long long mQueuedBytes = 0; // size of those messages
+            float mDrainRate = 0.0f;             // messages per second recently sent to the client
+        };
+
+    } 
+} 
+#endif // __ARRAS_CLIENTCONGESTIONMESSAGE_H__
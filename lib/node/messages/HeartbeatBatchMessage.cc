@@ -0,0 +1,47 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "HeartbeatBatchMessage.h"
+
+namespace arras4 {
+namespace node {
+
+ARRAS_CONTENT_IMPL(HeartbeatBatchMessage);
+
+void 
+HeartbeatBatchMessage::serialize(api::DataOutStream& to) const
+{
+    to << static_cast<unsigned>(mEntries.size());
+    for (const Entry& entry : mEntries) {
+        to << entry.mSessionId;
+        to << entry.mComputationId;
+        // heartbeat version is written per entry so that batches
+        // remain readable if ExecutorHeartbeat is revised
+        to << entry.mHeartbeat->classVersion();
+        entry.mHeartbeat->serialize(to);
+    }
+}
+
+void
+HeartbeatBatchMessage::deserialize(api::DataInStream& from, unsigned)
+{
+    unsigned count;
+    from >> count;
+    mEntries.clear();
+    mEntries.reserve(count);
+    for (unsigned i = 0; i < count; i++) {
+        Entry entry;
+        from >> entry.mSessionId;
+        from >> entry.mComputationId;
+        unsigned version;
+        from >> version;
+        impl::ExecutorHeartbeat* heartbeat = new impl::ExecutorHeartbeat();
+        entry.mHeartbeat.reset(heartbeat);
+        heartbeat->deserialize(from, version);
+        mEntries.push_back(entry);
+    }
+}
+
+}
+}
+
@@ -0,0 +1,42 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __ARRAS_HEARTBEATBATCHMESSAGE_H__
+#define __ARRAS_HEARTBEATBATCHMESSAGE_H__
+
+#include <message_api/ContentMacros.h>
+#include <core_messages/ExecutorHeartbeat.h>
+#include <vector>
+
+namespace arras4 {
+    namespace node {
+
+        // Sent periodically from router to NodeService, carrying the most 
+        // recent ExecutorHeartbeat received from each computation during 
+        // the interval. Replaces forwarding every individual heartbeat.
+        struct HeartbeatBatchMessage : public api::ObjectContent
+        {
+            ARRAS_CONTENT_CLASS(HeartbeatBatchMessage, "5d3e1c2a-8f4b-4e6a-9b71-2c0d9a6e4f13",0);
+
+            struct Entry {
+                Entry() {}
+                Entry(const api::UUID& sessionId, const api::UUID& compId,
+                      const impl::ExecutorHeartbeat::ConstPtr& heartbeat)
+                    : mSessionId(sessionId), mComputationId(compId), mHeartbeat(heartbeat) {}
+                api::UUID mSessionId;
+                api::UUID mComputationId;
+                impl::ExecutorHeartbeat::ConstPtr mHeartbeat;
+            };
+
+            HeartbeatBatchMessage() {}
+            ~HeartbeatBatchMessage() {}
+ 
+            void serialize(api::DataOutStream& to) const;
+            void deserialize(api::DataInStream& from, unsigned version);
+
+            std::vector<Entry> mEntries;
+        };
+
+    } 
+} 
+#endif // __ARRAS_HEARTBEATBATCHMESSAGE_H__
@@ -0,0 +1,24 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "NodeNetworkMessage.h"
+
+namespace arras4 {
+namespace node {
+
+ARRAS_CONTENT_IMPL(NodeNetworkMessage);
+
+void 
+NodeNetworkMessage::serialize(api::DataOutStream& to) const
+{
+    to << mReport;
+}
+
+void
+NodeNetworkMessage::deserialize(api::DataInStream& from, unsigned)
+{
+    from >> mReport;
+}
+
+}
+}
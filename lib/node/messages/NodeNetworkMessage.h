@@ -0,0 +1,31 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __ARRAS_NODENETWORKMESSAGE_H__
+#define __ARRAS_NODENETWORKMESSAGE_H__
+
+#include <message_api/ContentMacros.h>
+#include <string>
+
+namespace arras4 {
+    namespace node {
+
+        // Sent periodically from router to NodeService with the latest
+        // measurements of the links to other nodes, made with NodeProbeMessage.
+        // mReport is a JSON object keyed by node id : see NodeProber::report()
+        // in the router
+        struct NodeNetworkMessage : public api::ObjectContent
+        {
+            ARRAS_CONTENT_CLASS(NodeNetworkMessage, "a3d61f08-2c5e-47b9-9e14-7f80b2c6d5a1",0);
+            NodeNetworkMessage() {}
+            ~NodeNetworkMessage() {}
+ 
+            void serialize(api::DataOutStream& to) const;
+            void deserialize(api::DataInStream& from, unsigned version);
+
+            std::string mReport;
+        };
+
+    } 
+} 
+#endif // __ARRAS_NODENETWORKMESSAGE_H__
@@ -0,0 +1,30 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "NodeProbeMessage.h"
+
+namespace arras4 {
+namespace node {
+
+ARRAS_CONTENT_IMPL(NodeProbeMessage);
+
+void 
+NodeProbeMessage::serialize(api::DataOutStream& to) const
+{
+    to << mProbeId;
+    to << mReply;
+    to << mRequestSize;
+    to << mPadding;
+}
+
+void
+NodeProbeMessage::deserialize(api::DataInStream& from, unsigned)
+{
+    from >> mProbeId;
+    from >> mReply;
+    from >> mRequestSize;
+    from >> mPadding;
+}
+
+}
+}
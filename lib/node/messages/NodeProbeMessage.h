@@ -0,0 +1,35 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __ARRAS_NODEPROBEMESSAGE_H__
+#define __ARRAS_NODEPROBEMESSAGE_H__
+
+#include <message_api/ContentMacros.h>
+#include <string>
+
+namespace arras4 {
+    namespace node {
+
+        // Sent between routers over node-to-node connections to measure the
+        // link between them. Requests are echoed back by the receiving router
+        // as replies, without the padding. Bandwidth probes carry padding so
+        // that the request takes a measurable time to transfer.
+        // Probes are not routed, and are never delivered to computations.
+        struct NodeProbeMessage : public api::ObjectContent
+        {
+            ARRAS_CONTENT_CLASS(NodeProbeMessage, "5e0b7c2d-91f4-4a6e-b3d8-0c47e1a9f263",0);
+            NodeProbeMessage() {}
+            ~NodeProbeMessage() {}
+ 
+            void serialize(api::DataOutStream& to) const;
+            void deserialize(api::DataInStream& from, unsigned version);
+
+            unsigned mProbeId = 0;      // chosen by the sender, echoed in the reply
+            bool mReply = false;
+            unsigned mRequestSize = 0;  // padding size of the request, echoed in the reply
+            std::string mPadding;
+        };
+
+    } 
+} 
+#endif // __ARRAS_NODEPROBEMESSAGE_H__
@@ -0,0 +1,27 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "SessionFailureMessage.h"
+
+namespace arras4 {
+namespace node {
+
+ARRAS_CONTENT_IMPL(SessionFailureMessage);
+
+void 
+SessionFailureMessage::serialize(api::DataOutStream& to) const
+{
+    to << mSessionId;
+    to << mReason;
+}
+
+void
+SessionFailureMessage::deserialize(api::DataInStream& from, unsigned)
+{
+    from >> mSessionId;
+    from >> mReason;
+}
+
+}
+}
+
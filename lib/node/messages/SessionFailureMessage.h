@@ -0,0 +1,32 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __ARRAS_SESSIONFAILUREMESSAGE_H__
+#define __ARRAS_SESSIONFAILUREMESSAGE_H__
+
+#include <message_api/ContentMacros.h>
+#include <string>
+
+namespace arras4 {
+    namespace node {
+
+        // Sent from router to NodeService when the router can no longer
+        // support a session, e.g. because it exceeded its memory limit.
+        // NodeService asks Coordinator to delete the session.
+        struct SessionFailureMessage : public api::ObjectContent
+        {
+            ARRAS_CONTENT_CLASS(SessionFailureMessage, "a4c27e0b-1d6f-4b38-95e2-7f3b8c61d0a9",0);
+            SessionFailureMessage() {}
+            ~SessionFailureMessage() {}
+ 
+            void serialize(api::DataOutStream& to) const;
+            void deserialize(api::DataInStream& from, unsigned version);
+
+            api::UUID mSessionId;
+            std::string mReason;
+        };
+
+    } 
+} 
+#endif // __ARRAS_SESSIONFAILUREMESSAGE_H__
+
@@ -0,0 +1,28 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "SessionTrafficMessage.h"
+
+namespace arras4 {
+namespace node {
+
+ARRAS_CONTENT_IMPL(SessionTrafficMessage);
+
+void 
+SessionTrafficMessage::serialize(api::DataOutStream& to) const
+{
+    to << mSessionId;
+    to << mFinal;
+    to << mReport;
+}
+
+void
+SessionTrafficMessage::deserialize(api::DataInStream& from, unsigned)
+{
+    from >> mSessionId;
+    from >> mFinal;
+    from >> mReport;
+}
+
+}
+}
@@ -0,0 +1,35 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __ARRAS_SESSIONTRAFFICMESSAGE_H__
+#define __ARRAS_SESSIONTRAFFICMESSAGE_H__
+
+#include <message_api/ContentMacros.h>
+#include <string>
+
+namespace arras4 {
+    namespace node {
+
+        // Sent from router to NodeService with a summary of the message
+        // traffic the router has handled for a session. A snapshot is sent
+        // just before a client disconnect is reported (so it can be attached
+        // to the "sessionClientDisconnected" event), and the final summary
+        // when the session's routing data is deleted.
+        // mReport is a JSON object : see SessionTraffic::report() in the router
+        struct SessionTrafficMessage : public api::ObjectContent
+        {
+            ARRAS_CONTENT_CLASS(SessionTrafficMessage, "c81f5d3e-6a27-4b90-8e1c-3d9a72b4f615",0);
+            SessionTrafficMessage() {}
+            ~SessionTrafficMessage() {}
+ 
+            void serialize(api::DataOutStream& to) const;
+            void deserialize(api::DataInStream& from, unsigned version);
+
+            api::UUID mSessionId;
+            bool mFinal = false;    // true when the session has been deleted
+            std::string mReport;
+        };
+
+    } 
+} 
+#endif // __ARRAS_SESSIONTRAFFICMESSAGE_H__
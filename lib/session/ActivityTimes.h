@@ -0,0 +1,43 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __ARRAS4_ACTIVITY_TIMES_H__
+#define __ARRAS4_ACTIVITY_TIMES_H__
+
+#include <atomic>
+
+namespace arras4 {
+    namespace node {
+
+// ActivityTimes holds the time (epoch secs) of the most recent activity
+// on a session, or on all the sessions of a node. It is updated as the
+// activity happens, so reading it doesn't need to visit every session
+// and computation. "Session" activity is operations or signals acting on
+// a session as a whole : "all" activity also includes messages to/from
+// computations
+class ActivityTimes
+{
+public:
+    void update(long secs, bool fromComputation) {
+        if (!fromComputation)
+            raise(mSession, secs);
+        raise(mAll, secs);
+    }
+
+    long get(bool includeComputations) const {
+        return includeComputations ? mAll.load() : mSession.load();
+    }
+
+private:
+    static void raise(std::atomic<long>& time, long secs) {
+        long current = time.load();
+        while (secs > current && !time.compare_exchange_weak(current, secs)) {}
+    }
+
+    std::atomic<long> mSession{0};
+    std::atomic<long> mAll{0};
+};
+
+}
+}
+#endif
@@ -9,6 +9,10 @@
 #include <node/messages/ComputationStatusMessage.h>
 #include <node/messages/RouterInfoMessage.h>
 #include <node/messages/ClientConnectionStatusMessage.h>
+#include <node/messages/HeartbeatBatchMessage.h>
+#include <node/messages/NodeNetworkMessage.h>
+#include <node/messages/SessionFailureMessage.h>
+#include <node/messages/SessionTrafficMessage.h>
 #include "EventHandler.h"
 
 #include <execute/ProcessManager.h>
@@ -77,6 +81,38 @@ bool ArrasController::startRouter(const ComputationDefaults& defaults,
     sa.args.push_back(defaults.athenaHost);
     sa.args.push_back("--athena-port");
     sa.args.push_back(std::to_string(defaults.athenaPort));
+    sa.args.push_back("--receiveMode");
+    sa.args.push_back(defaults.routerReceiveMode);
+    if (defaults.routerProbeInterval) {
+        sa.args.push_back("--probeInterval");
+        sa.args.push_back(std::to_string(defaults.routerProbeInterval));
+    }
+    if (defaults.routerShards > 1) {
+        sa.args.push_back("--shards");
+        sa.args.push_back(std::to_string(defaults.routerShards));
+    }
+    if (defaults.routerMapPayloadsOver) {
+        sa.args.push_back("--mapPayloadsOver");
+        sa.args.push_back(std::to_string(defaults.routerMapPayloadsOver));
+    }
+    if (!defaults.routerBusyPollCpus.empty()) {
+        sa.args.push_back("--busyPollCpus");
+        sa.args.push_back(defaults.routerBusyPollCpus);
+        sa.args.push_back("--busyPollIdleMs");
+        sa.args.push_back(std::to_string(defaults.routerBusyPollIdleMs));
+        if (defaults.routerBusyPollAllSessions)
+            sa.args.push_back("--busyPollAllSessions");
+    }
+    if (!defaults.routerCaptureDir.empty()) {
+        sa.args.push_back("--captureDir");
+        sa.args.push_back(defaults.routerCaptureDir);
+    }
+    if (!defaults.routerTraceSpans.empty()) {
+        sa.args.push_back("--traceSpans");
+        sa.args.push_back(defaults.routerTraceSpans);
+        sa.args.push_back("--traceSampleRate");
+        sa.args.push_back(std::to_string(defaults.routerTraceSampleRate));
+    }
     sa.environment.setFromCurrent();
     sa.setCurrentWorkingDirectory();
     
@@ -203,10 +239,16 @@ ArrasController::handleMessage(const api::Message& message)
 		    kickClient(msg->mSessionId,"sessionDeleted",session->getDeleteReason());
 		}
 	    } else {
-		// attempted connection to an unknown id causes the client
-		// to be immediately kicked. In this case there is no "execStoppedReason"
-		// to report
-		 kickClient(msg->mSessionId,"unknownSession","unknownSession");
+		std::string deleteReason;
+		if (mSessions.getDeletedSession(msg->mSessionId,deleteReason)) {
+		    // the same race, after the defunct session has been discarded
+		    kickClient(msg->mSessionId,"sessionDeleted",deleteReason);
+		} else {
+		    // attempted connection to an unknown id causes the client
+		    // to be immediately kicked. In this case there is no "execStoppedReason"
+		    // to report
+		    kickClient(msg->mSessionId,"unknownSession","unknownSession");
+		}
 	    }
 	} else {
 	    // client has disconnected : generate event
@@ -214,10 +256,74 @@ ArrasController::handleMessage(const api::Message& message)
 	    api::Object data;
 	    data["eventType"] = "sessionClientDisconnected";
 	    data["reason"] = msg->mReason;
+	    attachTrafficReport(msg->mSessionId,data);
+	    handleEvent(msg->mSessionId,api::UUID(),data);
+	}
+    } else if (message.classId() == SessionFailureMessage::ID) {
+	// router can no longer support the session (e.g. memory limit exceeded) :
+	// generate event to have the session deleted
+	SessionFailureMessage::ConstPtr msg = message.contentAs<SessionFailureMessage>();
+	if (msg) {
+	    ARRAS_ERROR(log::Id("SessionRouterFailure") <<
+			log::Session(msg->mSessionId.toString()) <<
+			"Router failed session : " << msg->mReason);
+	    api::Object data;
+	    data["eventType"] = "sessionRouterFailure";
+	    data["reason"] = msg->mReason;
+	    attachTrafficReport(msg->mSessionId,data);
 	    handleEvent(msg->mSessionId,api::UUID(),data);
 	}
+    } else if (message.classId() == SessionTrafficMessage::ID) {
+	// summary of the session's message traffic through the router. A snapshot
+	// arrives just before a client disconnect, and the final summary when the
+	// session's routing data is deleted
+	SessionTrafficMessage::ConstPtr msg = message.contentAs<SessionTrafficMessage>();
+	if (msg && msg->mFinal) {
+	    ARRAS_INFO(log::Session(msg->mSessionId.toString()) <<
+		       "Session traffic : " << msg->mReport);
+	    {
+		std::unique_lock<std::mutex> lock(mMutex);
+		mTrafficReports.erase(msg->mSessionId.toString());
+	    }
+	    // the final summary is kept by the session, which reports it in
+	    // its status and in the "sessionShutdown" event
+	    Session::Ptr session = mSessions.getSession(msg->mSessionId);
+	    if (session) {
+		api::Object summary;
+		try {
+		    api::stringToObject(msg->mReport, summary);
+		    session->setTrafficSummary(summary);
+		} catch (std::exception& e) {
+		    ARRAS_WARN(log::Id("BadTrafficReport") <<
+			       log::Session(msg->mSessionId.toString()) <<
+			       "Invalid session traffic report from router: " << e.what());
+		}
+	    }
+	} else if (msg) {
+	    std::unique_lock<std::mutex> lock(mMutex);
+	    mTrafficReports[msg->mSessionId.toString()] = msg->mReport;
+	}
+    } else if (message.classId() == NodeNetworkMessage::ID) {
+	// router periodically sends its latest measurements of the links to other nodes
+	NodeNetworkMessage::ConstPtr msg = message.contentAs<NodeNetworkMessage>();
+	if (msg) {
+	    std::unique_lock<std::mutex> lock(mMutex);
+	    mNodeNetwork = msg->mReport;
+	}
+    } else if (message.classId() == HeartbeatBatchMessage::ID) {
+	// router periodically sends the latest heartbeat from each computation
+	// as a single batch
+	HeartbeatBatchMessage::ConstPtr batch = message.contentAs<HeartbeatBatchMessage>();
+	if (batch) {
+	    for (const HeartbeatBatchMessage::Entry& entry : batch->mEntries) {
+		Computation::Ptr cp = mSessions.getComputation(entry.mSessionId,entry.mComputationId);
+		if (cp && entry.mHeartbeat)
+		    cp->onHeartbeat(entry.mHeartbeat);
+	    }
+	}
     } else if (message.classId() == impl::ExecutorHeartbeat::ID) {
 	// performance stats being send from a computation via the router
+	// (routers that predate HeartbeatBatchMessage)
 	impl::ExecutorHeartbeat::ConstPtr msg = message.contentAs<impl::ExecutorHeartbeat>();
 	// message doesn't have "from" ids, so get it from message metadata
 	api::Object fromVal = message.get("from");
@@ -386,6 +492,30 @@ void ArrasController::sessionOperationFailed(const api::UUID& sessionId,
     api::Object data;
     data["eventType"] = "sessionOperationFailed";
     data["reason"] = message;
+    attachTrafficReport(sessionId,data);
+    handleEvent(sessionId,api::UUID(),data);
+}
+
+// generate an event when a queued operation on a session has finished, for
+// sessions that have opted in to queueing. 'operationIds' lists the requests
+// it accounted for, and 'status' is "complete", "failed", "superseded"
+// (i.e. replaced by a delete before it could start) or "cancelled" (not
+// started because the node is shutting down)
+void ArrasController::sessionOperationComplete(const api::UUID& sessionId,
+					       const std::string& opname,
+					       api::ObjectConstRef operationIds,
+					       const std::string& status)
+{
+    ARRAS_DEBUG(log::Session(sessionId.toString()) <<
+		"Session operation '" << opname << "' " << status << " : " <<
+		api::objectToString(operationIds));
+    api::Object data;
+    data["eventType"] = "sessionOperationComplete";
+    // operation ids are only unique within the session on this node
+    data["nodeId"] = mNodeId.toString();
+    data["operation"] = opname;
+    data["operationIds"] = operationIds;
+    data["status"] = status;
     handleEvent(sessionId,api::UUID(),data);
 }
 
@@ -401,8 +531,67 @@ void ArrasController::sessionExpired(const api::UUID& sessionId,
     api::Object data;
     data["eventType"] = "sessionExpired";
     data["reason"] = message;
+    attachTrafficReport(sessionId,data);
     handleEvent(sessionId,api::UUID(),data);
 }
 
+// generate an event when a session has been shut down because the node
+// is exiting. This replaces the computationTerminated events of its
+// computations, which are listed in the event instead
+void ArrasController::sessionShutdown(const api::UUID& sessionId,
+				      const std::string& reason,
+				      api::ObjectConstRef computationReports,
+				      api::ObjectConstRef traffic)
+{
+    api::Object data;
+    data["eventType"] = "sessionShutdown";
+    data["reason"] = reason;
+    data["computations"] = computationReports;
+    if (traffic.isNull())
+	attachTrafficReport(sessionId,data);
+    else
+	data["traffic"] = traffic;
+    handleEvent(sessionId,api::UUID(),data);
+}
+
+void ArrasController::attachTrafficReport(const api::UUID& sessionId,
+					  api::Object& eventData)
+{
+    std::string report;
+    {
+	std::unique_lock<std::mutex> lock(mMutex);
+	auto it = mTrafficReports.find(sessionId.toString());
+	if (it == mTrafficReports.end())
+	    return;
+	report = it->second;
+    }
+    try {
+	api::stringToObject(report, eventData["traffic"]);
+    } catch (std::exception& e) {
+	ARRAS_WARN(log::Id("BadTrafficReport") <<
+		   log::Session(sessionId.toString()) <<
+		   "Invalid session traffic report from router: " << e.what());
+    }
+}
+
+api::Object ArrasController::nodeNetwork()
+{
+    std::string report;
+    {
+	std::unique_lock<std::mutex> lock(mMutex);
+	report = mNodeNetwork;
+    }
+    api::Object network(Json::objectValue);
+    if (report.empty())
+	return network;
+    try {
+	api::stringToObject(report, network);
+    } catch (std::exception& e) {
+	ARRAS_WARN(log::Id("BadNodeNetworkReport") <<
+		   "Invalid node network report from router: " << e.what());
+    }
+    return network;
+}
+
 }
 }
@@ -52,8 +52,18 @@ public:
     void sessionOperationFailed(const api::UUID& sessionId,
 				const std::string& opname,
 				const std::string& message); 
+    void sessionOperationComplete(const api::UUID& sessionId,
+				  const std::string& opname,
+				  api::ObjectConstRef operationIds,
+				  const std::string& status);
     void sessionExpired(const api::UUID& sessionId,
 			const std::string& message);
+    // traffic is the session's final traffic summary, or null if it
+    // hasn't arrived (the latest snapshot is sent instead)
+    void sessionShutdown(const api::UUID& sessionId,
+			 const std::string& reason,
+			 api::ObjectConstRef computationReports,
+			 api::ObjectConstRef traffic);
     void setEventHandler(EventHandler* handler) { mEventHandler = handler; }
     void handleEvent(const api::UUID& sessionId,
 			 const api::UUID& compId,
@@ -78,9 +88,16 @@ public:
 
     unsigned routerInetPort() { return mRouterInetPort; }
 
+    // latest measurements of the links to other nodes, made by the router :
+    // an object keyed by node id (empty if there are none yet)
+    api::Object nodeNetwork();
+
 private:
     void kickClient(const api::UUID& sessionId, const std::string& kickReason,
 		   const std::string& stoppedReason);
+    // add the latest router traffic summary for the session (if any) to
+    // the data of a session termination event, as "traffic"
+    void attachTrafficReport(const api::UUID& sessionId, api::Object& eventData);
 
     api::UUID mNodeId;
     ArrasSessions& mSessions;
@@ -95,6 +112,8 @@ private:
     // following data is mutex locked
     std::mutex mMutex;
     std::map<std::string, bool> mRouterHasRoutingData;
+    std::map<std::string, std::string> mTrafficReports; // by session id
+    std::string mNodeNetwork;
     std::condition_variable mCondition;
 
     // true if arras controller is exiting or shutting down
@@ -9,6 +9,11 @@
 #include <http/http_types.h>
 #include <execute/ProcessManager.h>
 
+#include <algorithm>
+#include <system_error>
+#include <thread>
+#include <vector>
+
 #include <unistd.h>
 #include <sys/time.h>
 
@@ -21,7 +26,12 @@ ArrasSessions::ArrasSessions(impl::ProcessManager& processManager,
                              const ComputationDefaults& defaults,
                              const api::UUID& nodeId) :
     mProcessManager(processManager), mDefaults(defaults),
-    mNodeId(nodeId)
+    mNodeId(nodeId),
+    mRezCache(defaults.rezCacheDir, defaults.rezCacheTtlSecs,
+              defaults.rezCacheMaxBytes),
+    mRezPrewarmer(mRezCache, processManager),
+    mExecutor(defaults.sessionOpThreads, defaults.sessionBlockingOpThreads,
+              defaults.launchThreads)
 {
     mController = std::make_shared<ArrasController>(nodeId,*this);
     mProcessManager.setProcessController(mController);
@@ -47,6 +57,9 @@ ArrasSessions::ArrasSessions(impl::ProcessManager& processManager,
     timeval now;
     gettimeofday(&now,nullptr);
     mStartTimeSecs = now.tv_sec;
+
+    mRezPrewarmer.start(defaults.rezPrewarmCount,
+                        defaults.rezPrewarmIntervalSecs);
 }
 
 void ArrasSessions::run()
@@ -74,6 +87,61 @@ Session::Ptr ArrasSessions::getSession_wlock(const api::UUID& id)
     return it->second;
 }
 
+bool ArrasSessions::getDeletedSession(const api::UUID& id,
+                                      std::string& deleteReason) const
+{
+    std::lock_guard<std::mutex> lock(mSessionsMutex);
+    auto it = mTombstones.find(id);
+    if (it == mTombstones.end())
+        return false;
+    deleteReason = it->second.deleteReason;
+    return true;
+}
+
+// discard sessions that have been defunct for long enough, leaving a
+// tombstone, and expire old tombstones. The sessions are passed back
+// so that they are destroyed after the lock is released
+void ArrasSessions::reclaimSessions_wlock(std::vector<Session::Ptr>& reclaimed)
+{
+    const size_t MAX_TOMBSTONES = 10000;
+
+    timeval now;
+    gettimeofday(&now, nullptr);
+    for (auto it = mSessions.begin(); it != mSessions.end(); ) {
+        if (it->second->isReclaimable(now.tv_sec, mDefaults.defunctSessionGraceSecs)) {
+            ARRAS_DEBUG(log::Session(it->first.toString()) << "Discarding defunct session");
+            unsigned long long seq = mTombstoneSequence++;
+            mTombstones[it->first] = Tombstone{it->second->getDeleteReason(), now.tv_sec, seq};
+            mTombstoneOrder.emplace_back(it->first, seq);
+            reclaimed.push_back(it->second);
+            it = mSessions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    while (!mTombstoneOrder.empty()) {
+        auto it = mTombstones.find(mTombstoneOrder.front().first);
+        bool current = it != mTombstones.end() &&
+            it->second.sequence == mTombstoneOrder.front().second;
+        if (current &&
+            mTombstoneOrder.size() <= MAX_TOMBSTONES &&
+            now.tv_sec - it->second.reclaimedSecs < static_cast<long>(mDefaults.sessionTombstoneSecs))
+            break;
+        if (current)
+            mTombstones.erase(it);
+        mTombstoneOrder.pop_front();
+    }
+}
+
+void ArrasSessions::reclaimSessions()
+{
+    std::vector<Session::Ptr> reclaimed;
+    std::lock_guard<std::mutex> lock(mSessionsMutex);
+    reclaimSessions_wlock(reclaimed);
+    // 'reclaimed' is declared first, so the sessions are destroyed
+    // after the lock is released
+}
+
 Computation::Ptr ArrasSessions::getComputation(const api::UUID& sessionId, 
 					       const api::UUID& id)
 {
@@ -145,6 +213,8 @@ api::Object ArrasSessions::createSession(api::ObjectConstRef definition)
     ARRAS_ATHENA_TRACE(0,log::Session(id.toString()) <<
 		       "{trace:session} create " << id.toString());
 
+    reclaimSessions();
+
     Session::Ptr session;
     {
         std::lock_guard<std::mutex> lock(mSessionsMutex);
@@ -152,7 +222,9 @@ api::Object ArrasSessions::createSession(api::ObjectConstRef definition)
         if (session) 
             throw SessionError("Session already exists",HTTP_RESOURCE_CONFLICT);
         session = std::make_shared<Session>(id, mNodeId, mDefaults,
-                                            mProcessManager,*mController);
+                                            mProcessManager,*mController,
+                                            mRezCache,mActivity,mTimers,
+                                            mExecutor);
         mSessions[id] = session;
     }
     bool ok = mController->initializeSession(*config);
@@ -172,16 +244,20 @@ api::Object ArrasSessions::createSession(api::ObjectConstRef definition)
 	auto expiry = std::chrono::steady_clock::now() +  std::chrono::seconds(mDefaults.clientConnectionTimeoutSecs);
 	session->setExpirationTime(expiry,"Client failed to connect");
     }
+    Session::OperationId opId = 0;
     try {
 	ARRAS_DEBUG(log::Session(id.toString()) <<
 		   "About to spawn computations");
-        session->asyncUpdateConfig(config);
+        opId = session->asyncUpdateConfig(config);
     } catch (...) {
         std::lock_guard<std::mutex> lock(mSessionsMutex);
         mSessions.erase(id);
         throw;
     }
-    return config->getResponse();
+    api::Object reply = config->getResponse();
+    if (opId)
+        reply["operationId"] = static_cast<Json::UInt64>(opId);
+    return reply;
 }
 
 api::Object ArrasSessions::modifySession(api::ObjectConstRef definition)
@@ -198,71 +274,105 @@ api::Object ArrasSessions::modifySession(api::ObjectConstRef definition)
     if (!session) 
         throw SessionError("Session doesn't exist",
                            HTTP_NOT_FOUND);
-    session->asyncUpdateConfig(config);
-    return config->getResponse();
+    Session::OperationId opId = session->asyncUpdateConfig(config);
+    api::Object reply = config->getResponse();
+    if (opId)
+        reply["operationId"] = static_cast<Json::UInt64>(opId);
+    return reply;
 }
 
 // delete a session : 'reason' is arbitrary text used for logging
-// throws SessionError if session doesn't exist 
-void ArrasSessions::deleteSession(const api::UUID& id,
+// throws SessionError if session doesn't exist. Returns the operation
+// id if the session queues operations, otherwise 0
+Session::OperationId ArrasSessions::deleteSession(const api::UUID& id,
                                   const std::string& reason)
 {
+    std::vector<Session::Ptr> reclaimed;
     std::lock_guard<std::mutex> lock(mSessionsMutex);
     Session::Ptr session = getSession_wlock(id);
-    if (!session)
+    if (!session) {
+        if (mTombstones.count(id))
+            throw SessionError("Session is defunct and cannot be deleted",
+                               HTTP_RESOURCE_CONFLICT);
         throw SessionError("Session doesn't exist",
                            HTTP_NOT_FOUND); 
+    }
     ARRAS_ATHENA_TRACE(0,log::Session(id.toString()) <<
 		       "{trace:session} delete " << id.toString());
 
-    session->asyncDelete(reason);
+    Session::OperationId opId = session->asyncDelete(reason);
     // session cannot be removed from mSessions until async
-    // operation completes : currently we don't bother and
-    // keep the information indefinitely, marked by
-    // state "Defunct"
+    // operation completes : it is then marked "Defunct", and
+    // discarded by a later reclaimSessions, after a grace period
+    reclaimSessions_wlock(reclaimed);
+    return opId;
 }
 
 long ArrasSessions::getLastActivitySecs(bool includeComputations) const
 {
-    long ret = 0;
-    std::lock_guard<std::mutex> lock(mSessionsMutex);
-    for (auto it = mSessions.begin(); it != mSessions.end(); ++it) {
-        long sla = it->second->getLastActivitySecs(includeComputations);
-	if (sla > ret) ret = sla;
-    }
-    return ret; 
+    return mActivity.get(includeComputations);
 }
 
-void ArrasSessions::getIdleStatus(api::ObjectRef out) const
+void ArrasSessions::getIdleStatus(api::ObjectRef out)
 {
+    reclaimSessions();
+
     timeval now;
     gettimeofday(&now, nullptr);
-    long mostRecent = mStartTimeSecs;
+    long mostRecent = std::max(mStartTimeSecs, mActivity.get(true));
     int index = 0;
     std::lock_guard<std::mutex> lock(mSessionsMutex);
-    for (auto it = mSessions.begin(); it != mSessions.end(); ++it) {
+    for (auto it = mSessions.begin(); it != mSessions.end(); ++it, ++index) {
         long sla = it->second->getLastActivitySecs(true);
-	if (sla > mostRecent) mostRecent = sla;
 	out["sessions"][index]["id"] = it->second->id().toString();
 	out["sessions"][index]["idletime"] = static_cast<int>(now.tv_sec - sla);
     }
     out["idletime"] =  static_cast<int>(now.tv_sec - mostRecent);
 }
 
-void ArrasSessions::shutdownAll(const std::string& reason)
+void ArrasSessions::shutdownAll(const std::string& reason,
+                                std::chrono::milliseconds timeout)
 {
     ARRAS_DEBUG("Shutting down all sessions");
     mClosed = true;
-    std::lock_guard<std::mutex> lock(mSessionsMutex);
-    for (const auto& item : mSessions) {
+    // a resolve in progress can take several seconds : only join the
+    // prewarmer once the sessions have been shut down
+    mRezPrewarmer.requestStop();
+
+    // every session gets the whole of the time available, so that
+    // computations all get terminated at once, and a slow one doesn't
+    // hold up the others
+    std::chrono::steady_clock::time_point endtime =
+        std::chrono::steady_clock::now() + timeout;
+    std::vector<Session::Ptr> sessions;
+    {
+        std::lock_guard<std::mutex> lock(mSessionsMutex);
+        for (const auto& item : mSessions)
+            sessions.push_back(item.second);
+    }
+
+    auto shutdown = [&reason,endtime](const Session::Ptr& session) {
 	try {
-	    item.second->syncShutdown(reason);
+	    session->syncShutdown(reason,endtime);
 	} catch (SessionError& se) {
 	    ARRAS_WARN(log::Id("SessionShutdownFailed") <<
-		       log::Session(item.first.toString()) <<
+		       log::Session(session->id().toString()) <<
 		       "Failed to shutdown session : " << se.what());
 	}
+    };
+    std::vector<std::thread> threads;
+    for (const Session::Ptr& session : sessions) {
+        try {
+            threads.emplace_back(shutdown,session);
+        } catch (const std::system_error&) {
+            // no more threads : do it here instead
+            shutdown(session);
+        }
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
     }
+    mRezPrewarmer.stop();
     ARRAS_DEBUG("Have shut down all sessions");
 }
 
@@ -6,6 +6,9 @@
 
 #include "Session.h"
 #include "ArrasController.h"
+#include "RezContextCache.h"
+#include "RezPrewarmer.h"
+#include "TimerWheel.h"
 
 #include <message_api/UUID.h>
 #include <message_api/Object.h>
@@ -13,6 +16,10 @@
 #include <map>
 #include <memory>
 #include <atomic>
+#include <deque>
+#include <string>
+#include <vector>
+#include <chrono>
 
 namespace arras4 {
     namespace node {
@@ -28,6 +35,9 @@ public:
                   const api::UUID& nodeId);
 
     Session::Ptr getSession(const api::UUID& id);
+    // for a session that has been deleted and discarded, returns true and the
+    // reason it was deleted (for as long as a record of it is kept)
+    bool getDeletedSession(const api::UUID& id, std::string& deleteReason) const;
     Computation::Ptr getComputation(const api::UUID& sessionId,const api::UUID& id);
 
     std::vector<api::UUID> activeSessionIds() const;
@@ -38,10 +48,14 @@ public:
                        api::ObjectConstRef signalData);
     api::Object createSession(api::ObjectConstRef definition);
     api::Object modifySession(api::ObjectConstRef definition);
-    void deleteSession(const api::UUID& id,
-                       const std::string& reason);
+    // operations return an operation id for sessions that queue operations
+    // (see Session::asyncUpdateConfig), as "operationId" in the reply
+    Session::OperationId deleteSession(const api::UUID& id,
+                                       const std::string& reason);
 
     void setClosed(bool closed) { mClosed = closed; }
+
+    const api::UUID& nodeId() const { return mNodeId; }
     
     std::shared_ptr<ArrasController> getController() { return mController; }
 
@@ -49,18 +63,26 @@ public:
     void run();         
     void stopRunning();
 
-    // synchronously shut down all sessions
-    void shutdownAll(const std::string& reason);
+    // synchronously shut down all sessions, in parallel,
+    // giving up after timeout
+    void shutdownAll(const std::string& reason,
+                     std::chrono::milliseconds timeout);
 
     // get last activity time (epoch secs) on any session
     long getLastActivitySecs(bool includeComputations) const;
     // collect idle times (now - last activity) in seconds
     // per session and and an overall value
-    void getIdleStatus(api::ObjectRef out) const;
+    void getIdleStatus(api::ObjectRef out);
+    // rez context cache statistics
+    void getRezCacheStatus(api::ObjectRef out) const { mRezCache.getStats(out); }
+    // session operation queue and timing statistics
+    void getOperationStatus(api::ObjectRef out) const { mExecutor.getStats(out); }
 
 private: 
 
     Session::Ptr getSession_wlock(const api::UUID& id);
+    void reclaimSessions_wlock(std::vector<Session::Ptr>& reclaimed);
+    void reclaimSessions();
 
     impl::ProcessManager& mProcessManager;
     const ComputationDefaults& mDefaults;
@@ -68,9 +90,32 @@ private:
     std::shared_ptr<ArrasController> mController;
     std::atomic<bool> mClosed{false};
     long mStartTimeSecs = 0;
+    RezContextCache mRezCache;
+    RezPrewarmer mRezPrewarmer;
+
+    ActivityTimes mActivity;
+    // node-wide timers, for session expiration. Declared before
+    // mSessions so that it outlives them
+    TimerWheel mTimers;
+    // runs session operations. Also declared before mSessions
+    SessionExecutor mExecutor;
 
     mutable std::mutex mSessionsMutex;
     std::map<api::UUID,Session::Ptr> mSessions;
+
+    // a record of discarded sessions, so that late requests (e.g. a client
+    // connecting after deletion) can still be handled properly.
+    // Kept for mDefaults.sessionTombstoneSecs, and limited in number
+    struct Tombstone {
+        std::string deleteReason;
+        long reclaimedSecs;
+        unsigned long long sequence;
+    };
+    std::map<api::UUID,Tombstone> mTombstones; // protected by mSessionsMutex
+    // (id,sequence) oldest first : the sequence number detects a tombstone
+    // that has been replaced by a later one for the same id
+    std::deque<std::pair<api::UUID,unsigned long long>> mTombstoneOrder;
+    unsigned long long mTombstoneSequence = 0;
 };  
 
 }
@@ -96,6 +96,7 @@ bool Computation::start(const impl::SpawnArgs& spawnArgs)
     timeval now;
     gettimeofday(&now, nullptr);
     mLastActivitySecs = now.tv_sec;
+    mSession.noteActivity(now.tv_sec,true);
     return true;
 }
 
@@ -105,6 +106,19 @@ void Computation::shutdown()
     mProcess->terminate(false);
 }
 
+void Computation::kill()
+{
+    mTerminationExpected = true;
+    pid_t pid = mProcess->pid();
+    if (pid > 0 && mProcess->state() == impl::ProcessState::Spawned) {
+	ARRAS_WARN(log::Id("compKilled") <<
+		   log::Session(sessionId().toString()) <<
+		   "Computation " << name() << " did not stop in time : killing it");
+	// kill every member of the process group
+	::kill(-pid,SIGKILL);
+    }
+}
+
 void Computation::signal(api::ObjectConstRef signalData)
 {
     std::string status;
@@ -158,6 +172,10 @@ void Computation::onTerminate(const api::UUID& id,
     status.convertHighExitToSignal();
     data["reason"] = name() + " " + exitStatusString(status,mTerminationExpected);
     data["eventType"] = "computationTerminated";
+    // when the node is shutting down, the session reports all its
+    // computations together once they have stopped
+    if (mSession.addShutdownReport(data["reason"].asString()))
+	return;
     mSession.arrasController().handleEvent(sessionId,id,data);
 }
 
@@ -182,11 +200,13 @@ void Computation::onHeartbeat(impl::ExecutorHeartbeat::ConstPtr heartbeat)
 	mLastSentMessagesSecs = heartbeat->mTransmitSecs;
 	mLastSentMessagesMicroSecs = heartbeat->mTransmitMicroSecs;
 	mLastActivitySecs = heartbeat->mTransmitSecs;
+	mSession.noteActivity(heartbeat->mTransmitSecs,true);
     }
     if (heartbeat->mReceivedMessages5Sec > 0) {
 	mLastReceivedMessagesSecs = heartbeat->mTransmitSecs;
 	mLastReceivedMessagesMicroSecs = heartbeat->mTransmitMicroSecs;
 	mLastActivitySecs = heartbeat->mTransmitSecs;
+	mSession.noteActivity(heartbeat->mTransmitSecs,true);
     }
 }
 
@@ -37,6 +37,7 @@ public:
     
     bool start(const impl::SpawnArgs& spawnArgs);
     void shutdown(); 
+    void kill();     // SIGKILL, for computations that ignore shutdown()
     void signal(api::ObjectConstRef signalData); 
     bool waitUntilShutdown(const std::chrono::steady_clock::time_point& endTime);
 
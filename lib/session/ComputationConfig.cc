@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "ComputationConfig.h"
+#include "RezContextCache.h"
 #include "SessionError.h"
 #include <execute/RezContext.h>
 
@@ -167,6 +168,7 @@ void ComputationConfig::setDefinition(api::ObjectConstRef definition,
 //
 // throws SessionError if a problem occurs
 void ComputationConfig::applyPackaging(impl::ProcessManager& procMan,
+                                       RezContextCache& rezCache,
                                        api::ObjectConstRef definition,
                                        api::ObjectConstRef context)
 {
@@ -189,9 +191,9 @@ void ComputationConfig::applyPackaging(impl::ProcessManager& procMan,
     else if (packagingSystem == "bash") {
 	applyShellPackaging(impl::ShellType::Bash,ctx);
     } else if (packagingSystem == "rez1") {
-        applyRezPackaging(1,procMan,ctx);
+        applyRezPackaging(1,procMan,rezCache,ctx);
     } else if (packagingSystem == "rez2") {
-        applyRezPackaging(2,procMan,ctx);
+        applyRezPackaging(2,procMan,rezCache,ctx);
     } else {
         ARRAS_WARN(log::Id("warnUnknownPackaging") <<
                    log::Session(mSessionId.toString()) <<
@@ -272,6 +274,7 @@ void ComputationConfig::applyShellPackaging(impl::ShellType type,api::ObjectCons
 
 void ComputationConfig::applyRezPackaging(unsigned rezMajor,
 					  impl::ProcessManager& procMan,
+					  RezContextCache& rezCache,
 					  api::ObjectConstRef ctx)
 {
     std::string pseudoCompiler = get(ctx,"pseudo-compiler",std::string());
@@ -300,7 +303,27 @@ void ComputationConfig::applyRezPackaging(unsigned rezMajor,
         std::string err;
         if (!rezContext.empty()) ok = rc.setContext(rezContext,err);
         else if (!rezContextFile.empty()) ok = rc.setContextFile(rezContextFile,err);
-        else if (!rezPackages.empty()) ok = rc.setPackages(procMan,rezPackages,err);
+        else if (!rezPackages.empty()) {
+	    RezRequest request;
+	    request.rezMajor = rezMajor;
+	    request.pathPrefix = rezPathPrefix;
+	    request.overridingPath = overridingPackagePath;
+	    request.packages = rezPackages;
+	    request.pseudoCompiler = pseudoCompiler;
+	    std::string cached;
+	    if (rezCache.lookup(request, cached)) {
+		ARRAS_DEBUG(log::Session(mSessionId.toString()) <<
+			    "[ rez" << rezMajor << " ] Using cached resolve of '" <<
+			    rezPackages << "' for " << mName);
+		ok = rc.setContext(cached,err);
+	    }
+	    if (!ok) {
+		err.clear();
+		ok = rc.setPackages(procMan,rezPackages,err);
+		if (ok)
+		    rezCache.store(request, rc.context());
+	    }
+	}
         else err = "Must specify one of 'rez_context','rez_context_file' or 'rez_packages'";
         if (ok) {
             ok = rc.wrap(mSpawnArgs,mSpawnArgs);
@@ -33,6 +33,8 @@ template<typename T> T getter(api::ObjectConstRef obj);
     
 // generates the spawn settings for a computation process,
 // given the Arras configuration data supplied by Coordinator
+class RezContextCache;
+
 class ComputationConfig
 {
 public:
@@ -56,9 +58,11 @@ public:
     // modifies the spawn arguments to run the process under
     // a packaging system (i.e. rez). Generally changes program,
     // args and environment, and may run a background process
-    // to resolved the rez environment
+    // to resolved the rez environment. Resolved 'rez_packages'
+    // are looked up in and added to rezCache
     // throws SessionError if something goes wrong
     void applyPackaging(impl::ProcessManager& procMan,
+                        RezContextCache& rezCache,
                         api::ObjectConstRef definition,
 	                api::ObjectConstRef context);
 
@@ -91,7 +95,8 @@ private:
     void applyNoPackaging(api::ObjectConstRef ctx);
     void applyCurrentEnvironment(api::ObjectConstRef ctx);
     void applyShellPackaging(impl::ShellType type, api::ObjectConstRef ctx);
-    void applyRezPackaging(unsigned rezMajor, impl::ProcessManager& procMan, api::ObjectConstRef ctx);
+    void applyRezPackaging(unsigned rezMajor, impl::ProcessManager& procMan,
+                           RezContextCache& rezCache, api::ObjectConstRef ctx);
 
     api::UUID mId;
     api::UUID mNodeId;
@@ -45,6 +45,14 @@ public:
     std::string defPackagingSystem{"rez1"};
     std::string packagePathOverride;
 
+    // resolved rez contexts are cached in this directory (empty = no cache)
+    std::string rezCacheDir;
+    unsigned rezCacheTtlSecs = 24*60*60;
+    size_t rezCacheMaxBytes = 256*1024*1024;
+    // number of the most launched rez contexts kept resolved in advance (0 = none)
+    unsigned rezPrewarmCount = 0;
+    unsigned rezPrewarmIntervalSecs = 60;
+
     bool colorLogging = true;
     int logLevel = log::Logger::LOG_INFO;
     std::string athenaEnv{"prod"};
@@ -59,6 +67,46 @@ public:
     // is the most convenient place to put it
     unsigned clientConnectionTimeoutSecs = 30;
 
+    // also not computation defaults : defunct sessions are discarded after
+    // this long, and a record of them kept for sessionTombstoneSecs
+    unsigned defunctSessionGraceSecs = 60;
+    unsigned sessionTombstoneSecs = 3600;
+    // number of threads running session operations (create/modify), and
+    // running operations that block (delete)
+    unsigned sessionOpThreads = 8;
+    unsigned sessionBlockingOpThreads = 4;
+
+    // maximum number of computations in a session that are
+    // launched at the same time (1 = one after another), and
+    // number of threads shared by all sessions to launch them
+    unsigned maxParallelLaunches = 4;
+    unsigned launchThreads = 8;
+
+    // passed to the router process : "poll" or "blocking"
+    std::string routerReceiveMode{"poll"};
+
+    // if set, the router captures traffic to trace files in this directory
+    std::string routerCaptureDir;
+
+    // number of shards the router splits its session tables into
+    unsigned routerShards = 1;
+
+    // received payloads larger than this are held in file mappings by the router (0 = never)
+    size_t routerMapPayloadsOver = 0;
+
+    // if set, the router writes sampled per-hop timing spans to this file
+    std::string routerTraceSpans;
+    double routerTraceSampleRate = 0.001;
+
+    // cpus reserved for the router to busy poll latency-sensitive sessions (empty = never)
+    std::string routerBusyPollCpus;
+    unsigned routerBusyPollIdleMs = 100;
+    bool routerBusyPollAllSessions = false;
+
+    // seconds between probes of the links to other nodes (0 = never).
+    // Off by default : each probe round costs bandwidth on every link
+    unsigned routerProbeInterval = 0;
+
 };
 
 }
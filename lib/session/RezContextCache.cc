@@ -0,0 +1,373 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "RezContextCache.h"
+
+#include <arras4_log/Logger.h>
+#include <arras4_log/LogEventStream.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+namespace {
+
+const char* ENTRY_SUFFIX = ".rxtc";
+
+bool endsWith(const std::string& s, const std::string& suffix)
+{
+    return s.size() >= suffix.size() &&
+        s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// equivalent of 'mkdir -p'
+bool makeDirectories(const std::string& path)
+{
+    std::string partial;
+    std::istringstream ss(path);
+    std::string part;
+    if (!path.empty() && path[0] == '/') partial = "/";
+    while (std::getline(ss, part, '/')) {
+        if (part.empty()) continue;
+        partial += part + "/";
+        if (mkdir(partial.c_str(), 0775) != 0 && errno != EEXIST)
+            return false;
+    }
+    return true;
+}
+
+// package family names from a request such as "foo-1.2 bar-3+<4 ~baz"
+std::vector<std::string> requestedFamilies(const std::string& packages)
+{
+    std::vector<std::string> families;
+    std::istringstream ss(packages);
+    std::string req;
+    while (ss >> req) {
+        size_t start = req.find_first_not_of("~!");
+        if (start == std::string::npos) continue;
+        size_t end = req.find_first_of("-=<>@+", start);
+        families.push_back(req.substr(start, end == std::string::npos ? end : end - start));
+    }
+    return families;
+}
+
+struct EntryFile {
+    std::string path;
+    time_t mtime;
+    size_t size;
+};
+
+}
+
+namespace arras4 {
+    namespace node {
+
+RezContextCache::RezContextCache(const std::string& directory,
+                                 unsigned ttlSecs,
+                                 size_t maxBytes) :
+    mDirectory(directory), mTtlSecs(ttlSecs), mMaxBytes(maxBytes)
+{
+    if (!enabled())
+        return;
+    if (!makeDirectories(mDirectory)) {
+        ARRAS_WARN(log::Id("rezCacheDirFailed") <<
+                   "Cannot create rez cache directory " << mDirectory <<
+                   " : " << strerror(errno));
+        return;
+    }
+    // picks up the entries left by previous runs, and applies the limits to them
+    std::lock_guard<std::mutex> lock(mMutex);
+    evict_wlock();
+    ARRAS_INFO("Rez context cache in " << mDirectory << " has " << mEntries.load() <<
+               " entries (" << mBytes.load() << " bytes)");
+}
+
+std::string RezRequest::key() const
+{
+    // overridingPath isn't part of the key : an overriding prefix is
+    // a node setting, so it is different from any session's prefix
+    return "rez" + std::to_string(rezMajor) + "\n" + pathPrefix + "\n" +
+        packages + "\n" + pseudoCompiler;
+}
+
+std::string RezRequest::packagePath() const
+{
+    std::string path = pathPrefix;
+    const char* defaultPath = getenv("REZ_PACKAGES_PATH");
+    if (!overridingPath && defaultPath)
+        path += std::string(":") + defaultPath;
+    return path;
+}
+
+std::string RezContextCache::entryPath(const std::string& key) const
+{
+    // the full key is stored in the entry, so a hash collision is a miss
+    char name[32];
+    snprintf(name, sizeof(name), "%016zx", std::hash<std::string>()(key));
+    return mDirectory + "/" + name + ENTRY_SUFFIX;
+}
+
+// summarizes the modification times of the repository directories and
+// of the family directories of the requested packages : releasing a new
+// version of a package changes its family directory
+std::string RezContextCache::repositoryStamp(const RezRequest& request)
+{
+    std::vector<std::string> families = requestedFamilies(request.packages);
+    std::ostringstream stamp;
+    std::istringstream ss(request.packagePath());
+    std::string repo;
+    while (std::getline(ss, repo, ':')) {
+        if (repo.empty()) continue;
+        std::vector<std::string> dirs{repo};
+        for (const std::string& family : families)
+            dirs.push_back(repo + "/" + family);
+        for (const std::string& dir : dirs) {
+            struct stat st;
+            if (stat(dir.c_str(), &st) == 0)
+                stamp << st.st_mtim.tv_sec << "." << st.st_mtim.tv_nsec << ",";
+            else
+                stamp << "-,";
+        }
+    }
+    return stamp.str();
+}
+
+RezContextCache::EntryState
+RezContextCache::readEntry(const RezRequest& request,
+                           unsigned marginSecs,
+                           std::string& context)
+{
+    std::string key = request.key();
+    std::string path = entryPath(key);
+    api::Object entry;
+    {
+        std::ifstream in(path);
+        if (!in)
+            return EntryState::Absent;
+        std::stringstream buf;
+        buf << in.rdbuf();
+        try {
+            api::stringToObject(buf.str(), entry);
+        } catch (std::exception&) {
+            // treat a damaged entry as absent : it is replaced by store()
+            return EntryState::Absent;
+        }
+    }
+
+    if (!entry["key"].isString() || entry["key"].asString() != key ||
+        !entry["context"].isString())
+        return EntryState::Absent;
+
+    time_t created = entry["created"].isIntegral() ? entry["created"].asInt64() : 0;
+    if (mTtlSecs > 0 &&
+        time(nullptr) + static_cast<time_t>(marginSecs) - created > static_cast<time_t>(mTtlSecs))
+        return EntryState::Expired;
+
+    if (!entry["stamp"].isString() ||
+        entry["stamp"].asString() != repositoryStamp(request))
+        return EntryState::Invalidated;
+
+    context = entry["context"].asString();
+    return EntryState::Valid;
+}
+
+bool RezContextCache::lookup(const RezRequest& request,
+                             std::string& context)
+{
+    if (!enabled())
+        return false;
+
+    notePopularity(request);
+    switch (readEntry(request, 0, context)) {
+    case EntryState::Valid:
+        // the modification time orders entries for eviction
+        utime(entryPath(request.key()).c_str(), nullptr);
+        mHits++;
+        return true;
+    case EntryState::Expired:
+        mExpired++;
+        break;
+    case EntryState::Invalidated:
+        ARRAS_DEBUG("Rez cache entry for '" << request.packages << "' is out of date : package repositories have changed");
+        mInvalidated++;
+        break;
+    case EntryState::Absent:
+        break;
+    }
+    mMisses++;
+    return false;
+}
+
+bool RezContextCache::needsRefresh(const RezRequest& request,
+                                   unsigned marginSecs)
+{
+    std::string context;
+    return enabled() &&
+        readEntry(request, marginSecs, context) != EntryState::Valid;
+}
+
+void RezContextCache::notePopularity(const RezRequest& request)
+{
+    // enough to cover the package sets in regular use on a node
+    const size_t MAX_TRACKED = 256;
+
+    std::lock_guard<std::mutex> lock(mPopularityMutex);
+    std::string key = request.key();
+    auto it = mPopularity.find(key);
+    if (it == mPopularity.end()) {
+        if (mPopularity.size() >= MAX_TRACKED) {
+            auto least = std::min_element(mPopularity.begin(), mPopularity.end(),
+                                          [](const std::pair<const std::string,Popularity>& a,
+                                             const std::pair<const std::string,Popularity>& b) {
+                                              return a.second.lookups < b.second.lookups; });
+            mPopularity.erase(least);
+        }
+        it = mPopularity.emplace(key, Popularity{request, 0}).first;
+    }
+    it->second.lookups++;
+}
+
+std::vector<RezRequest> RezContextCache::popularRequests(size_t count) const
+{
+    std::vector<const Popularity*> all;
+    std::lock_guard<std::mutex> lock(mPopularityMutex);
+    for (const auto& entry : mPopularity)
+        all.push_back(&entry.second);
+    std::sort(all.begin(), all.end(),
+              [](const Popularity* a, const Popularity* b) { return a->lookups > b->lookups; });
+    std::vector<RezRequest> ret;
+    for (size_t i = 0; i < all.size() && i < count; i++)
+        ret.push_back(all[i]->request);
+    return ret;
+}
+
+void RezContextCache::store(const RezRequest& request,
+                            const std::string& context)
+{
+    if (!enabled() || context.empty())
+        return;
+
+    std::string key = request.key();
+    api::Object entry;
+    entry["key"] = key;
+    entry["stamp"] = repositoryStamp(request);
+    entry["created"] = static_cast<Json::Int64>(time(nullptr));
+    entry["context"] = context;
+    std::string data = api::objectToString(entry);
+
+    // the temporary name is unique across nodes sharing the directory.
+    // It doesn't end in ENTRY_SUFFIX, so it is never read as an entry
+    std::string path = entryPath(key);
+    std::string tmpPath = path + ".tmpXXXXXX";
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    int fd = mkostemp(&tmpPath[0], O_CLOEXEC);
+    if (fd < 0) {
+        ARRAS_WARN(log::Id("rezCacheWriteFailed") <<
+                   "Cannot create rez cache entry in " << mDirectory << " : " << strerror(errno));
+        return;
+    }
+    // mkostemp creates the file readable only by its owner
+    bool ok = fchmod(fd, 0644) == 0;
+    size_t written = 0;
+    while (ok && written < data.size()) {
+        ssize_t n = write(fd, data.data() + written, data.size() - written);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            ok = false;
+        } else {
+            written += n;
+        }
+    }
+    if (close(fd) != 0)
+        ok = false;
+    if (!ok) {
+        ARRAS_WARN(log::Id("rezCacheWriteFailed") <<
+                   "Cannot write rez cache entry " << tmpPath << " : " << strerror(errno));
+        unlink(tmpPath.c_str());
+        return;
+    }
+    if (rename(tmpPath.c_str(), path.c_str()) != 0) {
+        ARRAS_WARN(log::Id("rezCacheWriteFailed") <<
+                   "Cannot write rez cache entry " << path << " : " << strerror(errno));
+        unlink(tmpPath.c_str());
+        return;
+    }
+    evict_wlock();
+}
+
+// scan the directory, removing expired entries and then the least
+// recently used ones until the total size is under the limit.
+// Recounts mEntries and mBytes. Caller holds mMutex
+void RezContextCache::evict_wlock()
+{
+    DIR* dir = opendir(mDirectory.c_str());
+    if (!dir)
+        return;
+
+    std::vector<EntryFile> files;
+    size_t total = 0;
+    time_t now = time(nullptr);
+    while (dirent* de = readdir(dir)) {
+        std::string name(de->d_name);
+        if (!endsWith(name, ENTRY_SUFFIX)) continue;
+        std::string path = mDirectory + "/" + name;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) continue;
+        // an entry that hasn't been used for the TTL must have expired
+        if (mTtlSecs > 0 && now - st.st_mtime > static_cast<time_t>(mTtlSecs)) {
+            if (unlink(path.c_str()) == 0) mEvicted++;
+            continue;
+        }
+        files.push_back(EntryFile{path, st.st_mtime, static_cast<size_t>(st.st_size)});
+        total += st.st_size;
+    }
+    closedir(dir);
+
+    if (mMaxBytes > 0 && total > mMaxBytes) {
+        std::sort(files.begin(), files.end(),
+                  [](const EntryFile& a, const EntryFile& b) { return a.mtime < b.mtime; });
+        auto it = files.begin();
+        while (total > mMaxBytes && it != files.end()) {
+            if (unlink(it->path.c_str()) == 0) mEvicted++;
+            total -= it->size;
+            it = files.erase(it);
+        }
+    }
+    mEntries = files.size();
+    mBytes = total;
+}
+
+void RezContextCache::getStats(api::ObjectRef out) const
+{
+    api::ObjectRef stats = out["rezCache"];
+    stats["enabled"] = enabled();
+    if (!enabled())
+        return;
+    stats["directory"] = mDirectory;
+    stats["hits"] = static_cast<Json::UInt64>(mHits);
+    stats["misses"] = static_cast<Json::UInt64>(mMisses);
+    stats["expired"] = static_cast<Json::UInt64>(mExpired);
+    stats["invalidated"] = static_cast<Json::UInt64>(mInvalidated);
+    stats["evicted"] = static_cast<Json::UInt64>(mEvicted);
+    stats["entries"] = static_cast<Json::UInt64>(mEntries);
+    stats["bytes"] = static_cast<Json::UInt64>(mBytes);
+    stats["refreshed"] = static_cast<Json::UInt64>(mRefreshed);
+}
+
+}
+}
@@ -0,0 +1,123 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __ARRAS4_REZ_CONTEXT_CACHE_H__
+#define __ARRAS4_REZ_CONTEXT_CACHE_H__
+
+#include <message_api/Object.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Resolving 'rez_packages' takes seconds, and the same package sets are
+// launched over and over. RezContextCache keeps resolved contexts in a
+// node-local directory, so that they survive across sessions and node
+// restarts. An entry is keyed by everything that affects the resolve
+// (rez major version, package path prefix, package request and
+// pseudo-compiler) and is discarded when :
+//
+//    - it is older than the TTL
+//    - the cache exceeds its size limit (least recently used go first)
+//    - the package repositories it was resolved against have changed :
+//      the modification times of each repository directory, and of the
+//      family directories of the requested packages, are recorded with
+//      the entry and checked when it is used. Changes to the dependencies
+//      of the requested packages are only picked up via the TTL
+//
+// Entries are written to a temporary file and renamed, so several
+// nodes (or a restarted node) can safely share a directory.
+
+namespace arras4 {
+    namespace node {
+
+// everything that affects the result of a rez resolve
+struct RezRequest
+{
+    unsigned rezMajor = 2;
+    std::string pathPrefix;
+    bool overridingPath = false; // pathPrefix replaces the default path
+    std::string packages;
+    std::string pseudoCompiler;
+
+    std::string key() const;
+    // the full search path of the resolve, i.e. the prefix
+    // followed by the default path (unless the prefix overrides it)
+    std::string packagePath() const;
+};
+
+class RezContextCache
+{
+public:
+    // an empty directory disables the cache
+    RezContextCache(const std::string& directory,
+                    unsigned ttlSecs,
+                    size_t maxBytes);
+
+    bool enabled() const { return !mDirectory.empty(); }
+
+    // returns true and sets context if there is a valid entry for request.
+    // Every lookup counts towards the popularity of the request
+    bool lookup(const RezRequest& request,
+                std::string& context);
+
+    // add or replace the entry for request, then evict if over the size limit
+    void store(const RezRequest& request,
+               const std::string& context);
+
+    // true if there is no valid entry for request, or if the entry
+    // will expire within marginSecs. Doesn't affect the statistics
+    bool needsRefresh(const RezRequest& request,
+                      unsigned marginSecs);
+
+    // the (up to) count requests that have been looked up most often,
+    // most popular first
+    std::vector<RezRequest> popularRequests(size_t count) const;
+
+    // hit/miss/eviction counts and current size, as "rezCache" in out
+    void getStats(api::ObjectRef out) const;
+
+    // count a resolve done in advance of any lookup
+    void countRefresh() { mRefreshed++; }
+
+private:
+    enum class EntryState { Valid, Absent, Expired, Invalidated };
+    EntryState readEntry(const RezRequest& request, unsigned marginSecs,
+                         std::string& context);
+    std::string entryPath(const std::string& key) const;
+    static std::string repositoryStamp(const RezRequest& request);
+    void evict_wlock();
+    void notePopularity(const RezRequest& request);
+
+    // lookups per request, to choose what to keep resolved. Limited
+    // in size : the least popular are forgotten
+    struct Popularity {
+        RezRequest request;
+        unsigned long long lookups = 0;
+    };
+
+    const std::string mDirectory;
+    const unsigned mTtlSecs;
+    const size_t mMaxBytes;
+
+    // serializes writes and eviction within this node
+    std::mutex mMutex;
+
+    mutable std::mutex mPopularityMutex;
+    std::map<std::string,Popularity> mPopularity;
+
+    std::atomic<unsigned long long> mHits{0};
+    std::atomic<unsigned long long> mMisses{0};
+    std::atomic<unsigned long long> mExpired{0};
+    std::atomic<unsigned long long> mInvalidated{0};
+    std::atomic<unsigned long long> mEvicted{0};
+    std::atomic<unsigned long long> mEntries{0};
+    std::atomic<unsigned long long> mBytes{0};
+    std::atomic<unsigned long long> mRefreshed{0};
+};
+
+}
+}
+#endif
@@ -0,0 +1,101 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "RezPrewarmer.h"
+
+#include <arras4_log/Logger.h>
+#include <arras4_log/LogEventStream.h>
+#include <execute/RezContext.h>
+#include <message_api/UUID.h>
+
+#include <chrono>
+
+namespace arras4 {
+    namespace node {
+
+RezPrewarmer::RezPrewarmer(RezContextCache& cache,
+                           impl::ProcessManager& processManager) :
+    mCache(cache), mProcessManager(processManager)
+{
+}
+
+RezPrewarmer::~RezPrewarmer()
+{
+    stop();
+}
+
+void RezPrewarmer::start(unsigned count, unsigned intervalSecs)
+{
+    if (count == 0 || intervalSecs == 0 || !mCache.enabled() || mThread.joinable())
+        return;
+    mCount = count;
+    mIntervalSecs = intervalSecs;
+    mThread = std::thread(&RezPrewarmer::proc, this);
+    ARRAS_INFO("Keeping the " << count << " most launched rez contexts resolved");
+}
+
+void RezPrewarmer::requestStop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mCondition.notify_all();
+}
+
+void RezPrewarmer::stop()
+{
+    requestStop();
+    if (mThread.joinable())
+        mThread.join();
+}
+
+void RezPrewarmer::proc()
+{
+    // refresh entries that would expire before the next check
+    unsigned margin = 2 * mIntervalSecs;
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mStopping) {
+        mCondition.wait_for(lock, std::chrono::seconds(mIntervalSecs));
+        if (mStopping)
+            break;
+        lock.unlock();
+        for (const RezRequest& request : mCache.popularRequests(mCount)) {
+            if (mCache.needsRefresh(request, margin))
+                refresh(request);
+            // a resolve can take a while : don't hold up shutdown
+            std::lock_guard<std::mutex> stopLock(mMutex);
+            if (mStopping)
+                break;
+        }
+        lock.lock();
+    }
+}
+
+void RezPrewarmer::refresh(const RezRequest& request)
+{
+    try {
+        // the resolve isn't for any particular computation or session
+        impl::RezContext rc("prewarm", request.rezMajor, request.pathPrefix,
+                            request.overridingPath,
+                            request.pseudoCompiler,
+                            api::UUID::generate(), api::UUID());
+        std::string err;
+        if (rc.setPackages(mProcessManager, request.packages, err)) {
+            mCache.store(request, rc.context());
+            mCache.countRefresh();
+            ARRAS_DEBUG("Resolved rez" << request.rezMajor << " '" << request.packages << "' in advance");
+        } else {
+            ARRAS_WARN(log::Id("rezPrewarmFailed") <<
+                       "[ rez" << request.rezMajor << " ] Failed to resolve '" <<
+                       request.packages << "' in advance : " << err);
+        }
+    } catch (std::exception& e) {
+        ARRAS_WARN(log::Id("rezPrewarmFailed") <<
+                   "[ rez" << request.rezMajor << " ] Failed to resolve '" <<
+                   request.packages << "' in advance : " << e.what());
+    }
+}
+
+}
+}
@@ -0,0 +1,56 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __ARRAS4_REZ_PREWARMER_H__
+#define __ARRAS4_REZ_PREWARMER_H__
+
+#include "RezContextCache.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace arras4 {
+    namespace impl {
+        class ProcessManager;
+    }
+    namespace node {
+
+// Keeps the rez contexts that are launched most often on this node
+// resolved in advance, so that starting a computation that uses one
+// doesn't wait for a resolve. A background thread periodically takes the
+// most popular requests from the RezContextCache and resolves any that
+// are missing, out of date or about to expire.
+class RezPrewarmer
+{
+public:
+    RezPrewarmer(RezContextCache& cache,
+                 impl::ProcessManager& processManager);
+    ~RezPrewarmer();
+
+    // keep (up to) count contexts resolved, checking them every
+    // intervalSecs. Does nothing if count is 0 or the cache is disabled
+    void start(unsigned count, unsigned intervalSecs);
+    // ask the thread to stop after the current resolve, without waiting
+    void requestStop();
+    // stop the thread and wait for it to finish
+    void stop();
+
+private:
+    void proc();
+    void refresh(const RezRequest& request);
+
+    RezContextCache& mCache;
+    impl::ProcessManager& mProcessManager;
+    unsigned mCount = 0;
+    unsigned mIntervalSecs = 60;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    bool mStopping = false;
+    std::thread mThread;
+};
+
+}
+}
+#endif
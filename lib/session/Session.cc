@@ -8,7 +8,10 @@
 
 #include <http/http_types.h>
 
+#include <algorithm>
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <sys/time.h>
 
 using namespace arras4::network;
@@ -16,6 +19,12 @@ using namespace arras4::network;
 namespace {
     // time to wait for all running processes to terminate before giving up
     const std::chrono::milliseconds WAIT_FOR_SHUTDOWN_TIMEOUT(30000); // 30 seconds
+    // computations still running this long before a shutdown deadline are killed,
+    // but they always get at least KILL_GRACE_FRACTION of the time to stop themselves
+    const std::chrono::milliseconds KILL_BEFORE_DEADLINE(5000); // 5 seconds
+    const double KILL_GRACE_FRACTION = 0.5;
+    // time to wait for the router's final traffic summary after the session stops
+    const std::chrono::milliseconds WAIT_FOR_TRAFFIC_SUMMARY(1000); // 1 second
 }
 
 namespace arras4 {
@@ -25,30 +34,31 @@ Session::Session(const api::UUID& sessionId,
                  const api::UUID& nodeId,
                  const ComputationDefaults& computationDefaults,
                  impl::ProcessManager& processManager,
-                 ArrasController& arrasController)
+                 ArrasController& arrasController,
+                 RezContextCache& rezCache,
+                 ActivityTimes& nodeActivity,
+                 TimerWheel& timers,
+                 SessionExecutor& executor)
     : mId(sessionId), mNodeId(nodeId),
       mComputationDefaults(computationDefaults),
       mLogLevel(3), mProcessManager(processManager), 
-      mArrasController(arrasController), mState(SessionState::Free),
-      mDeleteReason("Not Deleted")
+      mArrasController(arrasController), mRezCache(rezCache),
+      mNodeActivity(nodeActivity),
+      mExecutor(executor),
+      mState(SessionState::Free),
+      mDeleteReason("Not Deleted"),
+      mTimers(timers)
 {
-    // initialize mLastActivitySecs to a reasonable value
+    // initialize activity time to a reasonable value
     timeval now;
     gettimeofday(&now, nullptr);
-    mLastActivitySecs = now.tv_sec;
+    noteActivity(now.tv_sec,false);
 }
 
-// ~Session makes sure no operations are running for safety,
-// but normally you should have already called syncShutdown
+// operations hold a pointer to the session, so none can be running
+// or queued by the time it is destroyed
 Session::~Session()
 {
-    // stop new operations
-    {
-	std::lock_guard<std::mutex> lock(mStateMutex);
-	mShuttingDown = true;
-    }
-    if (mOperationThread.joinable())
-        mOperationThread.join();
     // terminate any expiration
     stopExpiration();
 }
@@ -94,7 +104,14 @@ bool Session::isAutoSuspend() const
 api::Object Session::getStatus()
 {
     api::Object status;
-    status["state"] = SessionState_string(getState());
+    {
+	std::lock_guard<std::mutex> lock(mStateMutex);
+	status["state"] = SessionState_string(mState);
+	if (mHasQueued)
+	    status["queuedOperation"] = mQueued.name();
+	if (!mTrafficSummary.isNull())
+	    status["traffic"] = mTrafficSummary;
+    }
     api::ObjectRef comps = status["computations"];
     std::lock_guard<std::mutex> lock(mComputationsMutex);
     for (auto jt = mComputations.begin(); jt != mComputations.end(); ++jt) {
@@ -107,6 +124,11 @@ api::Object Session::getStatus()
 api::Object Session::getPerformanceStats()
 {
     api::Object stats;
+    {
+	std::lock_guard<std::mutex> lock(mStateMutex);
+	if (!mTrafficSummary.isNull())
+	    stats["traffic"] = mTrafficSummary;
+    }
     api::ObjectRef comps = stats["computations"];
     std::lock_guard<std::mutex> lock(mComputationsMutex);
     for (auto jt = mComputations.begin(); jt != mComputations.end(); ++jt) {
@@ -118,15 +140,31 @@ api::Object Session::getPerformanceStats()
 
 long Session::getLastActivitySecs(bool includeComputations) const
 {
-    long ret = mLastActivitySecs;
-    if (includeComputations) {
-	std::lock_guard<std::mutex> lock(mComputationsMutex);
-	for (auto jt = mComputations.begin(); jt != mComputations.end(); ++jt) {
-	    long cla = jt->second->getLastActivitySecs();
-	    if (cla > ret) ret = cla;
-	}
+    return mActivity.get(includeComputations);
+}
+
+void Session::noteActivity(long secs, bool fromComputation)
+{
+    mActivity.update(secs,fromComputation);
+    mNodeActivity.update(secs,fromComputation);
+}
+
+bool Session::isReclaimable(long nowSecs, unsigned graceSecs)
+{
+    {
+	std::lock_guard<std::mutex> lock(mStateMutex);
+	if (mState != SessionState::Defunct ||
+	    nowSecs - mDefunctSecs < static_cast<long>(graceSecs))
+	    return false;
     }
-    return ret;
+    // a computation that couldn't be stopped still refers to the session
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mComputationsMutex);
+    for (auto jt = mComputations.begin(); jt != mComputations.end(); ++jt) {
+	if (!jt->second->waitUntilShutdown(now))
+	    return false;
+    }
+    return true;
 }
     
 void Session::checkIsFree()
@@ -168,7 +206,7 @@ void Session::signal(api::ObjectConstRef signalData)
     }
     timeval now;
     gettimeofday(&now, nullptr);
-    mLastActivitySecs = now.tv_sec;
+    noteActivity(now.tv_sec,false);
 	
 }
 
@@ -180,13 +218,13 @@ void Session::signalAll(api::ObjectConstRef signalData)
     }
 }
 
-// the "async" operations start a background thread to modify the session.
+// the "async" operations run on the session executor to modify the session.
 // as they run, notifications, like "computation ready" and "computation
 // terminated" will be sent back to Coordinator.
 //
 // Only one operation can be running at any time, to prevent interference.
-// If you attempt to initiate an operation while one is already running,
-// the a "busy" exception is thrown. This causes node to respond with a
+// By default, if you attempt to initiate an operation while one is already
+// running, a "busy" exception is thrown. This causes node to respond with a
 // HTTP_RESOURCE_CONFLICT status to the requester (i.e. Coordinator).
 // There are two deliberate policies here:
 //     -- node responds promptly to the HTTP request (i.e. doesn't wait for
@@ -194,7 +232,16 @@ void Session::signalAll(api::ObjectConstRef signalData)
 //     -- requests are not queued, because this would make it harder for 
 //	  Coordinator to track asynchronous notification resulting from the
 //        operation.
-void Session::asyncUpdateConfig(SessionConfig::Ptr newConfig)
+//
+// A session whose config sets "queueOperations" opts out of the second
+// policy : requests are still answered promptly, but are queued while the
+// session is busy, and each is given an operation id. At most one operation
+// is queued : a modify replaces a queued modify (the latest config is the
+// one that matters), and a delete replaces a queued modify, or joins a
+// delete that is queued or running. A "sessionOperationComplete" event
+// lists the ids each operation completed, so Coordinator can tell which
+// of its requests have taken effect.
+Session::OperationId Session::asyncUpdateConfig(SessionConfig::Ptr newConfig)
 {
     // check session and node ids match
     if (mId != newConfig->sessionId())
@@ -202,129 +249,317 @@ void Session::asyncUpdateConfig(SessionConfig::Ptr newConfig)
     if (mNodeId != newConfig->nodeId())
         throw SessionError("Config node id did not match session object.");
  
-    // check state
+    OperationId opId = 0;
     {
         std::lock_guard<std::mutex> lock(mStateMutex);
 	if (mShuttingDown)
 	    throw SessionError("Session is shutting down");
-        if (mState == SessionState::Busy)
-            throw SessionError("Session is busy and cannot be modified",
-                               HTTP_RESOURCE_CONFLICT);
         if (mState == SessionState::Defunct)
             throw SessionError("Session is defunct and cannot be modified",
                                HTTP_RESOURCE_CONFLICT);
-        mState = SessionState::Busy;
+        if (mState == SessionState::Busy) {
+            if (!mQueueOperations)
+                throw SessionError("Session is busy and cannot be modified",
+                                   HTTP_RESOURCE_CONFLICT);
+            if (mRunning.isDelete() || (mHasQueued && mQueued.isDelete()))
+                throw SessionError("Session is being deleted and cannot be modified",
+                                   HTTP_RESOURCE_CONFLICT);
+            opId = nextOperationId_wlock();
+            if (mHasQueued) {
+                ARRAS_DEBUG(log::Session(mId.toString()) <<
+                            "Queued modify replaced by modify " << opId);
+            } else {
+                mQueued = Operation();
+                mHasQueued = true;
+            }
+            mQueued.config = newConfig;
+            mQueued.ids.push_back(opId);
+        } else {
+            mQueueOperations = newConfig->queueOperations();
+            Operation op;
+            op.config = newConfig;
+            if (mQueueOperations) {
+                opId = nextOperationId_wlock();
+                op.ids.push_back(opId);
+            }
+            startOperation_wlock(op);
+        }
     }
 
-    // start async modification thread
-    if (mOperationThread.joinable())
-      mOperationThread.join();
-    mOperationThread = std::thread(&Session::updateProc,this,newConfig);
-
     timeval now;
     gettimeofday(&now, nullptr);
-    mLastActivitySecs = now.tv_sec;
+    noteActivity(now.tv_sec,false);
+    return opId;
 }
  
-void Session::asyncDelete(const std::string& reason)
+Session::OperationId Session::asyncDelete(const std::string& reason)
 {
+    OperationId opId = 0;
+    Operation superseded;
+    bool hasSuperseded = false;
     {
         std::lock_guard<std::mutex> lock(mStateMutex);
 	if (mShuttingDown)
 	    throw SessionError("Session is shutting down");
-        if (mState == SessionState::Busy)
-            throw SessionError("Session is busy and cannot be deleted",
-                               HTTP_RESOURCE_CONFLICT);
         if (mState == SessionState::Defunct)
             throw SessionError("Session is defunct and cannot be deleted",
                                HTTP_RESOURCE_CONFLICT);
-        mState = SessionState::Busy;
+        if (mState == SessionState::Busy) {
+            if (!mQueueOperations)
+                throw SessionError("Session is busy and cannot be deleted",
+                                   HTTP_RESOURCE_CONFLICT);
+            opId = nextOperationId_wlock();
+            if (mRunning.isDelete()) {
+                mRunning.ids.push_back(opId);
+            } else if (mHasQueued && mQueued.isDelete()) {
+                mQueued.ids.push_back(opId);
+            } else {
+                // there is no point applying a config to a session
+                // that is about to be deleted
+                if (mHasQueued) {
+                    superseded = mQueued;
+                    hasSuperseded = true;
+                }
+                mQueued = Operation();
+                mQueued.reason = reason;
+                mQueued.ids.push_back(opId);
+                mHasQueued = true;
+            }
+        } else {
+            Operation op;
+            op.reason = reason;
+            if (mQueueOperations) {
+                opId = nextOperationId_wlock();
+                op.ids.push_back(opId);
+            }
+            startOperation_wlock(op);
+        }
     }
+    if (hasSuperseded)
+        reportOperations(superseded,"superseded");
 
-    // start async deletion thread
-    if (mOperationThread.joinable())
-      mOperationThread.join();	
+    timeval now;
+    gettimeofday(&now, nullptr);
+    noteActivity(now.tv_sec,false);
+    return opId;
+}
 
-    std::chrono::steady_clock::time_point endtime = 
-	std::chrono::steady_clock::now() +
-	WAIT_FOR_SHUTDOWN_TIMEOUT;
+Session::OperationId Session::nextOperationId_wlock()
+{
+    return ++mLastOperationId;
+}
 
-    mOperationThread = std::thread(&Session::deleteProc,this,reason,endtime);
+// caller holds state mutex, and has checked that no operation is running
+void Session::startOperation_wlock(const Operation& op)
+{
+    mState = SessionState::Busy;
+    mRunning = op;
+    if (op.config)
+        mQueueOperations = op.config->queueOperations();
+
+    Session::Ptr self = shared_from_this();
+    if (op.isDelete()) {
+        // the timeout starts when the deletion does, rather than
+        // when it is queued. Deletion waits for processes to exit,
+        // so it runs on the executor's blocking lane
+        std::string reason = op.reason;
+        mExecutor.submit(mId,"delete",[self,reason]() {
+                std::chrono::steady_clock::time_point endtime = 
+                    std::chrono::steady_clock::now() +
+                    WAIT_FOR_SHUTDOWN_TIMEOUT;
+                bool ok = self->deleteProc(reason,endtime);
+                self->finishOperation(ok ? "complete" : "failed");
+            }, SessionExecutor::Lane::Blocking);
+    } else {
+        SessionConfig::Ptr config = op.config;
+        mExecutor.submit(mId,"update",[self,config]() {
+                // an update that hadn't started when the node began
+                // shutting down is dropped : the session is about to stop
+                if (self->isShuttingDown()) {
+                    self->finishOperation("cancelled");
+                    return;
+                }
+                bool ok = self->updateProc(config);
+                self->finishOperation(ok ? "complete" : "failed");
+            });
+    }
+}
 
-    timeval now;
-    gettimeofday(&now, nullptr);
-    mLastActivitySecs = now.tv_sec;
+// called on the executor when an operation is done : reports it,
+// then starts the queued operation if there is one
+void Session::finishOperation(const std::string& status)
+{
+    Operation finished;
+    {
+        std::lock_guard<std::mutex> lock(mStateMutex);
+        finished = mRunning;
+    }
+    // reported before the next operation starts, so that the event
+    // precedes any it causes
+    reportOperations(finished, status);
+    {
+        std::lock_guard<std::mutex> lock(mStateMutex);
+        mRunning = Operation();
+        if (mHasQueued && mState == SessionState::Busy) {
+            Operation next = mQueued;
+            mQueued = Operation();
+            mHasQueued = false;
+            startOperation_wlock(next);
+        } else if (mState == SessionState::Busy) {
+            mState = SessionState::Free;
+        }
+    }
+    // continue shutdown if it was waiting on us
+    mOperationComplete.notify_all();
+}
+
+void Session::reportOperations(const Operation& op, const std::string& status)
+{
+    if (op.ids.empty())
+        return;
+    api::Object ids(Json::arrayValue);
+    for (OperationId id : op.ids)
+        ids.append(static_cast<Json::UInt64>(id));
+    mArrasController.sessionOperationComplete(mId,op.name(),ids,status);
 }
 
 // shutdown is a synchronous operation, used when the node itself is shutting down.
 // it waits for any current operation to complete, then stops all computations.
-// node cannot fully shutdown until all sessions are shutdown (although there is
-// a timeout)
-// sessions are shut down sequentially, so that we don't have too many
-// terminations running at once.
-void Session::syncShutdown(const std::string& reason)
+// node cannot fully shutdown until all sessions are shutdown : ArrasSessions
+// runs this for every session at once, with a shared deadline
+void Session::syncShutdown(const std::string& reason,
+			   std::chrono::steady_clock::time_point endtime)
 {
     ARRAS_DEBUG(log::Session(mId.toString()) << "Shutting down session");
-    std::chrono::steady_clock::time_point endtime = 
-	std::chrono::steady_clock::now() +
-	WAIT_FOR_SHUTDOWN_TIMEOUT;
     {
 	std::unique_lock<std::mutex> lock(mStateMutex);
 	
         // prevent new operations from starting
 	mShuttingDown = true;
+
+	// a queued operation is dropped : the session and its computations
+	// are reported in the "sessionShutdown" event instead
+	if (mHasQueued) {
+	    ARRAS_DEBUG(log::Session(mId.toString()) <<
+			"Dropping queued " << mQueued.name() << " for shutdown");
+	    mQueued = Operation();
+	    mHasQueued = false;
+	}
 	
-        // wait for any running operations to complete
+        // wait for any running operations to complete. On timeout the
+        // running operation still reports its computations itself, as
+        // computationTerminated events
 	while (mState == SessionState::Busy) {
 	    std::cv_status cvs = mOperationComplete.wait_until(lock,endtime);
 	    if (cvs == std::cv_status::timeout)
 		throw SessionError("Session shutdown took too long");
 	}
 
+	// a deleted session (including one deleted by the operation
+	// we waited for) has already stopped and been reported
+	if (mState == SessionState::Defunct) {
+	    ARRAS_DEBUG(log::Session(mId.toString()) << "Session was already deleted");
+	    return;
+	}
+
+	// from here on computationTerminated events are collected
+	// for the "sessionShutdown" event
+	mNodeShutdown = true;
+	mShutdownReports = Json::arrayValue;
+
 	// we can now release the lock, because mShuttingDown blocks
 	// any new operations from starting
     }
-    
-    // cleanup current operation thread, just to be tidy...
-    if (mOperationThread.joinable())
-	mOperationThread.join();
 
     // run deleteProc to shutdown computations
     deleteProc(reason,endtime);
+
+    // report the session and its computations to Coordinator in one event,
+    // rather than one per computation
+    // the router's final traffic summary follows deletion of the session's
+    // routing data : it is included if it arrives in time
+    std::chrono::steady_clock::time_point trafficEnd =
+        std::min(endtime, std::chrono::steady_clock::now() + WAIT_FOR_TRAFFIC_SUMMARY);
+    api::Object reports;
+    api::Object traffic;
+    {
+	std::unique_lock<std::mutex> lock(mStateMutex);
+	reports = mShutdownReports;
+	mTrafficSummaryReceived.wait_until(lock, trafficEnd,
+					   [this]() { return !mTrafficSummary.isNull(); });
+	traffic = mTrafficSummary;
+    }
+    mArrasController.sessionShutdown(mId,reason,reports,traffic);
     ARRAS_DEBUG(log::Session(mId.toString()) << "Have shut down session");
 }
+
+void Session::setTrafficSummary(api::ObjectConstRef summary)
+{
+    {
+	std::lock_guard<std::mutex> lock(mStateMutex);
+	mTrafficSummary = summary;
+    }
+    mTrafficSummaryReceived.notify_all();
+}
+
+bool Session::isShuttingDown() const
+{
+    std::lock_guard<std::mutex> lock(mStateMutex);
+    return mShuttingDown;
+}
+
+bool Session::addShutdownReport(const std::string& report)
+{
+    std::lock_guard<std::mutex> lock(mStateMutex);
+    if (!mNodeShutdown)
+	return false;
+    mShutdownReports.append(report);
+    return true;
+}
     
-void Session::updateProc(SessionConfig::Ptr newConfig)
+bool Session::updateProc(SessionConfig::Ptr newConfig)
 {    
     try {
 	applyNewConfig(*newConfig);
+	return true;
     } catch (std::exception& ex) {
 	mArrasController.sessionOperationFailed(mId,"create/modify",ex.what());
     } catch (...) {
 	mArrasController.sessionOperationFailed(mId,"create/modify","Unknown exception");
     }
-    {
-	std::lock_guard<std::mutex> lock(mStateMutex);
-	if (mState == SessionState::Busy) {
-	    mState = SessionState::Free;
-	}
-    }
-    // continue shutdown if it was waiting on us
-    mOperationComplete.notify_all();
+    return false;
 }
 
-void Session::deleteProc(std::string reason,
+bool Session::deleteProc(std::string reason,
 			 std::chrono::steady_clock::time_point endtime)
 {
+    bool succeeded = false;
     try {
 	std::lock_guard<std::mutex> lock(mComputationsMutex);
 	for (auto jt = mComputations.begin(); jt != mComputations.end(); ++jt) {
 	    jt->second->shutdown();
 	}
 
+	// computations get until shortly before the deadline to stop
+	// by themselves, then any that are left are killed. With a short
+	// deadline they still get part of the time
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point killtime = endtime - KILL_BEFORE_DEADLINE;
+	if (endtime > now) {
+	    std::chrono::steady_clock::time_point grace = now +
+		std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		    (endtime - now) * KILL_GRACE_FRACTION);
+	    killtime = std::max(killtime, grace);
+	}
+	std::vector<Computation::Ptr> remaining;
 	for (auto jt = mComputations.begin(); jt != mComputations.end(); ++jt) {
-	    
-	    Computation::Ptr comp = jt->second;
+	    if (!jt->second->waitUntilShutdown(killtime))
+		remaining.push_back(jt->second);
+	}
+	for (Computation::Ptr& comp : remaining) {
+	    comp->kill();
+	}
+	for (Computation::Ptr& comp : remaining) {
 	    bool didShutdown = comp->waitUntilShutdown(endtime);
 	    if (!didShutdown) {
 		ARRAS_ERROR(log::Id("cantStopComp") <<
@@ -334,6 +569,7 @@ void Session::deleteProc(std::string reason,
 	}
 
 	arrasController().shutdownSession(mId, reason);
+	succeeded = true;
 
     } catch (std::exception& ex) {
 	mArrasController.sessionOperationFailed(mId, "delete", ex.what());
@@ -344,14 +580,15 @@ void Session::deleteProc(std::string reason,
 	std::lock_guard<std::mutex> locks(mStateMutex);
 	mState = SessionState::Defunct;
 	mDeleteReason = reason;
+	timeval now;
+	gettimeofday(&now, nullptr);
+	mDefunctSecs = now.tv_sec;
     }
-    // continue shutdown if it was waiting on us
-    mOperationComplete.notify_all();
+    return succeeded;
 }
     
-// this function runs in a per-session background thread 
-// via modifyProc, and is not designed to run concurrently
-// on the same session
+// this function runs on the session executor via updateProc,
+// which never runs two operations on the same session at once
 void Session::applyNewConfig(const SessionConfig& newConfig)
 {
     if (newConfig.logLevel() >= 0)
@@ -387,13 +624,87 @@ void Session::applyNewConfig(const SessionConfig& newConfig)
         }
     }
 
-    // start new computations     
-    for (auto it = newComps.begin(); it != newComps.end(); ++it) {
+    startNewComputations(newComps,newConfig);
+}
+
+// start new computations. Packaging resolution, writing the exec config
+// and spawning each computation are independent of the others, so up to
+// maxParallelLaunches of them run at once : the calling thread launches,
+// helped by tasks on the executor's node-wide launch pool. Every launch is
+// attempted even if some fail : the failures are then reported together
+// as a single SessionError.
+// ProcessManager and rez resolution are already used concurrently by
+// operations on different sessions, and launches within a session use
+// them in the same way
+void Session::startNewComputations(const std::map<api::UUID,std::string>& newComps,
+				   const SessionConfig& newConfig)
+{
+    if (newComps.empty())
+	return;
+
+    // shared with the helper tasks, which may only get to run after
+    // every launch has been claimed and this function has returned
+    struct Launches {
+	std::vector<std::pair<api::UUID,std::string>> pending;
+	size_t next = 0;    // next launch to claim
+	size_t active = 0;  // launches claimed but not finished
+	std::vector<std::string> errors;
+	std::mutex mutex;
+	std::condition_variable done;
+    };
+    std::shared_ptr<Launches> launches = std::make_shared<Launches>();
+    launches->pending.assign(newComps.begin(), newComps.end());
+
+    // a helper that runs late finds nothing left to claim, so it never
+    // touches the session or the config after they have gone
+    const SessionConfig* config = &newConfig;
+    auto launcher = [this,launches,config]() {
+	std::unique_lock<std::mutex> lock(launches->mutex);
+	while (launches->next < launches->pending.size()) {
+	    const std::pair<api::UUID,std::string>& comp = launches->pending[launches->next++];
+	    launches->active++;
+	    lock.unlock();
+	    std::string error;
+	    try {
+		startNewComputation(comp.first,comp.second,*config);
+	    } catch (std::exception& ex) {
+		error = ex.what();
+	    } catch (...) {
+		error = "Unknown exception starting computation " + comp.second;
+	    }
+	    lock.lock();
+	    if (!error.empty())
+		launches->errors.push_back(error);
+	    launches->active--;
+	}
+	launches->done.notify_all();
+    };
+
+    // helpers are keyed by computation id, so that they run in parallel
+    size_t parallel = std::min<size_t>(launches->pending.size(),
+				       std::max(1u, mComputationDefaults.maxParallelLaunches));
+    for (size_t i = 1; i < parallel; i++) {
+	mExecutor.submit(launches->pending[i].first, "launch", launcher,
+			 SessionExecutor::Lane::Launch);
+    }
+    // the calling thread launches too, so progress doesn't depend on
+    // the launch pool having a free thread
+    launcher();
 
-        const api::UUID compId = it->first;
-        const std::string compName = it->second;
+    std::vector<std::string> errors;
+    {
+	std::unique_lock<std::mutex> lock(launches->mutex);
+	launches->done.wait(lock, [&launches]() { return launches->active == 0; });
+	errors.swap(launches->errors);
+    }
 
-	startNewComputation(compId,compName,newConfig);
+    if (errors.size() == 1) {
+	throw SessionError(errors.front());
+    } else if (!errors.empty()) {
+	std::string message = errors.front();
+	for (size_t i = 1; i < errors.size(); i++)
+	    message += "; " + errors[i];
+	throw SessionError(std::to_string(errors.size()) + " computations failed to start : " + message);
     }
 }
 
@@ -416,7 +727,7 @@ void Session::getConfigDelta(const SessionConfig& newConfig,
     }    
 }
 
-// see note for applyNewConfig
+// called concurrently for different computations by startNewComputations
 void Session::startNewComputation(const api::UUID& compId,
                                   const std::string& compName,
 				  const SessionConfig& sessConfig)
@@ -457,6 +768,7 @@ void Session::startNewComputation(const api::UUID& compId,
 
     try {
 	compConfig.applyPackaging(mProcessManager,
+				  mRezCache,
 				  definition,
 	                          context);
     } catch (SessionError &e) {
@@ -487,41 +799,24 @@ void Session::setExpirationTime(const  std::chrono::steady_clock::time_point& ex
 {
     // terminate any existing expiration
     stopExpiration();
-    // start a proc that will terminate session at the given
-    // time, as long a mExpirationSet remains true
-    {
-	std::unique_lock<std::mutex> lock(mExpirationMutex);
-	mExpirationSet = true;
-    }
-    mExpirationThread = std::thread(&Session::expirationProc,this,expiry,message);
+    // terminate session at the given time, unless stopExpiration()
+    // is called first
+    std::lock_guard<std::mutex> lock(mExpirationMutex);
+    mExpiration = mTimers.schedule(expiry,[this,message]() {
+	    mArrasController.sessionExpired(mId, message);
+	});
 }
 
 void Session::stopExpiration()
 {
-    // cause expirationProc to exit without terminating the session
+    TimerWheel::Handle expiration;
     {
-	std::unique_lock<std::mutex> lock(mExpirationMutex);
-	mExpirationSet = false;
-    }
-    // make expirationProc exit promptly and join it
-    if (mExpirationThread.joinable()) {
-	mExpirationCondition.notify_all();
-	mExpirationThread.join();
-    }
-}
-
-void Session::expirationProc(std::chrono::steady_clock::time_point expiry,
-			     std::string message)
-{
-    std::unique_lock<std::mutex> lock(mExpirationMutex);
-    while (mExpirationSet) {
-	std::cv_status cvs = mExpirationCondition.wait_until(lock,expiry);
-        if (cvs == std::cv_status::timeout)
-            break;
-    }
-    if (mExpirationSet) {
-	mArrasController.sessionExpired(mId, message);
+	std::lock_guard<std::mutex> lock(mExpirationMutex);
+	expiration = mExpiration;
+	mExpiration = TimerWheel::Handle();
     }
+    // if the expiration is running, this waits for it to finish
+    expiration.cancel();
 }
 
 }
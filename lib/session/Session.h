@@ -4,11 +4,15 @@
 #ifndef __ARRAS4_SESSION_H__
 #define __ARRAS4_SESSION_H__
 
+#include "ActivityTimes.h"
 #include "Computation.h"
+#include "SessionExecutor.h"
+#include "TimerWheel.h"
 #include "SessionConfig.h"
 
 #include <message_api/UUID.h>
 #include <map>
+#include <vector>
 #include <memory>
 #include <atomic>
 #include <thread>
@@ -24,12 +28,13 @@ namespace arras4 {
 
 class ArrasController;
 class ComputationDefaults;
+class RezContextCache;
 
 // possible states of a session
 enum class SessionState
 {
     Free,       // session is not being modified
-    Busy,       // session is currently being modified : you will not be able to initiate a new modification
+    Busy,       // session is currently being modified : a new modification is rejected, or queued if the session queues operations
     Defunct     // session has been deleted  
 };
 
@@ -40,18 +45,23 @@ inline std::string SessionState_string(SessionState s)
     return "Defunct";
 }
 
-class Session
+class Session : public std::enable_shared_from_this<Session>
 {
 public:
     Session(const api::UUID& sessionId,
             const api::UUID& nodeId,
             const ComputationDefaults& computationDefaults,
             impl::ProcessManager& processManager,
-            ArrasController& arrasController);
+            ArrasController& arrasController,
+            RezContextCache& rezCache,
+            ActivityTimes& nodeActivity,
+            TimerWheel& timers,
+            SessionExecutor& executor);
 
     ~Session();
 
     using Ptr = std::shared_ptr<Session>;
+    using OperationId = unsigned long long;
  
     Computation::Ptr getComputation(const api::UUID& id); // locks computations mutex
     SessionState getState();           // locks state mutex
@@ -60,9 +70,25 @@ public:
     api::Object getStatus();           // locks comp and state mutexes
     api::Object getPerformanceStats(); // locks comp mutex
     void signal(api::ObjectConstRef signalData); 
-    void asyncUpdateConfig(SessionConfig::Ptr newConfig); // locks comp and state mutexes
-    void asyncDelete(const std::string& reason);
-    void syncShutdown(const std::string& reason);
+    // start an operation, or queue it if the session is busy and has
+    // opted in to queueing (SessionConfig::queueOperations()). Queued
+    // modifies coalesce into the latest config, and a delete replaces any
+    // queued modify. Returns the operation id, reported in the
+    // "sessionOperationComplete" event, or 0 if the session doesn't queue
+    // operations (in which case a busy session throws HTTP_RESOURCE_CONFLICT)
+    OperationId asyncUpdateConfig(SessionConfig::Ptr newConfig); // locks comp and state mutexes
+    OperationId asyncDelete(const std::string& reason);
+    // stop the session's computations because the node is shutting down,
+    // giving up at endtime. Sends a single "sessionShutdown" event when done
+    void syncShutdown(const std::string& reason,
+		      std::chrono::steady_clock::time_point endtime);
+    // called by computations that terminate during syncShutdown, to be included
+    // in the "sessionShutdown" event. Returns false if not shutting down
+    bool addShutdownReport(const std::string& report);
+    // final summary of the session's traffic through the router, sent once
+    // the router has deleted the session. Included in the status and
+    // performance stats, and in the "sessionShutdown" event
+    void setTrafficSummary(api::ObjectConstRef summary);
 
     // sessions can be set to expire (causing a "sessionExpiry" event) at a certain time,
     // unless they are deleted or "stopExpiration()" is called
@@ -75,6 +101,13 @@ public:
     // count as activity. Otherwise, "activity" is operations or signals
     // acting on the session as a whole.
     long getLastActivitySecs(bool includeComputations) const;
+    // record activity on the session, or on one of its computations.
+    // Also updates the node's activity times
+    void noteActivity(long secs, bool fromComputation);
+
+    // true once the session has been defunct for graceSecs, and all
+    // its computations have exited : it can then be discarded
+    bool isReclaimable(long nowSecs, unsigned graceSecs);
 
     impl::ProcessManager& processManager() { return mProcessManager; }
     ArrasController& arrasController() { return mArrasController; }
@@ -93,14 +126,30 @@ private:
     void checkIsFree();
     void signalAll(api::ObjectConstRef signalData);
 
-    void updateProc(SessionConfig::Ptr newConfig);
-    void deleteProc(std::string reason,std::chrono::steady_clock::time_point endtime);
-    void expirationProc(std::chrono::steady_clock::time_point expiry,
-			std::string message);
+    // an accepted create/modify (config set) or delete, together with
+    // the ids of every request it completes
+    struct Operation {
+        SessionConfig::Ptr config;
+        std::string reason;
+        std::vector<OperationId> ids;
+        bool isDelete() const { return !config; }
+        const char* name() const { return config ? "modify" : "delete"; }
+    };
+
+    OperationId nextOperationId_wlock();
+    void startOperation_wlock(const Operation& op);
+    void finishOperation(const std::string& status);
+    bool isShuttingDown() const;
+    void reportOperations(const Operation& op, const std::string& status);
+
+    bool updateProc(SessionConfig::Ptr newConfig);
+    bool deleteProc(std::string reason,std::chrono::steady_clock::time_point endtime);
     void applyNewConfig(const SessionConfig& newConfig);
     void getConfigDelta(const SessionConfig& newConfig,
                         std::vector<Computation::Ptr>& defunctComps,
                         std::map<api::UUID,std::string>& newComps) const;
+    void startNewComputations(const std::map<api::UUID,std::string>& newComps,
+			      const SessionConfig& newConfig);
     void startNewComputation(const api::UUID& compId,
 			     const std::string& compName,
 			     const SessionConfig& sessConfig);
@@ -111,25 +160,38 @@ private:
     int mLogLevel;
     impl::ProcessManager& mProcessManager;
     ArrasController& mArrasController;
+    RezContextCache& mRezCache;
 
-    // last activity on the session as a whole, in epoch secs
-    long mLastActivitySecs = 0;
+    ActivityTimes mActivity;
+    ActivityTimes& mNodeActivity;
 
-    std::thread mOperationThread; // protected by Busy state
+    // runs asynchronous operations : each holds a pointer to the session
+    SessionExecutor& mExecutor;
 
     mutable std::mutex mStateMutex;
     SessionState mState;
     std::condition_variable mOperationComplete; // signalled whenever an operation ends
     std::string mDeleteReason;
+    long mDefunctSecs = 0; // when the session became defunct, in epoch secs
     bool mShuttingDown{false};  // protected by state mutex
+    bool mNodeShutdown{false};  // protected by state mutex
+    api::Object mShutdownReports; // protected by state mutex
+    api::Object mTrafficSummary;  // null until received, protected by state mutex
+    std::condition_variable mTrafficSummaryReceived;
+
+    // operation queue, protected by state mutex
+    bool mQueueOperations{false};   // set by the latest accepted config
+    OperationId mLastOperationId{0};
+    Operation mRunning;             // valid while Busy
+    bool mHasQueued{false};
+    Operation mQueued;              // next to run, if mHasQueued
 
     mutable std::mutex mComputationsMutex;
     std::map<api::UUID,Computation::Ptr> mComputations;
 
-    mutable std::mutex mExpirationMutex;
-    bool mExpirationSet{false};
-    std::condition_variable mExpirationCondition;
-    std::thread mExpirationThread;
+    TimerWheel& mTimers;
+    std::mutex mExpirationMutex;
+    TimerWheel::Handle mExpiration; // protected by mExpirationMutex
 };
 
 }
@@ -24,6 +24,7 @@ SessionConfig::SessionConfig(api::ObjectConstRef desc,
     //              <compname_1>: definition for compname_1
     //              <compname_2>:...
     //          "sessionId": <sessionId>,
+    //          "queueOperations": <bool> # optional
     //          "contexts": {
     //               <contextname>: context...
     //          }
@@ -67,6 +68,11 @@ SessionConfig::SessionConfig(api::ObjectConstRef desc,
         mLogLevel = -1; // means "not set"
     }
 
+    // opt in to queued operations
+    if (nodeConfig["queueOperations"].isBool()) {
+        mQueueOperations = nodeConfig["queueOperations"].asBool();
+    }
+
     api::ObjectConstRef routing = mDesc["routing"];
     if (routing.isNull() || !routing.isObject()) {
         throw std::runtime_error("Session definition has no routing object");
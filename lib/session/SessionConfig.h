@@ -43,6 +43,10 @@ public:
 
     int logLevel() const { return mLogLevel; }
 
+    // true if Coordinator wants modify and delete requests that arrive
+    // while the session is busy to be queued rather than rejected
+    bool queueOperations() const { return mQueueOperations; }
+
 private:
     api::UUID mSessionId;
     api::UUID mNodeId;
@@ -53,6 +57,8 @@ private:
     // session-wide log level (-1 means "not set")
     int mLogLevel = -1;
 
+    bool mQueueOperations{false};
+
     // references to internal sections;
     const api::Object * mDefinitions;
     const api::Object * mRouting;
@@ -0,0 +1,205 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "SessionExecutor.h"
+
+#include <arras4_log/Logger.h>
+#include <arras4_log/LogEventStream.h>
+
+#include <algorithm>
+#include <exception>
+
+namespace {
+
+const char* LANE_NAMES[] = { "operation", "blocking", "launch" };
+const char* THREAD_NAMES[] = { "session-ops", "session-ops-blocking", "session-launch" };
+
+}
+
+namespace arras4 {
+    namespace node {
+
+SessionExecutor::SessionExecutor(unsigned threadCount,
+                                 unsigned blockingThreadCount,
+                                 unsigned launchThreadCount)
+{
+    startThreads(Lane::Operation, threadCount);
+    startThreads(Lane::Blocking, blockingThreadCount);
+    startThreads(Lane::Launch, launchThreadCount);
+}
+
+SessionExecutor::~SessionExecutor()
+{
+    stop();
+}
+
+void SessionExecutor::startThreads(Lane aLane, unsigned count)
+{
+    count = std::max(1u, count);
+    lane(aLane).threads = count;
+    for (unsigned i = 0; i < count; i++) {
+        mThreads.emplace_back(&SessionExecutor::proc, this, aLane);
+    }
+}
+
+bool SessionExecutor::submit(const api::UUID& sessionId,
+                             const std::string& opType,
+                             Task task,
+                             Lane aLane)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mStopping) {
+        ARRAS_WARN(log::Id("sessionOpDiscarded") <<
+                   log::Session(sessionId.toString()) <<
+                   "Discarding session operation '" << opType << "' : executor has stopped");
+        return false;
+    }
+    Strand& strand = mStrands[sessionId];
+    strand.items.push_back(Item{opType, std::move(task), Clock::now(), aLane});
+    lane(aLane).queued++;
+    // a running strand is made ready again when its
+    // current task finishes
+    if (!strand.running && strand.items.size() == 1)
+        ready_wlock(sessionId, strand);
+    return true;
+}
+
+void SessionExecutor::stop()
+{
+    std::vector<std::thread> threads;
+    std::map<api::UUID,Strand> discarded;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+        threads.swap(mThreads);
+        discarded.swap(mStrands);
+        for (LaneState& state : mLanes) {
+            state.ready.clear();
+            state.queued = 0;
+            state.condition.notify_all();
+        }
+    }
+    for (std::thread& thread : threads) {
+        if (thread.joinable())
+            thread.join();
+    }
+    // 'discarded' releases any sessions held by queued tasks here,
+    // outside the lock
+}
+
+void SessionExecutor::proc(Lane aLane)
+{
+    log::Logger::instance().setThreadName(THREAD_NAMES[static_cast<size_t>(aLane)]);
+    LaneState& state = lane(aLane);
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        state.condition.wait(lock, [this,&state]() { return mStopping || !state.ready.empty(); });
+        if (mStopping)
+            break;
+
+        api::UUID sessionId = state.ready.front();
+        state.ready.pop_front();
+        Strand& strand = mStrands[sessionId];
+        Item item = std::move(strand.items.front());
+        strand.items.pop_front();
+        strand.running = true;
+        state.queued--;
+        state.running++;
+
+        lock.unlock();
+        run(sessionId, item);
+        lock.lock();
+        state.running--;
+        if (mStopping)
+            break;
+        finish_wlock(sessionId);
+    }
+}
+
+// run a task, and record how long it waited and ran
+void SessionExecutor::run(const api::UUID& sessionId, Item& item)
+{
+    Clock::time_point start = Clock::now();
+    try {
+        item.task();
+    } catch (std::exception& e) {
+        ARRAS_ERROR(log::Id("sessionOpFailed") <<
+                    log::Session(sessionId.toString()) <<
+                    "Exception in session operation '" << item.opType << "' : " << e.what());
+    } catch (...) {
+        ARRAS_ERROR(log::Id("sessionOpFailed") <<
+                    log::Session(sessionId.toString()) <<
+                    "Unknown exception in session operation '" << item.opType << "'");
+    }
+    Clock::time_point end = Clock::now();
+    // the task may hold the last reference to the session :
+    // release it before taking the lock
+    item.task = nullptr;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    record_wlock(item.opType,
+                 std::chrono::duration<double,std::milli>(start - item.submitted).count(),
+                 std::chrono::duration<double,std::milli>(end - start).count());
+}
+
+// queue a session that isn't running on the lane of its next task
+void SessionExecutor::ready_wlock(const api::UUID& sessionId, const Strand& strand)
+{
+    LaneState& state = lane(strand.items.front().lane);
+    state.ready.push_back(sessionId);
+    state.condition.notify_one();
+}
+
+// the session's current task is done : make its next task ready
+void SessionExecutor::finish_wlock(const api::UUID& sessionId)
+{
+    auto it = mStrands.find(sessionId);
+    if (it != mStrands.end()) {
+        it->second.running = false;
+        if (it->second.items.empty()) {
+            mStrands.erase(it);
+        } else {
+            ready_wlock(sessionId, it->second);
+        }
+    }
+}
+
+void SessionExecutor::record_wlock(const std::string& opType, double waitMs, double runMs)
+{
+    OpStats& stats = mStats[opType];
+    stats.count++;
+    stats.totalWaitMs += waitMs;
+    stats.maxWaitMs = std::max(stats.maxWaitMs, waitMs);
+    stats.totalRunMs += runMs;
+    stats.maxRunMs = std::max(stats.maxRunMs, runMs);
+}
+
+void SessionExecutor::getStats(api::ObjectRef out) const
+{
+    api::ObjectRef ops = out["sessionOps"];
+    std::lock_guard<std::mutex> lock(mMutex);
+    // the operation lane is reported at the top level, as it was
+    // before there were lanes
+    ops["threads"] = mLanes[0].threads;
+    ops["queued"] = static_cast<Json::UInt64>(mLanes[0].queued);
+    ops["running"] = static_cast<Json::UInt64>(mLanes[0].running);
+    for (size_t i = 1; i < LANE_COUNT; i++) {
+        api::ObjectRef laneStats = ops[LANE_NAMES[i]];
+        laneStats["threads"] = mLanes[i].threads;
+        laneStats["queued"] = static_cast<Json::UInt64>(mLanes[i].queued);
+        laneStats["running"] = static_cast<Json::UInt64>(mLanes[i].running);
+    }
+    ops["types"] = Json::objectValue;
+    for (const auto& entry : mStats) {
+        const OpStats& stats = entry.second;
+        api::ObjectRef type = ops["types"][entry.first];
+        type["count"] = static_cast<Json::UInt64>(stats.count);
+        type["meanWaitMs"] = stats.count ? stats.totalWaitMs / stats.count : 0.0;
+        type["maxWaitMs"] = stats.maxWaitMs;
+        type["meanRunMs"] = stats.count ? stats.totalRunMs / stats.count : 0.0;
+        type["maxRunMs"] = stats.maxRunMs;
+    }
+}
+
+}
+}
@@ -0,0 +1,123 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __ARRAS4_SESSION_EXECUTOR_H__
+#define __ARRAS4_SESSION_EXECUTOR_H__
+
+#include <message_api/Object.h>
+#include <message_api/UUID.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// SessionExecutor runs session operations (create/modify and delete) on
+// fixed pools of threads shared by all sessions on the node, instead of
+// each operation having a thread of its own. Operations on the same session
+// run one at a time, in the order they were submitted : each session has
+// its own queue, and a session with work waiting is in a ready queue at
+// most once, so an idle thread picks up whichever session has been
+// waiting longest. Different sessions run in parallel, up to the pool size.
+//
+// Each task is submitted to a lane, and each lane has its own pool and
+// ready queue. Blocking tasks (e.g. deletes, which wait for computation
+// processes to exit) go in the Blocking lane, so a burst of them can't hold
+// up operations on other sessions. A session's tasks are still run in order
+// across lanes : the session waits in the ready queue of the lane of its
+// next task. The Launch lane starts computations : its tasks are keyed by
+// computation id rather than session id, so that the launches of one
+// session can run in parallel, while the number of launches on the node is
+// bounded by the lane's pool.
+//
+// Queue depth for each lane, and wait and run times for each operation
+// type, are reported by getStats()
+
+namespace arras4 {
+    namespace node {
+
+class SessionExecutor
+{
+public:
+    using Task = std::function<void()>;
+
+    enum class Lane {
+        Operation,
+        Blocking,
+        Launch
+    };
+
+    SessionExecutor(unsigned threadCount,
+                    unsigned blockingThreadCount,
+                    unsigned launchThreadCount);
+    ~SessionExecutor();
+
+    // queue task to run after any earlier tasks for the same session,
+    // on the threads of the given lane. opType labels the task in the
+    // statistics. Tasks submitted after stop() are discarded, and false
+    // is returned
+    bool submit(const api::UUID& sessionId,
+                const std::string& opType,
+                Task task,
+                Lane aLane = Lane::Operation);
+
+    // stop the threads once the running tasks are done. Tasks still
+    // queued are discarded
+    void stop();
+
+    // pool sizes, queue depths and per-type timings, as "sessionOps" in out
+    void getStats(api::ObjectRef out) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+    static constexpr size_t LANE_COUNT = 3;
+
+    struct Item {
+        std::string opType;
+        Task task;
+        Clock::time_point submitted;
+        Lane lane;
+    };
+    struct Strand {
+        std::deque<Item> items;
+        bool running = false;
+    };
+    struct LaneState {
+        unsigned threads = 0;
+        std::deque<api::UUID> ready;  // sessions whose next task is in this lane
+        std::condition_variable condition;
+        size_t queued = 0;
+        size_t running = 0;
+    };
+    struct OpStats {
+        unsigned long long count = 0;
+        double totalWaitMs = 0;
+        double maxWaitMs = 0;
+        double totalRunMs = 0;
+        double maxRunMs = 0;
+    };
+
+    void startThreads(Lane lane, unsigned count);
+    void proc(Lane lane);
+    void run(const api::UUID& sessionId, Item& item);
+    void ready_wlock(const api::UUID& sessionId, const Strand& strand);
+    void finish_wlock(const api::UUID& sessionId);
+    void record_wlock(const std::string& opType, double waitMs, double runMs);
+    LaneState& lane(Lane aLane) { return mLanes[static_cast<size_t>(aLane)]; }
+
+    mutable std::mutex mMutex;
+    bool mStopping = false;
+    std::map<api::UUID,Strand> mStrands;  // sessions with tasks queued or running
+    LaneState mLanes[LANE_COUNT];
+    std::map<std::string,OpStats> mStats;
+    std::vector<std::thread> mThreads;
+};
+
+}
+}
+#endif
@@ -0,0 +1,243 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "TimerWheel.h"
+
+#include <arras4_log/Logger.h>
+#include <arras4_log/LogEventStream.h>
+
+#include <exception>
+
+namespace arras4 {
+    namespace node {
+
+constexpr unsigned TimerWheel::LEVELS;
+constexpr unsigned TimerWheel::SLOT_BITS;
+constexpr unsigned TimerWheel::SLOTS;
+
+TimerWheel::TimerWheel(std::chrono::milliseconds tick) :
+    mTick(tick), mStart(Clock::now())
+{
+    mThread = std::thread(&TimerWheel::proc,this);
+}
+
+TimerWheel::~TimerWheel()
+{
+    stop();
+}
+
+void TimerWheel::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mCondition.notify_all();
+    if (mThread.joinable() && mThread.get_id() != std::this_thread::get_id())
+        mThread.join();
+}
+
+// the tick on which a timer for 'when' should fire, i.e. the first
+// tick at or after 'when'
+unsigned long long TimerWheel::ticksUntil(Clock::time_point when) const
+{
+    if (when <= mStart)
+        return 0;
+    Clock::duration since = when - mStart;
+    return (since + mTick - Clock::duration(1)) / mTick;
+}
+
+TimerWheel::Handle TimerWheel::schedule(Clock::time_point when, Callback callback)
+{
+    return add(ticksUntil(when), 0, std::move(callback));
+}
+
+TimerWheel::Handle TimerWheel::scheduleAfter(Clock::duration delay, Callback callback)
+{
+    return add(ticksUntil(Clock::now() + delay), 0, std::move(callback));
+}
+
+TimerWheel::Handle TimerWheel::scheduleEvery(Clock::duration interval, Callback callback)
+{
+    unsigned long long intervalTicks = (interval + mTick - Clock::duration(1)) / mTick;
+    if (intervalTicks == 0) intervalTicks = 1;
+    return add(ticksUntil(Clock::now() + interval), intervalTicks, std::move(callback));
+}
+
+TimerWheel::Handle TimerWheel::add(unsigned long long expiryTick,
+                                   unsigned long long intervalTicks,
+                                   Callback callback)
+{
+    TimerPtr timer = std::make_shared<Timer>();
+    timer->expiryTick = expiryTick;
+    timer->intervalTicks = intervalTicks;
+    timer->callback = std::move(callback);
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        wake = (mPending == 0);
+        if (wake) {
+            // the thread has been sleeping rather than processing ticks :
+            // catch the wheel up to the present
+            unsigned long long now = ticksUntil(Clock::now());
+            if (now > mNextTick) mNextTick = now;
+        }
+        insert_wlock(timer);
+        mPending++;
+    }
+    if (wake)
+        mCondition.notify_all();
+    return Handle(this,timer);
+}
+
+size_t TimerWheel::pendingCount() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mPending;
+}
+
+// a timer goes into the lowest level whose range covers the time until it
+// is due, in the slot given by the corresponding bits of its expiry tick.
+// Timers beyond the range of the top level are parked at its far end, and
+// placed again when they get there
+void TimerWheel::insert_wlock(const TimerPtr& timer)
+{
+    unsigned long long expiry = timer->expiryTick;
+    if (expiry < mNextTick)
+        expiry = mNextTick;
+    unsigned long long delta = expiry - mNextTick;
+    for (unsigned level = 0; level < LEVELS; level++) {
+        unsigned long long range = 1ull << (SLOT_BITS * (level + 1));
+        if (delta < range || level == LEVELS - 1) {
+            if (delta >= range)
+                expiry = mNextTick + range - 1;
+            unsigned index = (expiry >> (SLOT_BITS * level)) & (SLOTS - 1);
+            mWheel[level][index].push_back(timer);
+            return;
+        }
+    }
+}
+
+// process tick mNextTick, moving the timers that are due into 'due'.
+// When the lowest level wraps round, the timers in the next slot of the
+// level above are moved down, and so on up the levels
+void TimerWheel::tick_wlock(Slot& due)
+{
+    unsigned index = mNextTick & (SLOTS - 1);
+    for (unsigned level = 1; level < LEVELS; level++) {
+        if ((mNextTick & ((1ull << (SLOT_BITS * level)) - 1)) != 0)
+            break;
+        unsigned upper = (mNextTick >> (SLOT_BITS * level)) & (SLOTS - 1);
+        Slot moving;
+        moving.swap(mWheel[level][upper]);
+        for (const TimerPtr& timer : moving) {
+            if (timer->state == TimerState::Pending)
+                insert_wlock(timer);
+        }
+    }
+    Slot& slot = mWheel[0][index];
+    for (auto it = slot.begin(); it != slot.end(); ) {
+        const TimerPtr& timer = *it;
+        if (timer->state != TimerState::Pending) {
+            // cancelled
+            it = slot.erase(it);
+        } else if (timer->expiryTick <= mNextTick) {
+            auto next = std::next(it);
+            due.splice(due.end(), slot, it);
+            it = next;
+        } else {
+            ++it;
+        }
+    }
+    mNextTick++;
+}
+
+void TimerWheel::proc()
+{
+    log::Logger::instance().setThreadName("timer-wheel");
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mStopping) {
+        if (mPending == 0) {
+            mCondition.wait(lock);
+            continue;
+        }
+        Clock::time_point nextTime = mStart + mTick * mNextTick;
+        if (Clock::now() < nextTime) {
+            mCondition.wait_until(lock, nextTime);
+            continue;
+        }
+
+        Slot due;
+        while (!mStopping && mStart + mTick * mNextTick <= Clock::now())
+            tick_wlock(due);
+
+        for (const TimerPtr& timer : due) {
+            if (mStopping)
+                break;
+            if (timer->state != TimerState::Pending)
+                continue;
+            timer->state = TimerState::Running;
+            timer->runningOn = std::this_thread::get_id();
+            Callback callback = timer->callback;
+            lock.unlock();
+            try {
+                callback();
+            } catch (std::exception& e) {
+                ARRAS_ERROR(log::Id("timerCallbackFailed") <<
+                            "Exception in timer callback : " << e.what());
+            } catch (...) {
+                ARRAS_ERROR(log::Id("timerCallbackFailed") <<
+                            "Unknown exception in timer callback");
+            }
+            lock.lock();
+            if (timer->intervalTicks && !timer->cancelled && !mStopping) {
+                timer->state = TimerState::Pending;
+                timer->expiryTick += timer->intervalTicks;
+                insert_wlock(timer);
+            } else {
+                timer->state = TimerState::Done;
+                timer->callback = nullptr;
+                mPending--;
+            }
+            mRunComplete.notify_all();
+        }
+    }
+}
+
+bool TimerWheel::cancel(const TimerPtr& timer)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    timer->cancelled = true;
+    if (timer->state == TimerState::Pending) {
+        // it is removed from its slot when the wheel gets there
+        timer->state = TimerState::Done;
+        timer->callback = nullptr;
+        mPending--;
+        return true;
+    }
+    if (timer->state == TimerState::Running &&
+        timer->runningOn != std::this_thread::get_id()) {
+        mRunComplete.wait(lock, [&timer]() { return timer->state != TimerState::Running; });
+    }
+    return false;
+}
+
+bool TimerWheel::Handle::cancel()
+{
+    TimerPtr timer = mTimer.lock();
+    if (!timer || !mWheel)
+        return false;
+    return mWheel->cancel(timer);
+}
+
+bool TimerWheel::Handle::pending() const
+{
+    TimerPtr timer = mTimer.lock();
+    if (!timer || !mWheel)
+        return false;
+    std::lock_guard<std::mutex> lock(mWheel->mMutex);
+    return timer->state != TimerState::Done;
+}
+
+}
+}
@@ -0,0 +1,119 @@
+// Copyright 2023-2024 DreamWorks Animation LLC and Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef __ARRAS4_TIMER_WHEEL_H__
+#define __ARRAS4_TIMER_WHEEL_H__
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// TimerWheel runs callbacks at given times on a single node-wide thread,
+// so that deadlines (such as session expiration) don't each need a thread
+// of their own. Timers are kept in a hierarchical wheel : adding and
+// cancelling a timer is constant time however many are pending, and each
+// tick only touches the timers that are due (or need moving down a level).
+// The thread sleeps while there are no timers. Timers fire on the first
+// tick at or after their time, so their resolution is the tick length.
+//
+// Callbacks run on the wheel thread with no locks held, and should be
+// quick : anything slow should be handed off to another thread.
+
+namespace arras4 {
+    namespace node {
+
+class TimerWheel
+{
+    struct Timer;
+    using TimerPtr = std::shared_ptr<Timer>;
+
+public:
+    using Clock = std::chrono::steady_clock;
+    using Callback = std::function<void()>;
+
+    // refers to a scheduled timer. Copyable : the timer is not cancelled when
+    // handles are destroyed
+    class Handle
+    {
+    public:
+        Handle() {}
+
+        // prevent the callback from running. Returns true if it was cancelled
+        // before running. If the callback is running on another thread, waits
+        // for it to finish, so that afterwards it is safe to destroy anything
+        // the callback uses. Can be called from the callback itself
+        bool cancel();
+
+        // true until the timer fires (the final time, if repeating)
+        // or is cancelled
+        bool pending() const;
+
+    private:
+        friend class TimerWheel;
+        Handle(TimerWheel* wheel, const TimerPtr& timer) : mWheel(wheel), mTimer(timer) {}
+        TimerWheel* mWheel = nullptr;
+        std::weak_ptr<Timer> mTimer;
+    };
+
+    explicit TimerWheel(std::chrono::milliseconds tick = std::chrono::milliseconds(100));
+    ~TimerWheel();
+
+    // run callback at (or just after) time 'when'
+    Handle schedule(Clock::time_point when, Callback callback);
+    // run callback after 'delay'
+    Handle scheduleAfter(Clock::duration delay, Callback callback);
+    // run callback every 'interval', until cancelled
+    Handle scheduleEvery(Clock::duration interval, Callback callback);
+
+    // number of timers waiting to fire
+    size_t pendingCount() const;
+
+    // stop the thread. Pending timers are discarded without running
+    void stop();
+
+private:
+    static constexpr unsigned LEVELS = 4;
+    static constexpr unsigned SLOT_BITS = 6;
+    static constexpr unsigned SLOTS = 1 << SLOT_BITS;
+    using Slot = std::list<TimerPtr>;
+
+    enum class TimerState { Pending, Running, Done };
+
+    struct Timer {
+        unsigned long long expiryTick = 0;
+        unsigned long long intervalTicks = 0; // 0 = not repeating
+        Callback callback;
+        TimerState state = TimerState::Pending;
+        bool cancelled = false;
+        std::thread::id runningOn;
+    };
+
+    Handle add(unsigned long long expiryTick, unsigned long long intervalTicks,
+               Callback callback);
+    unsigned long long ticksUntil(Clock::time_point when) const;
+    void insert_wlock(const TimerPtr& timer);
+    void tick_wlock(Slot& due);
+    bool cancel(const TimerPtr& timer);
+    void proc();
+
+    const Clock::duration mTick;
+    const Clock::time_point mStart;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mCondition;      // wakes the wheel thread
+    std::condition_variable mRunComplete;    // signalled after each callback
+    std::array<std::array<Slot,SLOTS>,LEVELS> mWheel;
+    unsigned long long mNextTick = 0;        // ticks before this have been processed
+    size_t mPending = 0;
+    bool mStopping = false;
+    std::thread mThread;
+};
+
+}
+}
+#endif